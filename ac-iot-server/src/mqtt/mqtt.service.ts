@@ -74,9 +74,11 @@ export class MqttService implements OnModuleInit {
         });
     }
 
-    publish(topic: string, message: string) {
+    // 下发给设备的消息默认 QoS 1：设备使用持久会话并以 QoS 1 订阅，
+    // 离线期间由 Broker 排队，重连后补发（QoS 0 的消息不会排队）
+    publish(topic: string, message: string, options: mqtt.IClientPublishOptions = { qos: 1 }) {
         if (this.client && this.client.connected) {
-            this.client.publish(topic, message);
+            this.client.publish(topic, message, options);
         } else {
             this.logger.warn('MQTT Client not connected, cannot publish');
         }
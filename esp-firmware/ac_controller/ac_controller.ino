@@ -16,18 +16,31 @@
  */
 
 #include "auto_detect.h" // ✅ 新增：自动协议检测
+#include "boot_profiler.h"
+#include "command_parser.h"
+#include "command_trace.h"
 #include "config.h"
 #include "config_manager.h"
+#include "device_shadow.h"
+#include "event_bus.h"
 #include "ghost_detector.h"
+#include "group_command.h"
+#include "heap_monitor.h"
 #include "ir_controller.h"
 #include "ir_learning.h"
+#include "ir_transfer.h"
+#include "kv_store.h"
 #include "led_indicator.h"
+#include "message_arena.h"
 #include "mqtt_client.h"
-
+#include "net_cache.h"
+#include "scheduler.h"
 #include "sensors.h"
 #include "state_manager.h"
+#include "subscription_manager.h"
 #include "wifi_manager.h"
 #include <ArduinoJson.h> // ✅ 新增：JSON库
+#include <cont.h>
 
 // ===== 全局变量定义 =====
 // 定时器配置（可通过MQTT动态修改）
@@ -37,22 +50,31 @@ uint32_t ghostWindow = DEFAULT_GHOST_WINDOW;
 
 // ===== 函数声明 =====
 void onMQTTMessage(char *topic, uint8_t *payload, unsigned int length);
+void onIRFrame(const Event &event);
 void onIRReceived(decode_results *results);
 void handleConfigUpdate(const char *json);
 void handleControlCommand(const char *json);
 void handleLearnCommand(const char *json);
+#if AUTO_DETECT_ENABLED
 void handleAutoDetectCommand(const char *json);   // ✅ 新增
+#endif
 void handleConfigBindingUpdate(const char *json); // ✅ 新增：处理绑定配置
 void printSystemInfo();
 void publishDeviceAnnounce();                   // ✅ 设备上线消息
 bool tryParseProtocol(decode_results *results); // ✅ 协议解析
 void publishIREvent(decode_results *results);   // ✅ 红外事件上报
+void serviceMQTT();                             // MQTT维护任务
+void publishHeartbeat();                        // 心跳任务
+bool shipLogs(const char *data, size_t length, const char *more,
+              size_t moreLength); // 日志上报
 
 // ===== 初始化 =====
 void setup() {
   // 1. 初始化串口
   Serial.begin(SERIAL_BAUD);
   delay(100);
+  Logger::begin(); // 日志经缓冲区由 log 任务写出
+  Logger::setShipper(shipLogs);
 
   DEBUG_PRINTLN();
   DEBUG_PRINTLN("========================================");
@@ -61,61 +83,63 @@ void setup() {
   DEBUG_PRINTLN("========================================");
   DEBUG_PRINTLN();
 
+  BootProfiler::mark("serial");
+
   // 2. 初始化配置管理器
   ConfigManager::init();
   ConfigManager::printConfig();
+  BootProfiler::mark("config");
 
-  // 3. 初始化LED指示
-  LEDIndicator::init();
-
-  // 4. 连接WiFi
-  WiFiManager::connect();
+  // 事件总线（各模块 init 时订阅）
+  EventBus::init();
 
-  // 等待WiFi连接
-  while (!WiFiManager::isConnected()) {
-    delay(100);
-    WiFiManager::maintain();
-    LEDIndicator::update();
-  }
+  // 恢复空调状态（RTC内存或Flash，需在首次发布 status 之前）
+  StateManager::init();
+  DeviceShadow::init();
+  BootProfiler::mark("state");
 
-  // 5. 连接MQTT
-  MQTTClient::setCallback(onMQTTMessage);
-  MQTTClient::connect();
+  // 3. 初始化LED指示
+  LEDIndicator::init();
 
-  // 等待MQTT连接
-  while (!MQTTClient::isConnected()) {
-    delay(100);
-    MQTTClient::loop();
-    LEDIndicator::update();
-  }
+  // ===== 本地子系统先于网络启动：网络慢时遥控器照常可用 =====
 
-  // 6. 初始化传感器
+  // 4. 初始化传感器
   if (Sensors::init()) {
     DEBUG_PRINTLN("[主程序] ✅ 传感器初始化成功");
   } else {
-    DEBUG_PRINTLN("[主程序] ⚠️  传感器初始化失败，部分功能不可用");
+    LOG_PRINTLN(WARN, "[主程序] ⚠️  传感器初始化失败，部分功能不可用");
   }
+  BootProfiler::mark("sensors");
 
-  // 7. 初始化红外控制器
+  // 5. 初始化红外控制器
   IRController::init();
-  IRController::setReceiveCallback(onIRReceived);
+  EventBus::subscribe(EVT_IR_FRAME, onIRFrame);
 
-  // 8. 初始化Ghost检测器
+  // 6. 初始化Ghost检测器
+#if GHOST_DETECTOR_ENABLED
   GhostDetector::init();
+#endif
+  BootProfiler::mark("ir");
 
-  // 10. 初始化状态管理器
-  StateManager::init();
-
-  // 10. 订阅配置更新topic（基于MAC地址）
-  String configTopic = "ac/config/" + WiFi.macAddress();
-  configTopic.replace(":", "");
-  MQTTClient::subscribe(configTopic.c_str());
-  DEBUG_PRINTF("[主程序] 已订阅配置topic: %s\n", configTopic.c_str());
-
-  // 11. 打印系统信息
+  // 7. 注册MQTT维护和心跳任务（其余模块在各自 init 中注册）
+  MQTTClient::setCallback(onMQTTMessage);
+  GroupCommand::setHandler(handleControlCommand);
+  DeviceShadow::setHandler(handleControlCommand);
+  MQTTClient::connect(); // 只配置，连接由 mqtt 任务在WiFi就绪后发起
+  TaskId mqttTask = Scheduler::addPeriodic("mqtt", MQTT_POLL_INTERVAL, serviceMQTT);
+  MQTTClient::setTask(mqttTask); // 收包/连接事件立即唤醒，不等下一个周期
+  Scheduler::addPeriodic("heartbeat", heartbeatInterval, publishHeartbeat);
+  HeapMonitor::init();
+  CommandTrace::init();
+
+  // 8. 启动WiFi状态机（有缓存时先尝试快速连接），连接在后台进行
+  NetCache::init();
+  WiFiManager::begin();
+
+  // 9. 打印系统信息
   printSystemInfo();
 
-  // 12. 发送设备上线消息 -> 移动到 loop 中检测到连接后发送
+  // 10. 发送设备上线消息 -> 移动到 MQTT 维护任务中检测到连接后发送
   // publishDeviceAnnounce();
 
   DEBUG_PRINTLN();
@@ -127,10 +151,20 @@ void setup() {
 
 // ===== 主循环 =====
 void loop() {
-  // 维护WiFi连接
-  WiFiManager::maintain();
+  // 发布路径的栈深度从这里算起
+  MessageArena::markStackBase();
+
+  // 执行到期任务，然后睡眠到下一个截止时间（或被中断唤醒）
+  uint32_t wait = Scheduler::run();
+  Scheduler::idle(wait);
+}
 
-  // 维护MQTT连接
+// ===== MQTT维护任务 =====
+void serviceMQTT() {
+  if (!WiFiManager::isConnected())
+    return;
+
+  // 维护MQTT连接（收包、keepalive、重连）
   MQTTClient::loop();
 
   // ✅ 新增：检测MQTT连接状态变化，发送上线/发现消息
@@ -138,75 +172,225 @@ void loop() {
   bool currentMqttConnected = MQTTClient::isConnected();
 
   if (currentMqttConnected && !lastMqttConnected) {
+    // 订阅（含 ac/config/<MAC>）已在连接时由 SubscriptionManager 建立
     DEBUG_PRINTLN("[主程序] MQTT已连接，发送上线消息...");
     publishDeviceAnnounce();
+
+    // 一条完整的影子状态代替重新下发全部命令
+    DeviceShadow::sync();
+
+    BootProfiler::markOnce("online");
+    BootProfiler::publish();
+    MQTTClient::publishBrokerStats();
   }
   lastMqttConnected = currentMqttConnected;
+}
 
-  // 更新LED状态
-  LEDIndicator::update();
+// ===== 心跳任务 =====
+void publishHeartbeat() {
+  if (!MQTTClient::isConnected())
+    return;
 
-  // 更新传感器（定时上报）
-  Sensors::update();
+  // 低内存时推迟（diag/heap 的摘要照常发布）
+  if (!HeapMonitor::allowOptional())
+    return;
 
-  // 处理红外接收
-  IRController::handleReceive();
+  // 任务表最多20项，加上各模块统计约需3.2KB，放在堆上
+  DynamicJsonDocument doc(3584);
+  doc["uptime"] = millis() / 1000;
+  doc["profile"] = BUILD_PROFILE;
+
+  // 启动到上线耗时
+  JsonObject boot = doc.createNestedObject("boot");
+  boot["onlineMs"] = MQTTClient::getOnlineTime();
+  boot["fastWiFi"] = WiFiManager::isFastConnected();
+
+  // WiFi状态机统计
+  const WiFiStats &ws = WiFiManager::getStats();
+  JsonObject wifi = doc.createNestedObject("wifi");
+  wifi["state"] = WiFiManager::stateName(WiFiManager::getState());
+  wifi["attempts"] = ws.attempts;
+  wifi["failures"] = ws.failures;
+  wifi["disconnects"] = ws.disconnects;
+  JsonObject trans = wifi.createNestedObject("transitions");
+  for (uint8_t i = 0; i < WIFI_STATE_COUNT; i++) {
+    trans[WiFiManager::stateName((WiFiState)i)] = ws.transitions[i];
+  }
+  doc["heap"] = ESP.getFreeHeap();
+  doc["rssi"] = WiFi.RSSI();
+
+  // 调度器抖动统计
+  JsonArray tasks = doc.createNestedArray("tasks");
+  for (uint8_t i = 0; i < Scheduler::getTaskCount(); i++) {
+    const SchedulerTask *task = Scheduler::getTask(i);
+    JsonObject t = tasks.createNestedObject();
+    t["name"] = task->name;
+    t["runs"] = task->runs;
+    t["lateAvg"] = task->runs > 0 ? task->lateTotalMs / task->runs : 0;
+    t["lateMax"] = task->lateMaxMs;
+    t["durMaxUs"] = task->durationMaxUs;
+  }
 
-  // 更新学习模式
-  IRLearning::update();
+  // 红外捕获统计
+  const IRCaptureStats &irStats = IRController::getCaptureStats();
+  JsonObject ir = doc.createNestedObject("ir");
+  ir["captured"] = irStats.captured;
+  ir["dropped"] = irStats.dropped;
+  ir["overflow"] = irStats.overflow;
+  ir["maxSlots"] = irStats.maxInUse;
+
+  // 事件队列深度统计
+  JsonObject events = doc.createNestedObject("events");
+  events["maxDepth"] = EventBus::getMaxDepth();
+  for (uint8_t i = 0; i < EVT_TYPE_COUNT; i++) {
+    const EventStats &es = EventBus::getStats((EventType)i);
+    JsonObject e = events.createNestedObject(EventBus::typeName((EventType)i));
+    e["posted"] = es.posted;
+    e["dropped"] = es.dropped;
+    e["depth"] = es.depth;
+    e["maxDepth"] = es.maxDepth;
+  }
+
+  // Flash写入统计
+  const KVStats &kv = KVStore::getStats();
+  JsonObject store = doc.createNestedObject("kv");
+  store["writes"] = kv.writes;
+  store["bytes"] = kv.bytes;
+  store["skipped"] = kv.skipped;
+  store["erases"] = kv.erases;
+  store["crcFails"] = kv.crcFails;
+
+  // 订阅统计
+  const SubscriptionStats &ss = SubscriptionManager::getStats();
+  JsonObject subs = doc.createNestedObject("subs");
+  subs["subscribes"] = ss.subscribes;
+  subs["unsubscribes"] = ss.unsubscribes;
+  subs["accepted"] = ss.accepted;
+  subs["dropped"] = ss.dropped;
+  subs["duplicates"] = ss.duplicates;
+
+  // 红外分片传输统计
+  const IRTransferStats &xs = IRTransfer::getStats();
+  JsonObject xfer = doc.createNestedObject("irChunks");
+  xfer["in"] = xs.chunksIn;
+  xfer["out"] = xs.chunksOut;
+  xfer["completed"] = xs.completed;
+  xfer["failed"] = xs.failed;
+
+  // MQTT传输统计
+  const MQTTTransportStats &ms = MQTTTransport::getStats();
+  JsonObject mqtt = doc.createNestedObject("mqtt");
+  mqtt["packetsIn"] = ms.packetsIn;
+  mqtt["packetsOut"] = ms.packetsOut;
+  mqtt["bytesIn"] = ms.bytesIn;
+  mqtt["bytesOut"] = ms.bytesOut;
+  mqtt["oversize"] = ms.oversize;
+  mqtt["writeStalls"] = ms.writeStalls;
+  mqtt["rxPeak"] = ms.rxPeak;
+  mqtt["aliasHits"] = ms.aliasHits;
+  mqtt["aliasSaved"] = ms.aliasSaved;
+
+  // 发布缓冲区与栈深度
+  const MessageArenaStats &as = MessageArena::getStats();
+  JsonObject arena = doc.createNestedObject("arena");
+  arena["size"] = MSG_ARENA_SIZE;
+  arena["used"] = as.used;
+  arena["peak"] = as.peak;
+  arena["leases"] = as.leases;
+  arena["failures"] = as.failures;
+  arena["stackPeak"] = as.stackPeak;
+  arena["freeStack"] = CONT_STACKSIZE - HeapMonitor::getStats().stackPeak;
+
+  // 日志缓冲区
+  const LogStats &ls = Logger::getStats();
+  JsonObject log = doc.createNestedObject("log");
+  log["pending"] = ls.pending;
+  log["peak"] = ls.peak;
+  log["dropped"] = ls.dropped;
+  log["batches"] = ls.batches;
+  log["shipDropped"] = ls.shipDropped;
+
+  String topic = MQTTClient::getTopic("heartbeat");
+  MQTTClient::publishJson(topic.c_str(), doc);
+}
+
+// ===== 日志上报（Logger 按批调用）=====
+bool shipLogs(const char *data, size_t length, const char *more,
+              size_t moreLength) {
+  if (!MQTTClient::isConnected() || !HeapMonitor::allowOptional())
+    return false;
+
+  // 纯文本，每行一条日志
+  String topic = MQTTClient::getTopic("log");
+  if (!MQTTClient::beginPublish(topic.c_str(), length + moreLength, false)) {
+    return false;
+  }
+  Print &out = MQTTClient::getWriter();
+  out.write((const uint8_t *)data, length);
+  out.write((const uint8_t *)more, moreLength);
+  return MQTTClient::endPublish();
+}
 
-  // 更新Ghost检测
-  GhostDetector::update();
+// ===== 红外帧事件消费者 =====
+void onIRFrame(const Event &event) {
+  BootProfiler::markOnce("first_ir");
+  onIRReceived(event.data.irFrame);
 
-  // 短暂延时
-  delay(10);
+  // 处理完毕，释放捕获槽
+  IRController::releaseFrame(event.data.irFrame);
 }
 
-// ===== 红外接收回调 =====
+// ===== 红外接收处理 =====
 void onIRReceived(decode_results *results) {
   DEBUG_PRINTLN("[主程序] 红外接收回调触发");
 
+#if AUTO_DETECT_ENABLED
   // ===== 优先级1: 自动检测模式 =====
   if (AutoDetect::isDetecting()) {
     DEBUG_PRINTLN("[主程序] 进入自动检测分析");
 
     DetectionResult result = AutoDetect::analyze(results);
 
-    // 构建MQTT消息
-    // ✅ 改为堆分配，防止Stack Smashing
-    DynamicJsonDocument doc(2048);
+    // 构建MQTT消息：字符串只保存指针（须在发布前保持有效），
+    // rawData 等长内容不再复制进文档
+    ArenaJsonDocument doc(384);
+    String protocol = result.overflow ? String("OVERFLOW")
+                                      : typeToString(result.protocol);
+    String description;
+    String raw;
     doc["success"] = result.success;
-    doc["protocol"] = result.protocol;
+    doc["protocol"] = protocol.c_str();
     doc["model"] = result.model;
 
     if (result.success && result.isAC) {
       doc["isAC"] = true;
-      doc["power"] = result.power;
-      doc["mode"] = result.mode;
-      doc["temp"] = result.temp;
-      doc["fan"] = result.fan;
-      doc["swingV"] = result.swingV;
-      doc["swingH"] = result.swingH;
-      doc["description"] = result.description;
+      doc["power"] = (bool)result.state.power;
+      doc["mode"] = acModeName(result.state.mode);
+      doc["temp"] = result.state.temp;
+      doc["fan"] = (uint8_t)result.state.fan;
+      doc["swingV"] = (bool)result.state.swingV;
+      doc["swingH"] = (bool)result.state.swingH;
+      description = protocol + " (Model " + String(result.model) + ")";
+      doc["description"] = description.c_str();
 
       DEBUG_PRINTLN("[主程序] ✅ AC协议识别成功，上报结果");
-    } else if (!result.success) {
-      doc["rawData"] = result.rawData;
-      DEBUG_PRINTLN("[主程序] ❌ 协议未识别，返回raw数据");
+    } else if (result.success) {
+      doc["description"] = "Known Protocol (Not AC)";
+    } else if (!result.overflow) {
+      raw = resultToSourceCode(results);
+      doc["rawData"] = raw.c_str();
+      LOG_PRINTLN(ERROR, "[主程序] ❌ 协议未识别，返回raw数据");
     }
 
-    // ✅ 改为String (堆分配)，防止Stack Overflow
-    String payload;
-    serializeJson(doc, payload);
-
     String topic = MQTTClient::getTopic("auto_detect/result");
-    MQTTClient::publish(topic.c_str(), payload.c_str());
+    MQTTClient::publishJson(topic.c_str(), doc);
 
     // 自动停止检测
     AutoDetect::stop();
 
     return; // 不继续其他处理
   }
+#endif
 
   // ===== 优先级2: 学习模式 =====
   if (IRLearning::isLearning()) {
@@ -216,8 +400,10 @@ void onIRReceived(decode_results *results) {
 
   // ===== 优先级3: 正常模式 - 完整解析 =====
 
+#if GHOST_DETECTOR_ENABLED
   // 触发Ghost检测
   GhostDetector::onIRReceived();
+#endif
 
   // 尝试协议解析
   if (tryParseProtocol(results)) {
@@ -226,7 +412,7 @@ void onIRReceived(decode_results *results) {
   }
 
   // 都不匹配，只发布事件
-  DEBUG_PRINTLN("[主程序] ⚠️ 无法解析，只发布事件");
+  LOG_PRINTLN(WARN, "[主程序] ⚠️ 无法解析，只发布事件");
   publishIREvent(results);
 }
 
@@ -253,45 +439,17 @@ bool tryParseProtocol(decode_results *results) {
   // 尝试解析状态（IRremoteESP8266的高级功能）
   stdAc::state_t state;
   if (!IRAcUtils::decodeToState(results, &state)) {
-    DEBUG_PRINTLN("[协议解析] ❌ 状态解析失败");
+    LOG_PRINTLN(ERROR, "[协议解析] ❌ 状态解析失败");
     return false;
   }
 
-  // 提取参数并更新状态
-  bool power = state.power;
-  const char *mode = "cool";
-
-  // 转换模式
-  switch (state.mode) {
-  case stdAc::opmode_t::kCool:
-    mode = "cool";
-    break;
-  case stdAc::opmode_t::kHeat:
-    mode = "heat";
-    break;
-  case stdAc::opmode_t::kFan:
-    mode = "fan";
-    break;
-  case stdAc::opmode_t::kDry:
-    mode = "dry";
-    break;
-  case stdAc::opmode_t::kAuto:
-    mode = "auto";
-    break;
-  default:
-    mode = "cool";
-  }
-
-  uint8_t temp = state.degrees;
-  uint8_t fan = (uint8_t)state.fanspeed;
-  bool swingV = state.swingv != stdAc::swingv_t::kOff;
-  bool swingH = state.swingh != stdAc::swingh_t::kOff;
+  // 提取参数并更新状态（与自动检测、品牌发送共用转换表）
+  ACState decoded = acStateFromStdAc(state, AC_SOURCE_IR_PROTOCOL);
+  StateManager::setState(decoded, AC_SOURCE_IR_PROTOCOL);
 
-  // 更新状态
-  StateManager::setState(power, mode, temp, fan, swingV, swingH, "ir_protocol");
-
-  DEBUG_PRINTF("[协议解析] ✅ 解析成功: %s %s %d°C\n", power ? "开" : "关",
-               mode, temp);
+  DEBUG_PRINTF("[协议解析] ✅ 解析成功: %s %s %d°C\n",
+               decoded.power ? "开" : "关", acModeName(decoded.mode),
+               decoded.temp);
 
   return true;
 }
@@ -299,35 +457,40 @@ bool tryParseProtocol(decode_results *results) {
 // ===== 发布红外事件 =====
 void publishIREvent(decode_results *results) {
   DEBUG_PRINTLN("[主程序] 发布红外事件");
-  StaticJsonDocument<512> doc;
-  doc["type"] = "ir_event";
-  doc["protocol"] =
+  String protocol =
       typeToString(results->decode_type); // 使用IRremoteESP8266的函数
-  doc["value"] = uint64ToString(results->value, 16);
-  doc["bits"] = results->bits;
-  doc["rawData"] = IRController::getLastRawData(); // 使用IRController的方法
+  String value = uint64ToString(results->value, 16);
+  String raw = IRController::getRawData(results); // 使用IRController的方法
 
-  char payload[512];
-  serializeJson(doc, payload);
+  // 字符串只保存指针，序列化时直接读取
+  ArenaJsonDocument doc(128);
+  doc["type"] = "ir_event";
+  doc["protocol"] = protocol.c_str();
+  doc["value"] = value.c_str();
+  doc["bits"] = results->bits;
+  doc["rawData"] = raw.c_str();
 
   String topic = MQTTClient::getTopic("ir_event");
-  MQTTClient::publish(topic.c_str(), payload);
+  MQTTClient::publishJson(topic.c_str(), doc);
 }
 
 // ===== MQTT消息回调函数 =====
 void onMQTTMessage(char *topic, uint8_t *payload, unsigned int length) {
   DEBUG_PRINTLN("[主程序] 处理MQTT消息");
 
-  // 转换payload为字符串
-  char message[length + 1];
-  memcpy(message, payload, length);
-  message[length] = '\0';
+  // payload 在接收缓冲区中原地以 '\0' 结尾，直接作为字符串使用
+  const char *message = (const char *)payload;
 
   String topicStr = String(topic);
-  String msgStr = String(message);
 
-  DEBUG_PRINTF("[主程序] Topic: %s\n", topic);
-  DEBUG_PRINTF("[主程序] Message: %s\n", message);
+  LOG_PRINTF(DEBUG, "[主程序] Topic: %s\n", topic);
+  LOG_PRINTF(DEBUG, "[主程序] Message: %s\n", message);
+
+  // 分组命令：按本设备的错峰延迟执行，与 /cmd 使用同一处理函数
+  if (GroupCommand::isGroupTopic(topic)) {
+    GroupCommand::handle(topic, message);
+    return;
+  }
 
   // ✅ 优先处理：设备绑定配置 (包含 /config/update)
   if (topicStr.indexOf("/config/update") >= 0) {
@@ -345,7 +508,10 @@ void onMQTTMessage(char *topic, uint8_t *payload, unsigned int length) {
 
   // 处理其他命令
   if (topicStr.endsWith("/cmd")) {
+    // 带 id 的命令记录各阶段耗时，在 cmd/ack 应答
+    CommandTrace::arm(MQTTClient::getReceivedTime());
     handleControlCommand(message);
+    CommandTrace::disarm();
 
   } else if (topicStr.endsWith("/learn/start")) {
     handleLearnCommand(message);
@@ -353,14 +519,26 @@ void onMQTTMessage(char *topic, uint8_t *payload, unsigned int length) {
   } else if (topicStr.endsWith("/config")) {
     handleConfigUpdate(message);
 
+#if AUTO_DETECT_ENABLED
   } else if (topicStr.endsWith("/auto_detect")) {
     handleAutoDetectCommand(message);
+#endif
+
+  } else if (topicStr.endsWith("/shadow/desired")) {
+    DeviceShadow::handleDesired(message);
+
+  } else if (topicStr.endsWith("/ir/chunk")) {
+    // 超长原始码分片（原地解析，直接使用接收缓冲区）
+    IRTransfer::handleChunk((char *)payload);
 
   } else if (topicStr.endsWith("/brands/get")) { // ✅ 新增：获取品牌列表
     DEBUG_PRINTLN("[主程序] → 请求品牌列表");
     String json = IRController::getSupportedBrandsJSON();
-    String topic = MQTTClient::getTopic("brands/list");
-    MQTTClient::publish(topic.c_str(), json.c_str());
+    // MQTT 5 请求带应答topic时直接应答，否则发布到 brands/list
+    if (!MQTTClient::reply(json.c_str())) {
+      String topic = MQTTClient::getTopic("brands/list");
+      MQTTClient::publish(topic.c_str(), json.c_str());
+    }
   }
 }
 
@@ -368,44 +546,27 @@ void onMQTTMessage(char *topic, uint8_t *payload, unsigned int length) {
 void handleControlCommand(const char *json) {
   DEBUG_PRINTLN("[主程序] → 收到控制命令");
 
-  // 解析JSON命令
-  StaticJsonDocument<512> doc;
-  DeserializationError error = deserializeJson(doc, json);
-
-  if (error) {
-    DEBUG_PRINTLN("[主程序] ❌ JSON解析失败");
+  // 单遍解析（不建JSON文档）：缺省字段保持当前值（部分命令/影子增量不会误关机），
+  // setTemp (新标准) 优先于 temp (旧标准)
+  ControlCommand cmd;
+  if (!CommandParser::parse(json, StateManager::getState(), cmd)) {
+    LOG_PRINTLN(ERROR, "[主程序] ❌ JSON解析失败");
     return;
   }
-
-  // 解析空调状态参数
-  bool power = doc["power"] | false;
-  const char *mode = doc["mode"] | "cool";
-
-  // ✅ 修复: 优先使用 setTemp (新标准)，兼容 temp (旧标准)
-  uint8_t temp = 26;
-  if (doc.containsKey("setTemp")) {
-    temp = doc["setTemp"];
-  } else {
-    temp = doc["temp"] | 26;
-  }
-
-  uint8_t fan = doc["fan"] | 0;
-  bool swingV = doc["swingVertical"] | false;
-  bool swingH = doc["swingHorizontal"] | false;
+  CommandTrace::start(cmd.id);
+  CommandTrace::mark(TRACE_PARSED);
 
   // ===== ✅ 优先级0: 临时指令 (Ephemeral Command) =====
-  if (doc.containsKey("brand")) {
-    const char *ephBrand = doc["brand"];
-    int ephModel = doc["model"] | 1; // 默认 Model 1
-    DEBUG_PRINTF("[主程序] 收到临时测试指令: %s (Model=%d)\n", ephBrand,
-                 ephModel);
-
-    if (IRController::sendBrand(ephBrand, ephModel, power, mode, temp, fan,
-                                swingV, swingH)) {
+  if (cmd.fields & CMD_FIELD_BRAND) {
+    DEBUG_PRINTF("[主程序] 收到临时测试指令: %s (Model=%d)\n", cmd.brand,
+                 cmd.model);
+
+    if (IRController::sendBrand(cmd.brand, cmd.model, cmd.state)) {
       DEBUG_PRINTLN("[主程序] ✅ 临时指令发送成功");
+      CommandTrace::complete("brand", true, false); // 临时指令不改变状态
       return;
     } else {
-      DEBUG_PRINTLN("[主程序] ❌ 临时指令发送失败 (不支持的协议?)");
+      LOG_PRINTLN(ERROR, "[主程序] ❌ 临时指令发送失败 (不支持的协议?)");
     }
   }
 
@@ -414,33 +575,34 @@ void handleControlCommand(const char *json) {
   if (cfg.brand[0] != '\0') { // 如果配置了品牌
     DEBUG_PRINTF("[主程序] 使用品牌协议: %s\n", cfg.brand);
 
-    if (IRController::sendBrand(cfg.brand, cfg.model, power, mode, temp, fan,
-                                swingV, swingH)) {
+    if (IRController::sendBrand(cfg.brand, cfg.model, cmd.state)) {
       // 发送成功，更新状态
-      StateManager::setState(power, mode, temp, fan, swingV, swingH, "api");
+      StateManager::setState(cmd.state, AC_SOURCE_API);
       DEBUG_PRINTLN("[主程序] ✅ 品牌协议命令已发送");
+      CommandTrace::complete("config", true, true);
       return;
     } else {
-      DEBUG_PRINTLN("[主程序] ⚠️ 品牌协议发送失败，尝试raw模式");
+      LOG_PRINTLN(WARN, "[主程序] ⚠️ 品牌协议发送失败，尝试raw模式");
       // 继续尝试raw模式
     }
   }
 
   // ===== ⚠️ 优先级2: Raw模式（降级） =====
-  if (doc.containsKey("raw")) {
-    const char *rawData = doc["raw"];
+  if (cmd.fields & CMD_FIELD_RAW) {
     DEBUG_PRINTLN("[主程序] 使用raw红外数据");
-    IRController::sendRaw(rawData);
+    bool sent = IRController::sendRaw(cmd.raw, cmd.rawLength);
 
-    // 更新状态（从JSON）
-    StateManager::updateFromJSON(json);
+    // 更新状态（同一次解析的结果，来源可由命令中的 source 指定）
+    StateManager::setState(cmd.state, cmd.state.source);
     DEBUG_PRINTLN("[主程序] ✅ Raw命令已发送");
+    CommandTrace::complete("raw", sent, true);
     return;
   }
 
   // ===== ❌ 降级：只记录状态 =====
-  DEBUG_PRINTLN("[主程序] ⚠️ 无品牌配置且无raw数据，只记录状态");
-  StateManager::setState(power, mode, temp, fan, swingV, swingH, "api");
+  LOG_PRINTLN(WARN, "[主程序] ⚠️ 无品牌配置且无raw数据，只记录状态");
+  StateManager::setState(cmd.state, AC_SOURCE_API);
+  CommandTrace::complete("state", true, true);
 }
 
 // ===== 处理学习命令 =====
@@ -454,7 +616,7 @@ void handleLearnCommand(const char *json) {
     const char *key = doc["key"];
     IRLearning::start(key);
   } else {
-    DEBUG_PRINTLN("[主程序] ❌ 学习指令格式错误");
+    LOG_PRINTLN(ERROR, "[主程序] ❌ 学习指令格式错误");
   }
 }
 
@@ -468,13 +630,19 @@ void handleConfigUpdate(const char *json) {
     // 打印新配置
     ConfigManager::printConfig();
 
+    // 应用新的上报间隔
+    Sensors::setInterval(ConfigManager::getConfig().sensorInterval);
+
     // 发布配置确认消息
     String ackTopic = "ac/config_ack/" + WiFi.macAddress();
     ackTopic.replace(":", "");
     MQTTClient::publish(ackTopic.c_str(),
                         "{\"status\":\"ok\",\"updated\":true}");
+
+    // 服务器列表变化时切换连接，否则同步分组订阅（确认消息已先发出）
+    MQTTClient::applyConfig();
   } else {
-    DEBUG_PRINTLN("[配置更新] ❌ 配置更新失败");
+    LOG_PRINTLN(ERROR, "[配置更新] ❌ 配置更新失败");
   }
 }
 
@@ -484,6 +652,7 @@ void printSystemInfo() {
 
   DEBUG_PRINTLN("\n[系统信息]");
   DEBUG_PRINTF("  芯片ID: 0x%08X\n", ESP.getChipId());
+  DEBUG_PRINTF("  构建配置: %s\n", BUILD_PROFILE);
   DEBUG_PRINT("  MAC地址: ");
   DEBUG_PRINTLN(WiFiManager::getMACAddress());
   DEBUG_PRINT("  IP地址: ");
@@ -491,12 +660,15 @@ void printSystemInfo() {
   DEBUG_PRINT("  空闲内存: ");
   DEBUG_PRINT(ESP.getFreeHeap());
   DEBUG_PRINTLN(" bytes");
+  DEBUG_PRINTF("  最大连续块: %u bytes (碎片 %u%%)\n", ESP.getMaxFreeBlockSize(),
+               ESP.getHeapFragmentation());
   DEBUG_PRINT("  设备UUID: ");
   DEBUG_PRINTLN(cfg.deviceUUID);
   DEBUG_PRINTF("  用户ID: %u\n", cfg.userId);
   DEBUG_PRINTF("  MQTT服务器: %s:%d\n", cfg.mqttServer, cfg.mqttPort);
 }
 
+#if AUTO_DETECT_ENABLED
 // ===== 处理自动检测命令 =====
 void handleAutoDetectCommand(const char *json) {
   DEBUG_PRINTLN("[主程序] → 收到自动检测指令");
@@ -506,7 +678,7 @@ void handleAutoDetectCommand(const char *json) {
   DeserializationError error = deserializeJson(doc, json);
 
   if (error) {
-    DEBUG_PRINTLN("[自动检测] ❌ JSON解析失败");
+    LOG_PRINTLN(ERROR, "[自动检测] ❌ JSON解析失败");
     return;
   }
 
@@ -517,34 +689,29 @@ void handleAutoDetectCommand(const char *json) {
     AutoDetect::start();
 
     // 上报状态
-    StaticJsonDocument<128> statusDoc;
+    ArenaJsonDocument statusDoc(64);
     statusDoc["status"] = "detecting";
     statusDoc["timeout"] = 30;
     statusDoc["message"] = "请在30秒内按下遥控器任意键";
 
-    char payload[128];
-    serializeJson(statusDoc, payload);
-
     String topic = MQTTClient::getTopic("auto_detect/status");
-    MQTTClient::publish(topic.c_str(), payload);
+    MQTTClient::publishJson(topic.c_str(), statusDoc);
 
     DEBUG_PRINTLN("[自动检测] ✅ 已启动，等待红外信号");
   } else if (strcmp(action, "stop") == 0) {
     // 停止自动检测
     AutoDetect::stop();
 
-    StaticJsonDocument<64> statusDoc;
+    ArenaJsonDocument statusDoc(32);
     statusDoc["status"] = "idle";
 
-    char payload[64];
-    serializeJson(statusDoc, payload);
-
     String topic = MQTTClient::getTopic("auto_detect/status");
-    MQTTClient::publish(topic.c_str(), payload);
+    MQTTClient::publishJson(topic.c_str(), statusDoc);
 
     DEBUG_PRINTLN("[自动检测] ⏹ 已停止");
   }
 }
+#endif
 
 // ===== 发送设备上线消息（用于设备发现）=====
 void publishDeviceAnnounce() {
@@ -555,26 +722,31 @@ void publishDeviceAnnounce() {
     DEBUG_PRINTLN("[设备发现] 发送上线消息...");
 
     // 构建JSON消息
-    StaticJsonDocument<256> doc;
+    ArenaJsonDocument doc(256);
     doc["uuid"] = cfg.deviceUUID;
     doc["mac"] = WiFi.macAddress();
     doc["ip"] = WiFi.localIP().toString();
     doc["userId"] = cfg.userId;
     doc["brand"] = cfg.brand;
     doc["model"] = cfg.model;
+    doc["fw"] = FIRMWARE_VERSION;
     doc["timestamp"] = millis();
 
-    char payload[256];
-    serializeJson(doc, payload);
-
     // 发布到 ac/discovery/<UUID>
     String topic = "ac/discovery/" + String(cfg.deviceUUID);
-    MQTTClient::publish(topic.c_str(), payload,
-                        false); // ✅ 取消 Retained (User Request)
+    MQTTClient::publishJson(topic.c_str(), doc,
+                            false); // ✅ 取消 Retained (User Request)
 
     DEBUG_PRINTLN("[设备发现] ✅ 上线消息已发送");
-    DEBUG_PRINTF("[设备发现] Topic: %s\n", topic.c_str());
-    DEBUG_PRINTF("[设备发现] Payload: %s\n", payload);
+    LOG_PRINTF(DEBUG, "[设备发现] Topic: %s\n", topic.c_str());
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    if (Logger::enabled(LOG_MODULE, LOG_LEVEL_DEBUG)) {
+      Print &log = Logger::at(LOG_MODULE, LOG_LEVEL_DEBUG);
+      log.print("[设备发现] Payload: ");
+      serializeJson(doc, log);
+      log.println();
+    }
+#endif
   } else {
     DEBUG_PRINTF("[设备发现] 设备已绑定（用户ID: %u），跳过发现消息\n",
                  cfg.userId);
@@ -589,13 +761,13 @@ void handleConfigBindingUpdate(const char *json) {
   DeserializationError error = deserializeJson(doc, json);
 
   if (error) {
-    DEBUG_PRINTLN("[绑定配置] ❌ JSON解析失败");
+    LOG_PRINTLN(ERROR, "[绑定配置] ❌ JSON解析失败");
     return;
   }
 
   // 提取userId和deviceId
   if (!doc.containsKey("userId") || !doc.containsKey("deviceId")) {
-    DEBUG_PRINTLN("[绑定配置] ❌ 缺少必需字段");
+    LOG_PRINTLN(ERROR, "[绑定配置] ❌ 缺少必需字段");
     return;
   }
 
@@ -605,22 +777,14 @@ void handleConfigBindingUpdate(const char *json) {
   DEBUG_PRINTF("[绑定配置] 收到绑定配置 - userID: %u, deviceID: %u\n", userId,
                deviceId);
 
-  // 保存到EEPROM
-  ConfigManager::saveUserId(userId);
-  ConfigManager::saveDeviceId(deviceId);
-
-  // ✅ 关键修复：必须调用 save() 更新结构体和校验和！
-  // 否则下次启动 load() 会读取旧的结构体（UserId=0）且校验通过，覆盖正确的配置
-  ConfigManager::save();
-
-  DEBUG_PRINTLN("[绑定配置] ✅ 配置已保存到EEPROM");
+  // userId和deviceId一次事务写入（与已存储值相同时不写Flash）
+  if (!ConfigManager::saveBinding(userId, deviceId)) {
+    LOG_PRINTLN(ERROR, "[绑定配置] ❌ 配置保存失败");
+  }
 
   // 重新订阅MQTT topic（使用新的userId）
   MQTTClient::resubscribe();
 
-  // 延迟一下，确保订阅生效
-  delay(100);
-
   // 发布确认消息
   publishDeviceAnnounce();
 
@@ -0,0 +1,185 @@
+/*
+ * 空调状态类型
+ *
+ * 功能：
+ * - ACState：4字节紧凑状态（枚举 + 位域），状态管理、红外收发、自动检测、
+ *   状态上报和命令解析共用；复制、比较和持久化都不分配内存
+ * - 模式/风速/来源与JSON字符串、IRremoteESP8266 stdAc 枚举之间的
+ *   constexpr 转换表（各模块不再各写一套 strcmp/switch）
+ *
+ * 风速统一使用 stdAc 的档位顺序（与前端 0=自动、1-5 档一致）：
+ *   0=自动 1=最低 2=低 3=中 4=高 5=最高
+ */
+
+#ifndef AC_STATE_H
+#define AC_STATE_H
+
+#include <Arduino.h>
+#include <IRsend.h> // stdAc::state_t
+
+#define AC_TEMP_MIN 10
+#define AC_TEMP_MAX 31
+
+// 运行模式（顺序与 stdAc::opmode_t 相同）
+enum ACMode {
+  AC_MODE_AUTO,
+  AC_MODE_COOL,
+  AC_MODE_HEAT,
+  AC_MODE_DRY,
+  AC_MODE_FAN,
+  AC_MODE_COUNT
+};
+
+// 风速（顺序与 stdAc::fanspeed_t 前6档相同）
+enum ACFan {
+  AC_FAN_AUTO,
+  AC_FAN_MIN,
+  AC_FAN_LOW,
+  AC_FAN_MEDIUM,
+  AC_FAN_HIGH,
+  AC_FAN_MAX,
+  AC_FAN_COUNT
+};
+
+// 状态来源
+enum ACSource {
+  AC_SOURCE_INIT,
+  AC_SOURCE_API,         // MQTT命令
+  AC_SOURCE_IR_PROTOCOL, // 遥控器信号（协议解析）
+  AC_SOURCE_MANUAL,
+  AC_SOURCE_RTC,         // 热重启从RTC内存恢复
+  AC_SOURCE_FLASH,       // 冷启动从Flash恢复
+  AC_SOURCE_COUNT
+};
+
+// 空调状态（4字节）
+struct ACState {
+  ACMode mode : 4;
+  ACFan fan : 4;
+  uint8_t temp;        // 设定温度 AC_TEMP_MIN-AC_TEMP_MAX
+  ACSource source : 8;
+  bool power : 1;
+  bool swingV : 1;     // 垂直扫风
+  bool swingH : 1;     // 水平扫风
+} __attribute__((packed));
+
+static_assert(sizeof(ACState) == 4, "ACState 应为4字节");
+
+// ===== 转换表 =====
+
+constexpr const char *AC_MODE_NAMES[AC_MODE_COUNT] = {"auto", "cool", "heat",
+                                                      "dry", "fan"};
+
+constexpr const char *AC_SOURCE_NAMES[AC_SOURCE_COUNT] = {
+    "init", "api", "ir_protocol", "manual", "rtc", "flash"};
+
+constexpr stdAc::opmode_t AC_MODE_TO_STDAC[AC_MODE_COUNT] = {
+    stdAc::opmode_t::kAuto, stdAc::opmode_t::kCool, stdAc::opmode_t::kHeat,
+    stdAc::opmode_t::kDry, stdAc::opmode_t::kFan};
+
+constexpr stdAc::fanspeed_t AC_FAN_TO_STDAC[AC_FAN_COUNT] = {
+    stdAc::fanspeed_t::kAuto, stdAc::fanspeed_t::kMin,
+    stdAc::fanspeed_t::kLow,  stdAc::fanspeed_t::kMedium,
+    stdAc::fanspeed_t::kHigh, stdAc::fanspeed_t::kMax};
+
+// stdAc::fanspeed_t 按数值索引；新版库的 kMediumHigh(6)/kLowMedium(7)
+// 归入相邻档位
+constexpr ACFan AC_FAN_FROM_STDAC[] = {
+    AC_FAN_AUTO, AC_FAN_MIN,  AC_FAN_LOW,  AC_FAN_MEDIUM,
+    AC_FAN_HIGH, AC_FAN_MAX,  AC_FAN_HIGH, AC_FAN_MEDIUM};
+
+// ===== 转换函数 =====
+
+constexpr const char *acModeName(ACMode mode) {
+  return mode < AC_MODE_COUNT ? AC_MODE_NAMES[mode] : "auto";
+}
+
+constexpr const char *acSourceName(ACSource source) {
+  return source < AC_SOURCE_COUNT ? AC_SOURCE_NAMES[source] : "init";
+}
+
+constexpr ACFan acFanFromLevel(int level) {
+  return level <= 0 ? AC_FAN_AUTO
+                    : level >= AC_FAN_MAX ? AC_FAN_MAX : (ACFan)level;
+}
+
+constexpr uint8_t acClampTemp(int temp) {
+  return temp < AC_TEMP_MIN ? AC_TEMP_MIN
+                            : temp > AC_TEMP_MAX ? AC_TEMP_MAX : temp;
+}
+
+constexpr ACMode acModeFromStdAc(stdAc::opmode_t mode) {
+  // kOff(-1) 等不在表内的值按自动处理
+  return (int)mode >= 0 && (int)mode < AC_MODE_COUNT ? (ACMode)(int)mode
+                                                     : AC_MODE_AUTO;
+}
+
+constexpr ACFan acFanFromStdAc(stdAc::fanspeed_t speed) {
+  return (int)speed >= 0 &&
+                 (size_t)speed < sizeof(AC_FAN_FROM_STDAC) /
+                                     sizeof(AC_FAN_FROM_STDAC[0])
+             ? AC_FAN_FROM_STDAC[(int)speed]
+             : AC_FAN_AUTO;
+}
+
+// 名称视图（不要求 '\0' 结尾）与表中字符串比较
+inline bool acNameEquals(const char *name, size_t length, const char *entry) {
+  return strncmp(name, entry, length) == 0 && entry[length] == '\0';
+}
+
+// 模式字符串（JSON）转枚举，无法识别时返回 fallback；兼容 "fan_only"
+inline ACMode acModeFromName(const char *name, size_t length,
+                             ACMode fallback) {
+  for (uint8_t i = 0; i < AC_MODE_COUNT; i++) {
+    if (acNameEquals(name, length, AC_MODE_NAMES[i])) {
+      return (ACMode)i;
+    }
+  }
+  return acNameEquals(name, length, "fan_only") ? AC_MODE_FAN : fallback;
+}
+
+inline ACMode acModeFromName(const char *name, ACMode fallback) {
+  return name != nullptr ? acModeFromName(name, strlen(name), fallback)
+                         : fallback;
+}
+
+// 来源字符串转枚举，无法识别时按 MQTT 命令处理
+inline ACSource acSourceFromName(const char *name, size_t length) {
+  for (uint8_t i = 0; i < AC_SOURCE_COUNT; i++) {
+    if (acNameEquals(name, length, AC_SOURCE_NAMES[i])) {
+      return (ACSource)i;
+    }
+  }
+  return AC_SOURCE_API;
+}
+
+// 两个状态的空调设置是否相同（不比较来源）
+inline bool acSameSettings(const ACState &a, const ACState &b) {
+  return a.power == b.power && a.mode == b.mode && a.temp == b.temp &&
+         a.fan == b.fan && a.swingV == b.swingV && a.swingH == b.swingH;
+}
+
+// stdAc 状态（红外解码结果）转 ACState
+inline ACState acStateFromStdAc(const stdAc::state_t &in, ACSource source) {
+  ACState out;
+  out.mode = acModeFromStdAc(in.mode);
+  out.fan = acFanFromStdAc(in.fanspeed);
+  out.temp = acClampTemp((int)in.degrees);
+  out.source = source;
+  out.power = in.power;
+  out.swingV = in.swingv != stdAc::swingv_t::kOff;
+  out.swingH = in.swingh != stdAc::swingh_t::kOff;
+  return out;
+}
+
+// ACState 填入 stdAc 状态（红外发送），协议和型号由调用方设置
+inline void acStateToStdAc(const ACState &in, stdAc::state_t &out) {
+  out.power = in.power;
+  out.mode = AC_MODE_TO_STDAC[in.mode < AC_MODE_COUNT ? in.mode : 0];
+  out.degrees = in.temp;
+  out.fanspeed = AC_FAN_TO_STDAC[in.fan < AC_FAN_COUNT ? in.fan : 0];
+  out.swingv = in.swingV ? stdAc::swingv_t::kAuto : stdAc::swingv_t::kOff;
+  out.swingh = in.swingH ? stdAc::swingh_t::kAuto : stdAc::swingh_t::kOff;
+}
+
+#endif // AC_STATE_H
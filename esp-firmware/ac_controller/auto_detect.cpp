@@ -2,34 +2,44 @@
  * 自动协议检测模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_IR
+
 #include "auto_detect.h"
 
+#if AUTO_DETECT_ENABLED
+
 // 静态成员初始化
 bool AutoDetect::detecting = false;
 unsigned long AutoDetect::startTime = 0;
+TaskId AutoDetect::timeoutTask = SCHED_INVALID_TASK;
 
 void AutoDetect::start() {
   detecting = true;
   startTime = millis();
+
+  if (timeoutTask == SCHED_INVALID_TASK) {
+    timeoutTask = Scheduler::addOneShot("detect_timeout", onTimeout);
+  }
+  Scheduler::schedule(timeoutTask, DETECT_TIMEOUT);
   DEBUG_PRINTLN("[自动检测] ✅ 已启动，请在30秒内按下遥控器任意键");
   DEBUG_PRINTLN("[自动检测] 💡 建议按：开机键 或 制冷26度");
 }
 
 void AutoDetect::stop() {
   detecting = false;
+  Scheduler::cancel(timeoutTask);
   DEBUG_PRINTLN("[自动检测] ⏹ 已停止");
 }
 
-bool AutoDetect::isDetecting() {
-  // 检查超时
-  if (detecting && (millis() - startTime > DETECT_TIMEOUT)) {
+void AutoDetect::onTimeout() {
+  if (detecting) {
     DEBUG_PRINTLN("[自动检测] ⏱ 超时，自动停止");
     stop();
-    return false;
   }
-  return detecting;
 }
 
+bool AutoDetect::isDetecting() { return detecting; }
+
 String AutoDetect::getStatus() {
   if (!detecting) {
     return "idle";
@@ -43,16 +53,13 @@ String AutoDetect::getStatus() {
 
 DetectionResult AutoDetect::analyze(decode_results *results) {
   DetectionResult result;
-  result.success = false;
-  result.isAC = false;
-  result.model = 0;
-  result.power = false; // Default
-  result.temp = 26;     // Default
+  memset(&result, 0, sizeof(result));
+  result.protocol = decode_type_t::UNKNOWN;
 
   // 1. Check overflow
   if (results->overflow) {
-    DEBUG_PRINTLN("[自动检测] ⚠️ 缓冲区溢出！");
-    result.protocol = "OVERFLOW";
+    LOG_PRINTLN(WARN, "[自动检测] ⚠️ 缓冲区溢出！");
+    result.overflow = true;
     return result;
   }
 
@@ -64,73 +71,24 @@ DetectionResult AutoDetect::analyze(decode_results *results) {
 
     result.success = true;
     result.isAC = true;
-    result.protocol = typeToString(state.protocol);
+    result.protocol = state.protocol;
     result.model = state.model; // Key: Internal Model ID
 
-    result.power = state.power;
-    result.temp = state.degrees;
-
-    // Map Mode
-    switch (state.mode) {
-    case stdAc::opmode_t::kCool:
-      result.mode = "cool";
-      break;
-    case stdAc::opmode_t::kHeat:
-      result.mode = "heat";
-      break;
-    case stdAc::opmode_t::kDry:
-      result.mode = "dry";
-      break;
-    case stdAc::opmode_t::kFan:
-      result.mode = "fan";
-      break;
-    case stdAc::opmode_t::kAuto:
-      result.mode = "auto";
-      break;
-    default:
-      result.mode = "auto";
-      break;
-    }
+    // 模式/风速/摆风按 ac_state.h 的转换表（与协议解析、发送一致）
+    result.state = acStateFromStdAc(state, AC_SOURCE_IR_PROTOCOL);
 
-    // Map Fan
-    switch (state.fanspeed) {
-    case stdAc::fanspeed_t::kLow:
-      result.fan = 1;
-      break;
-    case stdAc::fanspeed_t::kMedium:
-      result.fan = 2;
-      break;
-    case stdAc::fanspeed_t::kHigh:
-      result.fan = 3;
-      break;
-    default:
-      result.fan = 0;
-      break;
-    }
-
-    // Map Swing
-    result.swingV = (state.swingv != stdAc::swingv_t::kOff);
-    result.swingH = (state.swingh != stdAc::swingh_t::kOff);
-
-    // Human Readable Description
-    result.description =
-        result.protocol + " (Model " + String(result.model) + ")";
-
-    DEBUG_PRINTF("[自动检测] 结果: %s, Power=%d, Temp=%d\n",
-                 result.description.c_str(), result.power, result.temp);
+    DEBUG_PRINTF("[自动检测] 结果: %s (Model %d), Power=%d, Temp=%d\n",
+                 typeToString(state.protocol).c_str(), result.model,
+                 result.state.power, result.state.temp);
 
   } else {
     // Fallback: Not a standard AC signal
-    DEBUG_PRINTLN("[自动检测] ❌ 未识别为空调信号");
+    LOG_PRINTLN(ERROR, "[自动检测] ❌ 未识别为空调信号");
 
     if (results->decode_type != decode_type_t::UNKNOWN) {
       // Known protocol but unknown content
       result.success = true; // Still consider it a success for Protocol ID
-      result.protocol = typeToString(results->decode_type);
-      result.description = "Known Protocol (Not AC)";
-    } else {
-      result.protocol = "UNKNOWN";
-      result.rawData = resultToSourceCode(results);
+      result.protocol = results->decode_type;
     }
   }
 
@@ -153,3 +111,5 @@ bool AutoDetect::isACProtocol(decode_type_t type) {
   // 判断是否是空调协议
   return hasACState(type);
 }
+
+#endif // AUTO_DETECT_ENABLED
@@ -11,7 +11,9 @@
 #ifndef AUTO_DETECT_H
 #define AUTO_DETECT_H
 
+#include "ac_state.h"
 #include "config.h"
+#include "scheduler.h"
 #include <Arduino.h>
 #include <IRac.h>
 #include <IRrecv.h>
@@ -24,22 +26,16 @@
 #include <ir_Midea.h>
 
 
-// 检测结果结构
+// 检测结果结构（协议名称、描述和原始数据在上报时由调用方生成）
 struct DetectionResult {
-  bool success;       // 是否成功识别
-  String protocol;    // 协议名称 "GREE", "MIDEA", "UNKNOWN"
-  int model;          // 型号代码 (0-255)
-  String description; // 人类可读描述
-  String rawData;     // 原始数据（用于Raw模式）
+  bool success;           // 是否成功识别
+  bool overflow;          // 接收缓冲区溢出
+  decode_type_t protocol; // 协议类型（UNKNOWN=未识别）
+  int model;              // 型号代码 (0-255)
 
   // 解析出的空调状态（如果是AC协议）
   bool isAC; // 是否是空调协议
-  bool power;
-  String mode;  // "cool", "heat", "dry", "fan", "auto"
-  uint8_t temp; // 温度 (16-30)
-  uint8_t fan;  // 风速 (0-3)
-  bool swingV;  // 垂直摆风
-  bool swingH;  // 水平摆风
+  ACState state;
 };
 
 class AutoDetect {
@@ -62,8 +58,12 @@ public:
 private:
   static bool detecting;
   static unsigned long startTime;
+  static TaskId timeoutTask;
   static const uint32_t DETECT_TIMEOUT = 30000; // 30秒超时
 
+  // 检测超时（单次任务）
+  static void onTimeout();
+
   // 从state数组提取型号（品牌特定）
   static int extractModel(decode_type_t protocol, uint8_t *state);
 
@@ -0,0 +1,62 @@
+/*
+ * 启动阶段计时 - 实现
+ */
+
+#include "boot_profiler.h"
+#include "mqtt_client.h"
+#include <ArduinoJson.h>
+
+// 静态成员初始化
+BootProfiler::Mark BootProfiler::marks[BOOT_MAX_MARKS];
+uint8_t BootProfiler::count = 0;
+bool BootProfiler::published = false;
+
+void BootProfiler::mark(const char *phase) {
+  if (count >= BOOT_MAX_MARKS)
+    return;
+
+  uint32_t now = millis();
+  uint32_t prev = count > 0 ? marks[count - 1].at : 0;
+
+  marks[count].phase = phase;
+  marks[count].at = now;
+  marks[count].duration = now - prev;
+  count++;
+
+  DEBUG_PRINTF("[启动] %s: %u ms (+%u ms)\n", phase, now, now - prev);
+}
+
+void BootProfiler::markOnce(const char *phase) {
+  if (elapsed(phase) == 0)
+    mark(phase);
+}
+
+uint32_t BootProfiler::elapsed(const char *phase) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (strcmp(marks[i].phase, phase) == 0)
+      return marks[i].at;
+  }
+  return 0;
+}
+
+void BootProfiler::publish() {
+  if (published || !MQTTClient::isConnected())
+    return;
+
+  DynamicJsonDocument doc(1024);
+  doc["reset"] = ESP.getResetReason();
+  doc["total"] = count > 0 ? marks[count - 1].at : 0;
+
+  JsonArray phases = doc.createNestedArray("phases");
+  for (uint8_t i = 0; i < count; i++) {
+    JsonObject p = phases.createNestedObject();
+    p["name"] = marks[i].phase;
+    p["at"] = marks[i].at;
+    p["ms"] = marks[i].duration;
+  }
+
+  String topic = MQTTClient::getTopic("diag/boot");
+  if (MQTTClient::publishJson(topic.c_str(), doc)) {
+    published = true;
+  }
+}
@@ -0,0 +1,44 @@
+/*
+ * 启动阶段计时
+ *
+ * 功能：
+ * - 记录 setup() 各阶段完成的时间点和耗时
+ * - 记录网络就绪、首次上线、首次红外接收等里程碑
+ * - MQTT首次上线后发布 diag/boot 记录
+ */
+
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include "config.h"
+#include <Arduino.h>
+
+#define BOOT_MAX_MARKS 16
+
+class BootProfiler {
+public:
+  // 记录阶段完成（phase 需为字符串常量）
+  static void mark(const char *phase);
+
+  // 里程碑只记录第一次
+  static void markOnce(const char *phase);
+
+  // 查询阶段完成时间（毫秒，未记录返回0）
+  static uint32_t elapsed(const char *phase);
+
+  // 发布 diag/boot（只发布一次）
+  static void publish();
+
+private:
+  struct Mark {
+    const char *phase;
+    uint32_t at;       // 启动后毫秒数
+    uint32_t duration; // 距上一个阶段的毫秒数
+  };
+
+  static Mark marks[BOOT_MAX_MARKS];
+  static uint8_t count;
+  static bool published;
+};
+
+#endif // BOOT_PROFILER_H
@@ -0,0 +1,241 @@
+/*
+ * AP配网门户 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_WIFI
+
+#include "captive_portal.h"
+#include "portal_assets.h"
+
+#if CAPTIVE_PORTAL_ENABLED
+
+static const char PORTAL_URL[] PROGMEM = "http://192.168.4.1/";
+static const char SAVED_HTML[] PROGMEM =
+    "<html><head><meta name='viewport' content='width=device-width, "
+    "initial-scale=1'></head><body><h2>Saved!</h2>"
+    "<p>Connecting... This hotspot will close once the device is "
+    "online.</p></body></html>";
+
+// 各系统的连通性探测地址
+static const char *const PROBE_PATHS[] = {
+    "/generate_204",              // Android
+    "/gen_204",                   // Android
+    "/hotspot-detect.html",       // iOS / macOS
+    "/library/test/success.html", // iOS
+    "/connecttest.txt",           // Windows
+    "/ncsi.txt",                  // Windows
+    "/fwlink",                    // Windows
+};
+
+// 静态成员初始化
+ESP8266WebServer CaptivePortal::server(80);
+DNSServer CaptivePortal::dnsServer;
+bool CaptivePortal::active = false;
+bool CaptivePortal::routesRegistered = false;
+TaskId CaptivePortal::task = SCHED_INVALID_TASK;
+PortalSaveHandler CaptivePortal::saveHandler = nullptr;
+char CaptivePortal::scanJson[PORTAL_SCAN_MAX * 64] = "[]";
+uint16_t CaptivePortal::scanJsonLen = 2;
+bool CaptivePortal::scanning = false;
+unsigned long CaptivePortal::lastScan = 0;
+
+void CaptivePortal::start(const char *apName, PortalSaveHandler onSave) {
+  if (active)
+    return;
+
+  saveHandler = onSave;
+
+  // AP+STA：配网期间仍可尝试连接路由器
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.softAP(apName);
+  DEBUG_PRINTF("[门户] AP名称: %s\n", apName);
+  DEBUG_PRINTLN("[门户] 请连接热点并访问 192.168.4.1 配置WiFi");
+
+  // 所有域名都解析到本机
+  dnsServer.start(53, "*", WiFi.softAPIP());
+
+  if (!routesRegistered) {
+    server.on("/", HTTP_GET, handleIndex);
+    server.on("/scan.json", HTTP_GET, handleScan);
+    server.on("/save", HTTP_POST, handleSave);
+    for (const char *path : PROBE_PATHS) {
+      server.on(path, handleRedirect);
+    }
+    server.onNotFound(handleRedirect);
+    routesRegistered = true;
+  }
+  server.begin();
+
+  if (task == SCHED_INVALID_TASK) {
+    task = Scheduler::addPeriodic("portal", WIFI_PORTAL_POLL_INTERVAL, update);
+  } else {
+    Scheduler::schedule(task, 0);
+  }
+
+  active = true;
+  startScan();
+  DEBUG_PRINTLN("[门户] ✅ 已启动");
+}
+
+void CaptivePortal::stop() {
+  if (!active)
+    return;
+
+  Scheduler::cancel(task);
+  server.stop();
+  dnsServer.stop();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_STA);
+  active = false;
+  DEBUG_PRINTLN("[门户] 已关闭");
+}
+
+bool CaptivePortal::isActive() { return active; }
+
+uint8_t CaptivePortal::getClientCount() {
+  return active ? WiFi.softAPgetStationNum() : 0;
+}
+
+void CaptivePortal::update() {
+  dnsServer.processNextRequest();
+  server.handleClient();
+}
+
+void CaptivePortal::startScan() {
+  if (scanning)
+    return;
+
+  scanning = true;
+  WiFi.scanNetworksAsync(onScanComplete);
+}
+
+void CaptivePortal::onScanComplete(int count) {
+  scanning = false;
+  lastScan = millis();
+
+  if (count < 0) {
+    LOG_PRINTLN(WARN, "[门户] ⚠️ 扫描失败");
+    return;
+  }
+
+  // 按信号强度保留最强的 PORTAL_SCAN_MAX 个（同名只保留最强的一个）
+  int16_t order[PORTAL_SCAN_MAX];
+  uint8_t kept = 0;
+  for (int i = 0; i < count; i++) {
+    if (WiFi.SSID(i).length() == 0)
+      continue; // 隐藏网络
+
+    bool duplicate = false;
+    for (uint8_t k = 0; k < kept; k++) {
+      if (WiFi.SSID(order[k]) == WiFi.SSID(i)) {
+        if (WiFi.RSSI(i) > WiFi.RSSI(order[k]))
+          order[k] = i;
+        duplicate = true;
+        break;
+      }
+    }
+    if (duplicate)
+      continue;
+
+    // 插入排序
+    uint8_t pos = kept;
+    while (pos > 0 && WiFi.RSSI(order[pos - 1]) < WiFi.RSSI(i))
+      pos--;
+    if (pos >= PORTAL_SCAN_MAX)
+      continue;
+    uint8_t last = kept < PORTAL_SCAN_MAX ? kept : PORTAL_SCAN_MAX - 1;
+    for (uint8_t k = last; k > pos; k--)
+      order[k] = order[k - 1];
+    order[pos] = i;
+    if (kept < PORTAL_SCAN_MAX)
+      kept++;
+  }
+
+  // 预先序列化，请求时直接发送
+  size_t len = 0;
+  scanJson[len++] = '[';
+  for (uint8_t k = 0; k < kept; k++) {
+    char ssid[6 * 32 + 1];
+    size_t n = 0;
+    String raw = WiFi.SSID(order[k]);
+    for (unsigned j = 0; j < raw.length() && n < sizeof(ssid) - 7; j++) {
+      char c = raw[j];
+      if (c == '"' || c == '\\') {
+        ssid[n++] = '\\';
+        ssid[n++] = c;
+      } else if ((uint8_t)c < 0x20) {
+        n += snprintf(ssid + n, sizeof(ssid) - n, "\\u%04x", c);
+      } else {
+        ssid[n++] = c;
+      }
+    }
+    ssid[n] = '\0';
+
+    char entry[sizeof(ssid) + 48];
+    int w = snprintf(entry, sizeof(entry),
+                     "%s{\"ssid\":\"%s\",\"rssi\":%d,\"open\":%s}",
+                     k > 0 ? "," : "", ssid, WiFi.RSSI(order[k]),
+                     WiFi.encryptionType(order[k]) == ENC_TYPE_NONE ? "true"
+                                                                     : "false");
+    if (w < 0 || len + w + 2 > sizeof(scanJson))
+      break;
+    memcpy(scanJson + len, entry, w);
+    len += w;
+  }
+  scanJson[len++] = ']';
+  scanJson[len] = '\0';
+  scanJsonLen = len;
+
+  WiFi.scanDelete();
+  DEBUG_PRINTF("[门户] 扫描完成: %d 个网络，列出 %d 个\n", count, kept);
+}
+
+void CaptivePortal::handleIndex() {
+  server.sendHeader(F("Content-Encoding"), F("gzip"));
+  server.sendHeader(F("Cache-Control"), F("no-cache"));
+  server.send_P(200, PSTR("text/html"), (PGM_P)PORTAL_INDEX_HTML_GZ,
+                PORTAL_INDEX_HTML_GZ_LEN);
+}
+
+void CaptivePortal::handleScan() {
+  // 结果过期时后台重新扫描，本次先返回缓存
+  if (!scanning && millis() - lastScan > PORTAL_SCAN_INTERVAL) {
+    startScan();
+  }
+
+  const char *prefix = scanning ? "{\"scanning\":true,\"networks\":"
+                                : "{\"scanning\":false,\"networks\":";
+  size_t prefixLen = strlen(prefix);
+
+  server.sendHeader(F("Cache-Control"), F("no-cache"));
+  server.setContentLength(prefixLen + scanJsonLen + 1);
+  server.send(200, "application/json", "");
+  server.sendContent(prefix, prefixLen);
+  server.sendContent(scanJson, scanJsonLen);
+  server.sendContent("}", 1);
+}
+
+void CaptivePortal::handleSave() {
+  String ssid = server.arg("ssid");
+  String password = server.arg("password");
+
+  if (ssid.length() == 0 || ssid.length() > 32 || password.length() > 64) {
+    server.send(400, "text/plain", "Invalid SSID or password");
+    return;
+  }
+
+  DEBUG_PRINTF("[门户] 收到Web配置: %s\n", ssid.c_str());
+  server.send_P(200, PSTR("text/html"), SAVED_HTML);
+
+  if (saveHandler != nullptr) {
+    saveHandler(ssid, password);
+  }
+}
+
+void CaptivePortal::handleRedirect() {
+  // 探测请求和未知路径一律重定向到配置页，不生成页面内容
+  server.sendHeader(F("Location"), FPSTR(PORTAL_URL), true);
+  server.send(302, "text/plain", "");
+}
+
+#endif // CAPTIVE_PORTAL_ENABLED
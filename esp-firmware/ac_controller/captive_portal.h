@@ -0,0 +1,81 @@
+/*
+ * AP配网门户
+ *
+ * 功能：
+ * - SoftAP + DNS劫持（Captive Portal）
+ * - 页面以gzip压缩存放在Flash，直接从PROGMEM发送（无堆拷贝）
+ * - 系统连通性探测（Android/iOS/Windows）直接302重定向
+ * - 后台异步扫描周边网络，结果预先序列化缓存，供页面选择SSID
+ * - 作为调度器任务运行，不阻塞红外/传感器等本地功能
+ */
+
+#ifndef CAPTIVE_PORTAL_H
+#define CAPTIVE_PORTAL_H
+
+#include "config.h"
+#include "scheduler.h"
+#include <Arduino.h>
+
+// 用户提交凭证后的回调
+typedef void (*PortalSaveHandler)(const String &ssid, const String &password);
+
+#if CAPTIVE_PORTAL_ENABLED
+
+#include <DNSServer.h>
+#include <ESP8266WebServer.h>
+#include <ESP8266WiFi.h>
+
+class CaptivePortal {
+public:
+  // 开启热点和门户（AP+STA 模式）
+  static void start(const char *apName, PortalSaveHandler onSave);
+
+  // 关闭门户和热点
+  static void stop();
+
+  static bool isActive();
+
+  // 连接到热点的设备数
+  static uint8_t getClientCount();
+
+  // 处理DNS/HTTP请求（调度器任务）
+  static void update();
+
+private:
+  static ESP8266WebServer server;
+  static DNSServer dnsServer;
+  static bool active;
+  static bool routesRegistered;
+  static TaskId task;
+  static PortalSaveHandler saveHandler;
+
+  // 扫描结果缓存（序列化后的 JSON 数组）
+  static char scanJson[PORTAL_SCAN_MAX * 64];
+  static uint16_t scanJsonLen;
+  static bool scanning;
+  static unsigned long lastScan;
+
+  static void startScan();
+  static void onScanComplete(int count);
+
+  // HTTP处理函数
+  static void handleIndex();
+  static void handleScan();
+  static void handleSave();
+  static void handleRedirect();
+};
+
+#else
+
+// 构建配置关闭了门户：空实现，WiFiManager 无需区分（只能使用已保存的凭证）
+class CaptivePortal {
+public:
+  static void start(const char *apName, PortalSaveHandler onSave) {}
+  static void stop() {}
+  static bool isActive() { return false; }
+  static uint8_t getClientCount() { return 0; }
+};
+
+#endif // CAPTIVE_PORTAL_ENABLED
+
+#endif // CAPTIVE_PORTAL_H
@@ -0,0 +1,19 @@
+/*
+ * 校验工具 - 实现
+ */
+
+#include "checksum.h"
+
+uint32_t Checksum::crc32(const void *data, size_t length, uint32_t crc) {
+  const uint8_t *bytes = (const uint8_t *)data;
+
+  // 反射多项式 0xEDB88320，逐位计算（不占用查表RAM）
+  crc = ~crc;
+  while (length--) {
+    crc ^= *bytes++;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,20 @@
+/*
+ * 校验工具
+ *
+ * 功能：
+ * - 标准 CRC-32（与 zlib/Node.js 的 crc32 结果一致）
+ * - 支持分段累加计算
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <Arduino.h>
+
+class Checksum {
+public:
+  // 计算CRC-32，分段计算时把上一段结果作为 crc 传入
+  static uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
+};
+
+#endif // CHECKSUM_H
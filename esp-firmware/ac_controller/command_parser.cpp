@@ -0,0 +1,322 @@
+/*
+ * 控制命令解析器 - 实现
+ */
+
+#include "command_parser.h"
+
+// 嵌套对象/数组的最大深度（未知字段的值）
+#define MAX_NESTING 8
+
+// 字段名哈希（FNV-1a）；扫描字段名时同步计算，case 标签在编译期生成
+static constexpr uint32_t FNV_OFFSET = 2166136261u;
+static constexpr uint32_t FNV_PRIME = 16777619u;
+
+static constexpr uint32_t fieldHash(const char *name,
+                                    uint32_t hash = FNV_OFFSET) {
+  return *name == '\0'
+             ? hash
+             : fieldHash(name + 1, (hash ^ (uint8_t)*name) * FNV_PRIME);
+}
+
+// 哈希命中后再比较一次名称，排除冲突
+template <size_t N>
+static inline bool keyIs(const char *key, size_t length,
+                         const char (&name)[N]) {
+  return length == N - 1 && memcmp(key, name, N - 1) == 0;
+}
+
+bool CommandParser::parse(const char *json, const ACState &base,
+                          ControlCommand &out) {
+  out.state = base;
+  out.state.source = AC_SOURCE_API;
+  out.fields = 0;
+  out.brand[0] = '\0';
+  out.id[0] = '\0';
+  out.model = 1;
+  out.raw = nullptr;
+  out.rawLength = 0;
+
+  const char *p = json;
+  skipSpace(p);
+  if (*p++ != '{') {
+    return false;
+  }
+  skipSpace(p);
+  if (*p == '}') {
+    p++;
+    skipSpace(p);
+    return *p == '\0';
+  }
+
+  while (true) {
+    const char *key;
+    size_t length;
+    uint32_t hash;
+    Value value;
+
+    if (!readKey(p, key, length, hash)) {
+      return false;
+    }
+    skipSpace(p);
+    if (*p++ != ':') {
+      return false;
+    }
+    skipSpace(p);
+    if (!readValue(p, value)) {
+      return false;
+    }
+
+    apply(key, length, hash, value, out);
+
+    skipSpace(p);
+    char c = *p++;
+    if (c == '}') {
+      // 对象之后只允许空白
+      skipSpace(p);
+      return *p == '\0';
+    }
+    if (c != ',') {
+      return false;
+    }
+    skipSpace(p);
+  }
+}
+
+void CommandParser::apply(const char *key, size_t length, uint32_t hash,
+                          const Value &value, ControlCommand &out) {
+  // 类型不符的字段按缺省处理（与 ArduinoJson 的 `doc[key] | 默认值` 一致），
+  // 布尔字段额外接受 0/1
+  bool flag = value.number != 0;
+  bool isFlag = value.type == Value::BOOL || value.type == Value::NUMBER;
+  bool isNumber = value.type == Value::NUMBER;
+  bool isString = value.type == Value::STRING;
+
+  switch (hash) {
+  case fieldHash("power"):
+    if (keyIs(key, length, "power") && isFlag) {
+      out.state.power = flag;
+      out.fields |= CMD_FIELD_POWER;
+    }
+    break;
+  case fieldHash("mode"):
+    if (keyIs(key, length, "mode") && isString) {
+      out.state.mode = acModeFromName(value.str, value.length, out.state.mode);
+      out.fields |= CMD_FIELD_MODE;
+    }
+    break;
+  case fieldHash("setTemp"):
+    if (keyIs(key, length, "setTemp") && isNumber) {
+      out.state.temp = acClampTemp(value.number);
+      out.fields |= CMD_FIELD_TEMP | CMD_FIELD_SET_TEMP;
+    }
+    break;
+  case fieldHash("temp"):
+    // 旧字段：已有 setTemp 时忽略
+    if (keyIs(key, length, "temp") && isNumber &&
+        !(out.fields & CMD_FIELD_SET_TEMP)) {
+      out.state.temp = acClampTemp(value.number);
+      out.fields |= CMD_FIELD_TEMP;
+    }
+    break;
+  case fieldHash("fan"):
+    if (keyIs(key, length, "fan") && isNumber) {
+      out.state.fan = acFanFromLevel(value.number);
+      out.fields |= CMD_FIELD_FAN;
+    }
+    break;
+  case fieldHash("swingVertical"):
+    if (keyIs(key, length, "swingVertical") && isFlag) {
+      out.state.swingV = flag;
+      out.fields |= CMD_FIELD_SWING_V;
+    }
+    break;
+  case fieldHash("swingHorizontal"):
+    if (keyIs(key, length, "swingHorizontal") && isFlag) {
+      out.state.swingH = flag;
+      out.fields |= CMD_FIELD_SWING_H;
+    }
+    break;
+  case fieldHash("brand"):
+    if (keyIs(key, length, "brand") && isString &&
+        value.length < sizeof(out.brand)) {
+      memcpy(out.brand, value.str, value.length);
+      out.brand[value.length] = '\0';
+      out.fields |= CMD_FIELD_BRAND;
+    }
+    break;
+  case fieldHash("model"):
+    if (keyIs(key, length, "model") && isNumber) {
+      out.model = value.number;
+      out.fields |= CMD_FIELD_MODEL;
+    }
+    break;
+  case fieldHash("raw"):
+    if (keyIs(key, length, "raw") && isString) {
+      out.raw = value.str;
+      out.rawLength = value.length;
+      out.fields |= CMD_FIELD_RAW;
+    }
+    break;
+  case fieldHash("source"):
+    if (keyIs(key, length, "source") && isString) {
+      out.state.source = acSourceFromName(value.str, value.length);
+      out.fields |= CMD_FIELD_SOURCE;
+    }
+    break;
+  case fieldHash("id"):
+    if (keyIs(key, length, "id") && isString &&
+        value.length < sizeof(out.id)) {
+      memcpy(out.id, value.str, value.length);
+      out.id[value.length] = '\0';
+      out.fields |= CMD_FIELD_ID;
+    } else if (keyIs(key, length, "id") && isNumber) {
+      snprintf(out.id, sizeof(out.id), "%ld", value.number);
+      out.fields |= CMD_FIELD_ID;
+    }
+    break;
+  default:
+    break; // 未知字段（如 version、jitter）
+  }
+}
+
+void CommandParser::skipSpace(const char *&p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+    p++;
+  }
+}
+
+bool CommandParser::readKey(const char *&p, const char *&key, size_t &length,
+                            uint32_t &hash) {
+  if (*p++ != '"') {
+    return false;
+  }
+  key = p;
+  hash = FNV_OFFSET;
+  while (*p != '"') {
+    if (*p == '\0' || *p == '\\') {
+      return false; // 字段名不含转义
+    }
+    hash = (hash ^ (uint8_t)*p) * FNV_PRIME;
+    p++;
+  }
+  length = p - key;
+  p++;
+  return true;
+}
+
+bool CommandParser::readString(const char *&p, const char *&str,
+                               size_t &length) {
+  if (*p++ != '"') {
+    return false;
+  }
+  str = p;
+  while (*p != '"') {
+    if (*p == '\0') {
+      return false;
+    }
+    if (*p == '\\' && *++p == '\0') {
+      return false;
+    }
+    p++;
+  }
+  length = p - str;
+  p++;
+  return true;
+}
+
+bool CommandParser::readValue(const char *&p, Value &value) {
+  value.number = 0;
+  char c = *p;
+
+  if (c == '"') {
+    value.type = Value::STRING;
+    return readString(p, value.str, value.length);
+  }
+
+  if (c == '-' || (c >= '0' && c <= '9')) {
+    value.type = Value::NUMBER;
+    bool negative = c == '-';
+    if (negative) {
+      p++;
+    }
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    long n = 0;
+    while (*p >= '0' && *p <= '9') {
+      if (n < 100000000L) { // 命令字段都很小，超大值饱和即可
+        n = n * 10 + (*p - '0');
+      }
+      p++;
+    }
+    value.number = negative ? -n : n;
+    // 小数和指数部分截断（与 as<int>() 一致）
+    if (*p == '.') {
+      p++;
+      while (*p >= '0' && *p <= '9') {
+        p++;
+      }
+    }
+    if (*p == 'e' || *p == 'E') {
+      p++;
+      if (*p == '+' || *p == '-') {
+        p++;
+      }
+      while (*p >= '0' && *p <= '9') {
+        p++;
+      }
+    }
+    return true;
+  }
+
+  if (strncmp(p, "true", 4) == 0) {
+    value.type = Value::BOOL;
+    value.number = 1;
+    p += 4;
+    return true;
+  }
+  if (strncmp(p, "false", 5) == 0) {
+    value.type = Value::BOOL;
+    p += 5;
+    return true;
+  }
+  if (strncmp(p, "null", 4) == 0) {
+    value.type = Value::NUL;
+    p += 4;
+    return true;
+  }
+
+  if (c == '{' || c == '[') {
+    value.type = Value::OTHER;
+    return skipNested(p);
+  }
+  return false;
+}
+
+bool CommandParser::skipNested(const char *&p) {
+  // 只需找到匹配的括号：字符串内的括号不计入
+  uint8_t depth = 0;
+  do {
+    char c = *p;
+    if (c == '\0') {
+      return false;
+    }
+    if (c == '"') {
+      const char *str;
+      size_t length;
+      if (!readString(p, str, length)) {
+        return false;
+      }
+      continue;
+    }
+    if (c == '{' || c == '[') {
+      if (++depth > MAX_NESTING) {
+        return false;
+      }
+    } else if (c == '}' || c == ']') {
+      depth--;
+    }
+    p++;
+  } while (depth > 0);
+  return true;
+}
@@ -0,0 +1,80 @@
+/*
+ * 控制命令解析器
+ *
+ * 功能：
+ * - 专用于 /cmd 命令格式的单遍解析：逐字符扫描一次，字段直接写入
+ *   ACState，不构建JSON文档树
+ * - 字段名按编译期生成的哈希分派（switch），未知字段整体跳过
+ * - raw 字段只返回指向原消息的视图，不复制
+ *
+ * 命令格式：
+ *   {"power":true,"mode":"cool","setTemp":24,"fan":2,
+ *    "swingVertical":false,"swingHorizontal":false,
+ *    "brand":"GREE","model":1,"raw":"9000,4500,...","source":"api",
+ *    "id":"req-42"}
+ * - 所有字段可选，缺省字段保持当前状态
+ * - setTemp 优先于旧字段 temp（与出现顺序无关）
+ * - id 为可选的关联ID，带 id 的命令在 cmd/ack 上应答各阶段耗时
+ */
+
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include "ac_state.h"
+#include "config.h"
+#include <Arduino.h>
+
+// 命令中出现的字段
+enum CommandField : uint16_t {
+  CMD_FIELD_POWER = 1 << 0,
+  CMD_FIELD_MODE = 1 << 1,
+  CMD_FIELD_TEMP = 1 << 2,
+  CMD_FIELD_FAN = 1 << 3,
+  CMD_FIELD_SWING_V = 1 << 4,
+  CMD_FIELD_SWING_H = 1 << 5,
+  CMD_FIELD_BRAND = 1 << 6,
+  CMD_FIELD_MODEL = 1 << 7,
+  CMD_FIELD_RAW = 1 << 8,
+  CMD_FIELD_SOURCE = 1 << 9,
+  CMD_FIELD_SET_TEMP = 1 << 10, // 温度来自 setTemp
+  CMD_FIELD_ID = 1 << 11,       // 关联ID（延迟跟踪）
+};
+
+// 解析结果
+struct ControlCommand {
+  ACState state;    // 当前状态叠加命令中的字段
+  uint16_t fields;  // CommandField 组合
+  char brand[32];   // 临时指令品牌（超长时为空）
+  int16_t model;    // 临时指令型号（默认1）
+  const char *raw;  // 原始时序视图（指向原消息，不以 '\0' 结尾）
+  size_t rawLength;
+  char id[CMD_TRACE_ID_SIZE]; // 关联ID（字符串或整数，超长时为空）
+};
+
+class CommandParser {
+public:
+  // 解析命令；base 为缺省字段使用的当前状态。格式错误返回 false，
+  // 此时 out 内容无效
+  static bool parse(const char *json, const ACState &base, ControlCommand &out);
+
+private:
+  // JSON 值（字符串为视图，含转义时保持原样）
+  struct Value {
+    enum Type : uint8_t { NUL, BOOL, NUMBER, STRING, OTHER } type;
+    const char *str;
+    size_t length;
+    long number; // 数字的整数部分（BOOL 时为 0/1）
+  };
+
+  static void skipSpace(const char *&p);
+  static bool readKey(const char *&p, const char *&key, size_t &length,
+                      uint32_t &hash);
+  static bool readString(const char *&p, const char *&str, size_t &length);
+  static bool readValue(const char *&p, Value &value);
+  static bool skipNested(const char *&p);
+
+  static void apply(const char *key, size_t length, uint32_t hash,
+                    const Value &value, ControlCommand &out);
+};
+
+#endif // COMMAND_PARSER_H
@@ -0,0 +1,115 @@
+/*
+ * 命令延迟跟踪 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_STATE
+
+#include "command_trace.h"
+#include "message_arena.h"
+#include "mqtt_client.h"
+#include <ArduinoJson.h>
+
+static const char *const STAGE_NAMES[TRACE_STAGE_COUNT] = {
+    "parse", "irStart", "irEnd", "publish"};
+
+// 静态成员初始化
+bool CommandTrace::armed = false;
+bool CommandTrace::active = false;
+bool CommandTrace::waiting = false;
+char CommandTrace::id[CMD_TRACE_ID_SIZE];
+uint32_t CommandTrace::receivedUs = 0;
+uint32_t CommandTrace::stages[TRACE_STAGE_COUNT];
+uint8_t CommandTrace::reached = 0;
+const char *CommandTrace::path = "";
+bool CommandTrace::ok = false;
+TaskId CommandTrace::timeoutTask = SCHED_INVALID_TASK;
+
+void CommandTrace::init() {
+  timeoutTask = Scheduler::addOneShot("trace", onTimeout);
+}
+
+void CommandTrace::arm(uint32_t received) {
+  // 上一条命令仍在等待状态发布：先应答，开始新的跟踪
+  if (active) {
+    publishAck();
+  }
+  armed = true;
+  receivedUs = received;
+}
+
+void CommandTrace::disarm() { armed = false; }
+
+void CommandTrace::start(const char *commandId) {
+  if (!armed || commandId[0] == '\0')
+    return;
+
+  armed = false;
+  active = true;
+  waiting = false;
+  reached = 0;
+  path = "";
+  ok = false;
+  strncpy(id, commandId, sizeof(id) - 1);
+  id[sizeof(id) - 1] = '\0';
+}
+
+void CommandTrace::mark(TraceStage stage) {
+  if (!active)
+    return;
+  if (stage == TRACE_IR_START && (reached & (1 << stage)))
+    return;
+
+  stages[stage] = micros() - receivedUs;
+  reached |= 1 << stage;
+}
+
+void CommandTrace::complete(const char *how, bool success, bool waitPublish) {
+  if (!active || waiting)
+    return;
+
+  path = how;
+  ok = success;
+  if (waitPublish) {
+    waiting = true;
+    Scheduler::schedule(timeoutTask, CMD_TRACE_TIMEOUT);
+  } else {
+    publishAck();
+  }
+}
+
+void CommandTrace::onPublished() {
+  if (!waiting)
+    return;
+  mark(TRACE_PUBLISHED);
+  publishAck();
+}
+
+void CommandTrace::onTimeout() {
+  if (waiting) {
+    LOG_PRINTF(WARN, "[跟踪] ⚠️ 命令 %s 的状态未在 %u ms 内发布\n", id,
+               CMD_TRACE_TIMEOUT);
+    publishAck();
+  }
+}
+
+void CommandTrace::publishAck() {
+  active = false;
+  waiting = false;
+  Scheduler::cancel(timeoutTask);
+
+  ArenaJsonDocument doc(256);
+  doc["id"] = (const char *)id;
+  doc["fw"] = FIRMWARE_VERSION;
+  doc["path"] = path;
+  doc["ok"] = ok;
+  JsonObject us = doc.createNestedObject("us");
+  for (uint8_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+    if (reached & (1 << i))
+      us[STAGE_NAMES[i]] = stages[i];
+  }
+
+  String topic = MQTTClient::getTopic("cmd/ack");
+  MQTTClient::publishJson(topic.c_str(), doc);
+  DEBUG_PRINTF("[跟踪] 命令 %s: %s, 共 %u us\n", id, path,
+               micros() - receivedUs);
+}
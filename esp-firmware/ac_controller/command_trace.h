@@ -0,0 +1,72 @@
+/*
+ * 命令延迟跟踪
+ *
+ * 功能：
+ * - /cmd 命令可带关联ID（"id"），记录接收、解析完成、红外发送开始/结束、
+ *   状态发布各阶段的时间
+ * - 处理结束后在 cmd/ack 应答ID、固件版本和各阶段距接收的微秒数，
+ *   服务器据此按设备和固件版本统计延迟分布
+ * - 状态发布由事件消费者异步完成：等到发布后再应答，
+ *   CMD_TRACE_TIMEOUT 内未发布时不带 publish 阶段应答
+ *
+ * 应答格式：
+ *   {"id":"req-42","fw":"1.3.0","path":"config","ok":true,
+ *    "us":{"parse":850,"irStart":900,"irEnd":61000,"publish":64000}}
+ * 分组命令和影子命令不跟踪
+ */
+
+#ifndef COMMAND_TRACE_H
+#define COMMAND_TRACE_H
+
+#include "config.h"
+#include "scheduler.h"
+#include <Arduino.h>
+
+// 跟踪阶段
+enum TraceStage : uint8_t {
+  TRACE_PARSED,    // 命令解析完成
+  TRACE_IR_START,  // 开始发送红外（多次发送时取第一次）
+  TRACE_IR_END,    // 红外发送结束（多次发送时取最后一次）
+  TRACE_PUBLISHED, // 新状态已发布
+  TRACE_STAGE_COUNT
+};
+
+class CommandTrace {
+public:
+  // 注册超时任务
+  static void init();
+
+  // /cmd 消息回调中：准备跟踪（receivedUs 为报文接收时间），回调结束时 disarm()
+  static void arm(uint32_t receivedUs);
+  static void disarm();
+
+  // 命令解析出关联ID后开始跟踪（未 arm 或ID为空时忽略）
+  static void start(const char *id);
+
+  // 记录阶段时间（未在跟踪时忽略）
+  static void mark(TraceStage stage);
+
+  // 命令处理结束：path 为执行方式（"brand"/"config"/"raw"/"state"），
+  // waitPublish 时等状态发布后应答，否则立即应答
+  static void complete(const char *path, bool ok, bool waitPublish);
+
+  // 状态发布后调用（StateManager）
+  static void onPublished();
+
+private:
+  static bool armed;   // 正在处理 /cmd 消息
+  static bool active;  // 正在跟踪（start 至应答）
+  static bool waiting; // 等待状态发布
+  static char id[CMD_TRACE_ID_SIZE];
+  static uint32_t receivedUs;
+  static uint32_t stages[TRACE_STAGE_COUNT]; // 距接收的微秒数
+  static uint8_t reached;                    // 已记录的阶段（位图）
+  static const char *path;
+  static bool ok;
+  static TaskId timeoutTask;
+
+  static void onTimeout();
+  static void publishAck();
+};
+
+#endif // COMMAND_TRACE_H
@@ -10,6 +10,16 @@
 #include <Arduino.h>
 #include <stdint.h>
 
+// ===== 构建配置 =====
+// 红外协议和可选子系统由构建配置决定（profile_*.h）。
+// tools/build_profile.py 以 -D 选项传入其他配置，否则使用完整配置
+#ifndef BUILD_PROFILE
+#include "profile_full.h"
+#endif
+
+// ===== 固件版本 =====
+#define FIRMWARE_VERSION "1.3.0" // 设备上线消息和命令应答中上报
+
 // ===== 硬件引脚定义 =====
 #define PIN_IR_SEND 14  // D5 - 红外发射LED
 #define PIN_IR_RECV 13  // D7 - 1838B红外接收头
@@ -27,7 +37,14 @@
 // #define WIFI_PASSWORD "" // ✅ 硬编码WiFi密码
 
 #define WIFI_CONNECT_TIMEOUT 20000  // WiFi连接超时（毫秒）
-#define WIFI_RECONNECT_DELAY 5000   // 重连延迟（毫秒）
+#define WIFI_BACKOFF_MIN 1000       // 重连退避初始值（毫秒）
+#define WIFI_BACKOFF_MAX 60000      // 重连退避上限（毫秒）
+#define WIFI_PORTAL_AFTER_FAILURES 3 // 从未连上时连续失败多少次进入AP配网
+#define WIFI_PORTAL_RETRY_INTERVAL 60000 // 配网模式下无人连接时重试已保存凭证的间隔
+#define WIFI_PORTAL_POLL_INTERVAL 10 // 配网门户处理DNS/HTTP的间隔（毫秒）
+#define PORTAL_SCAN_MAX 12           // 配网页面列出的最多网络数
+#define PORTAL_SCAN_INTERVAL 30000   // 扫描结果缓存有效期（毫秒）
+#define WIFI_FAST_CONNECT_TIMEOUT 3000 // 使用缓存BSSID/IP快速连接的超时（毫秒）
 
 // ===== MQTT配置 =====
 // TODO: 改进为从EEPROM读取，支持服务器下发配置
@@ -44,7 +61,45 @@
 // MQTT连接参数
 #define MQTT_KEEPALIVE 60          // 心跳间隔（秒）
 #define MQTT_RECONNECT_DELAY 5000  // 重连延迟（毫秒）
-#define MQTT_BUFFER_SIZE 2048      // MQTT消息缓冲区大小 (由512扩容，适配长消息)
+#define MQTT_RECONNECT_MAX 120000  // 所有服务器都失败时重连退避上限（毫秒）
+#define MQTT_MAX_BROKERS 3        // 服务器列表长度（主服务器 + 备用）
+#define MQTT_BROKER_HOLDOFF 60000 // 连接失败的服务器暂停使用时间（毫秒）
+#define MQTT_BUFFER_SIZE 2048      // 接收报文最大长度（超过的报文丢弃，缓冲区按需扩容到此值）
+#define MQTT_RX_BUFFER_MIN 256     // 空闲时保留的接收缓冲区
+#define MQTT_CONNECT_TIMEOUT 10000 // DNS + TCP + CONNACK 超时（毫秒）
+#define MQTT_WRITE_TIMEOUT 1000    // 发送缓冲区已满时最长等待（毫秒）
+
+// 订阅管理
+#define GROUP_MAX 4        // 设备最多加入的分组数（见 group_command.h）
+#define GROUP_NAME_SIZE 24 // 分组名最大长度（含结束符）
+#define SUB_MAX_TOPICS (2 + GROUP_MAX) // 同时保持的订阅数：设备通配符 + 配置 + 分组
+#define SUB_TOPIC_SIZE 96  // 单个订阅topic最大长度
+#define MQTT_CLEAN_SESSION false // 持久会话：离线期间的QoS1命令由服务器暂存
+#define MQTT_SUB_QOS 1           // 命令topic订阅QoS
+#define MQTT_DEDUP_SIZE 8        // 最近收到的QoS1消息记录数（过滤重发）
+
+// 协议版本：4=MQTT 3.1.1，5=MQTT 5（主题别名、内容类型、请求/应答）
+#define MQTT_PROTOCOL_VERSION 4
+#define MQTT5_TOPIC_ALIAS_MAX 8     // 发布使用的主题别名数（不超过服务器允许值）
+#define MQTT5_ALIAS_TOPIC_SIZE 64   // 可分配别名的topic最大长度
+#define MQTT5_SESSION_EXPIRY 604800 // 持久会话保留时间（秒）
+
+// ===== TLS配置 =====
+// 启用后所有服务器都使用TLS连接（端口通常为8883，见 tools/mosquitto_tls）
+#define MQTT_TLS_ENABLED 0
+// 服务器证书SHA-1指纹（"AB:CD:..."）；未定义时不校验证书，仅加密
+// #define MQTT_TLS_FINGERPRINT ""
+#define MQTT_TLS_FRAGMENT 512    // 协商的最大分片长度（收发缓冲区大小）
+#define MQTT_TLS_RX_FULL 16384   // 服务器不支持分片协商时的接收缓冲区
+
+// ===== 分组命令配置 =====
+#define GROUP_JITTER_DEFAULT 5000 // 分组命令默认错峰窗口（毫秒）
+#define GROUP_JITTER_MAX 60000    // 命令可指定的最大错峰窗口（毫秒）
+#define GROUP_CMD_SIZE 512        // 等待执行的分组命令最大长度
+
+// ===== 命令跟踪配置 =====
+#define CMD_TRACE_ID_SIZE 40   // /cmd 关联ID最大长度（含结束符，超长时不跟踪）
+#define CMD_TRACE_TIMEOUT 2000 // 等待状态发布的最长时间（毫秒），超时后直接应答
 
 // ===== 定时器配置默认值 =====
 #define DEFAULT_SENSOR_INTERVAL 30000
@@ -54,15 +109,62 @@
 // ===== 红外配置 =====
 #define IR_RECV_BUFFER_SIZE 1024   // 红外接收缓冲区
 #define IR_RECV_TIMEOUT 50         // 接收超时（毫秒）
+#define IR_CAPTURE_SLOTS 2         // 捕获槽数量（每个约 2*IR_RECV_BUFFER_SIZE 字节）
 #define IR_CARRIER_FREQ 38         // 载波频率（kHz）
 #define IR_LEARNING_TIMEOUT 30000  // 学习模式超时（30秒）
+#define IR_POLL_INTERVAL 10        // 红外接收轮询间隔（毫秒）
+#define IR_CHUNK_SIZE 768          // 分片传输中单片数据长度（字符）
+#define IR_CHUNK_MAX_TIMINGS 1024  // 分片重组暂存区容量（时序值，传输期间占用2KB）
+#define IR_CHUNK_TIMEOUT 10000     // 分片间最长间隔（毫秒），超时放弃传输
+#define IR_FRAME_GAP 50            // 多帧场景中两帧之间的间隔（毫秒）
+
+// ===== 调度器配置 =====
+#define SCHED_MAX_TASKS 20      // 最多任务数（不超过32）
+#define SCHED_MAX_IDLE_MS 1000  // 无任务到期时单次最长睡眠（毫秒）
+#define MQTT_POLL_INTERVAL 20   // MQTT收包/心跳维护间隔（毫秒）
+#define WIFI_POLL_INTERVAL 500  // WiFi状态检查间隔（毫秒）
+#define SCHED_STACK_SAMPLE_EVERY 16 // 每个任务每N次执行测一次栈使用峰值
+
+// ===== 事件总线配置 =====
+#define EVENT_QUEUE_SIZE 16   // 事件队列容量
+#define EVENT_MAX_HANDLERS 4  // 每种事件最多订阅者
+
+// ===== 消息缓冲区配置 =====
+#define MSG_ARENA_SIZE 1024 // 发布用JSON文档的共享静态区（字节）
+#define MSG_ARENA_DEPTH 4   // 同时持有的租用数（嵌套发布）
+
+// ===== 内存监控配置 =====
+#define HEAP_SAMPLE_INTERVAL 5000   // 堆采样间隔（毫秒）
+#define HEAP_PUBLISH_INTERVAL 60000 // diag/heap 发布间隔（毫秒，级别变化时立即发布）
+#define HEAP_LOW_FREE 10000         // 空闲堆低于此值：推迟可选工作（心跳、日志上报）
+#define HEAP_LOW_BLOCK 4096         // 最大连续块低于此值同上（心跳文档需3.5KB）
+#define HEAP_CRITICAL_FREE 5000     // 空闲堆低于此值：另外拒绝大块分配（红外分片）
+#define HEAP_CRITICAL_BLOCK 2048    // 最大连续块低于此值同上（MQTT接收缓冲区上限）
+#define HEAP_RECOVER_MARGIN 1024    // 恢复到较低级别需高出阈值的余量（字节）
+#define HEAP_MSG_TYPES 12           // 按消息类型统计的条目数
+// 统计每类消息处理中的 malloc 次数（调试用，默认关闭），需同时链接
+// -Wl,--wrap=malloc,--wrap=realloc,--wrap=calloc
+#ifndef HEAP_ALLOC_TRACKING
+#define HEAP_ALLOC_TRACKING 0
+#endif
 
 // ===== 传感器配置 =====
 #define ADC_SAMPLES 10      // ADC采样次数
 #define CURRENT_OFFSET 512  // 电流传感器零点偏移
 #define CURRENT_RATIO 0.01  // 电流转换比例
 
-// ===== EEPROM存储地址 =====
+// ===== 键值存储配置 =====
+#define KV_SECTOR_COUNT 4       // 日志占用的Flash扇区数（位于FS分区末尾）
+#define KV_SECTOR_SIZE 4096     // Flash扇区大小
+#define KV_TXN_BUFFER_SIZE 1024 // 单个事务最大字节数
+
+// ===== 状态持久化配置 =====
+#define STATE_SAVE_DELAY 5000      // 状态静默多久后写入Flash（毫秒）
+#define STATE_SAVE_MAX_DELAY 60000 // 持续变化时最长推迟（毫秒）
+#define RTC_STATE_OFFSET 32        // RTC用户内存块偏移（前128字节被OTA占用）
+#define RTC_NET_OFFSET 40          // 网络缓存的RTC块偏移（紧跟状态副本）
+
+// ===== EEPROM存储地址（旧布局，仅用于首次启动迁移）=====
 #define EEPROM_SIZE 4096     // ✅ 扩容到4KB (ESP8266 Flash支持)
 #define EEPROM_WIFI_SSID 0   // SSID起始地址（最多32字节）
 #define EEPROM_WIFI_PASS 32  // 密码起始地址（最多64字节）
@@ -72,17 +174,30 @@
 
 // ===== 调试配置 =====
 #define SERIAL_BAUD 115200
-#define DEBUG_ENABLED true  // 设为false关闭调试输出
+#define DEBUG_ENABLED true  // 设为false关闭调试输出（编译期去除全部日志）
+
+// ===== 日志配置 =====
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
 
-// 调试宏
+// 编译期级别：更低级别的日志不编译进固件
 #if DEBUG_ENABLED
-#define DEBUG_PRINT(x) Serial.print(x)
-#define DEBUG_PRINTLN(x) Serial.println(x)
-#define DEBUG_PRINTF(...) Serial.printf(__VA_ARGS__)
+#define LOG_LEVEL LOG_LEVEL_DEBUG
 #else
-#define DEBUG_PRINT(x)
-#define DEBUG_PRINTLN(x)
-#define DEBUG_PRINTF(...)
+#define LOG_LEVEL LOG_LEVEL_NONE
 #endif
 
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO // 各模块启动时的运行时级别
+#define LOG_BUFFER_SIZE 2048             // 日志环形缓冲区（字节）
+#define LOG_LINE_MAX 192                 // 单条 printf 日志最大长度
+#define LOG_DRAIN_INTERVAL 5             // 串口积压时的写出间隔（毫秒）
+#define LOG_SHIP_INTERVAL 10000          // MQTT日志上报间隔（毫秒）
+#define LOG_SHIP_BATCH 512               // 每批最大字节数，积压达到时提前上报
+
+// 调试宏 DEBUG_PRINT/DEBUG_PRINTLN/DEBUG_PRINTF 及分级日志宏
+#include "logger.h"
+
 #endif  // CONFIG_H
@@ -2,18 +2,25 @@
  * 配置管理模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_SYS
+
 #include "config_manager.h"
 #include <ArduinoJson.h>
+#include <EEPROM.h>
 
 // 静态成员初始化
 DeviceConfig ConfigManager::config;
+GroupList ConfigManager::groups;
+uint32_t ConfigManager::deviceId = 0;
 bool ConfigManager::loaded = false;
 
 void ConfigManager::init() {
   DEBUG_PRINTLN("[配置] 初始化配置管理器");
 
-  // 初始化EEPROM
-  EEPROM.begin(EEPROM_SIZE);
+  // 挂载键值存储
+  if (KVStore::init() && KVStore::isFresh()) {
+    migrateLegacy();
+  }
 
   // 尝试加载配置
   if (!load()) {
@@ -24,48 +31,50 @@ void ConfigManager::init() {
 }
 
 bool ConfigManager::load() {
-  // ✅ 强制刷新：先关闭再打开，确保 buffer 内容来自真实的 Flash
-  EEPROM.end();
-  EEPROM.begin(EEPROM_SIZE);
-
-  DEBUG_PRINTLN("[配置] 从EEPROM加载配置...");
+  DEBUG_PRINTLN("[配置] 从存储加载配置...");
 
   // 读取配置结构体
-  EEPROM.get(EEPROM_CONFIG_ADDR, config);
+  int stored =
+      KVStore::get(KV_KEY_DEVICE_CONFIG, &config, sizeof(DeviceConfig));
+  bool upgraded = false;
+  if (stored == (int)LEGACY_CONFIG_SIZE) {
+    // 旧版本保存的配置：补上新字段，全部验证通过后按新布局保存
+    if (!adoptLegacyLayout()) {
+      LOG_PRINTLN(ERROR, "[配置] ❌ 旧版配置校验失败");
+      return false;
+    }
+    upgraded = true;
+  } else if (stored != (int)sizeof(DeviceConfig)) {
+    LOG_PRINTLN(ERROR, "[配置] ❌ 存储中无配置");
+    return false;
+  }
 
-  uint32_t deviceId;
-  EEPROM.get(EEPROM_DEVICE_ID, deviceId);
+  if (KVStore::get(KV_KEY_DEVICE_ID, &deviceId, sizeof(deviceId)) !=
+      (int)sizeof(deviceId)) {
+    deviceId = 0;
+  }
 
-  // ⚠️ 关键修改：不要在校验前覆盖 config.userId，否则会导致校验失败且丢失数据
-  // EEPROM.get(EEPROM_USER_ID, config.userId);
+  // 分组：未保存过或已损坏时视为未加入任何分组
+  bool groupsValid = KVStore::get(KV_KEY_GROUPS, &groups, sizeof(groups)) ==
+                     (int)sizeof(groups);
+  for (uint8_t i = 0; groupsValid && i < GROUP_MAX; i++) {
+    groups.names[i][GROUP_NAME_SIZE - 1] = '\0';
+    groupsValid =
+        groups.names[i][0] == '\0' || isValidGroupName(groups.names[i]);
+  }
+  if (!groupsValid) {
+    memset(&groups, 0, sizeof(groups));
+  }
 
   // 验证校验和
   if (!verifyChecksum()) {
-    DEBUG_PRINTF("[配置] ❌ 校验和错误! 计算值: 0x%02X, 存储值: 0x%02X\n",
-                 calculateChecksum(), config.checksum);
-
-    // 尝试从独立槽位恢复身份
-    uint32_t savedUserId;
-    EEPROM.get(EEPROM_USER_ID, savedUserId);
-    DEBUG_PRINTF("[配置] 检查独立备份UserID: %u\n", savedUserId);
-
-    resetToDefault();
-
-    // 如果独立槽位有有效数据，恢复它
-    if (savedUserId != 0 && savedUserId != 0xFFFFFFFF) {
-      config.userId = savedUserId;
-      DEBUG_PRINTF("[配置] 已从备份恢复userId: %u\n", savedUserId);
-
-      save(); // 保存修复后的配置
-      DEBUG_PRINTLN("[配置] ✅ 已通过备份修复配置");
-      return true; // ✅ 视为加载成功，阻止 init() 再次重置
-    }
-
-    save();
-    return false; // 只有真的无法恢复时才返回 false
+    LOG_PRINTF(ERROR, "[配置] ❌ 校验和错误! 计算值: 0x%02X, 存储值: 0x%02X\n",
+               calculateChecksum(), config.checksum);
+    return false;
   }
 
-  DEBUG_PRINTF("[配置] 加载userId: %u\n", config.userId);
+  DEBUG_PRINTF("[配置] 加载userId: %u, deviceId: %u\n", config.userId,
+               deviceId);
 
   // 额外验证：检查关键字段是否包含有效数据
   // 检查字符串是否为有效 ASCII（防止垃圾数据通过 checksum 验证）
@@ -79,54 +88,64 @@ bool ConfigManager::load() {
     return true;
   };
 
+  for (uint8_t i = 0; i < MQTT_MAX_BROKERS - 1; i++) {
+    if (!isValidString(config.backupBrokers[i].host,
+                       sizeof(config.backupBrokers[i].host))) {
+      LOG_PRINTLN(ERROR, "[配置] ❌ 备用服务器无效，已清除");
+      memset(config.backupBrokers, 0, sizeof(config.backupBrokers));
+      // 内存中的配置已改变：校验和随之更新，保持与内容一致
+      config.checksum = calculateChecksum();
+      break;
+    }
+  }
+
   // 验证所有字符串字段
   if (!isValidString(config.mqttServer, sizeof(config.mqttServer)) ||
       !isValidString(config.mqttUser, sizeof(config.mqttUser)) ||
       !isValidString(config.mqttPassword, sizeof(config.mqttPassword)) ||
       !isValidString(config.deviceUUID, sizeof(config.deviceUUID)) ||
       !isValidString(config.brand, sizeof(config.brand))) {
-    DEBUG_PRINTLN("[配置] ❌ 包含无效字符，配置损坏");
+    LOG_PRINTLN(ERROR, "[配置] ❌ 包含无效字符，配置损坏");
     return false;
   }
 
   // 验证数值字段的合理性
   if (config.mqttPort == 0 || config.mqttPort > 65535) {
-    DEBUG_PRINTLN("[配置] ❌ MQTT端口无效");
+    LOG_PRINTLN(ERROR, "[配置] ❌ MQTT端口无效");
     return false;
   }
 
+  // save() 同时写入 deviceId 和分组，必须在二者加载之后
+  if (upgraded) {
+    DEBUG_PRINTLN("[配置] 已升级旧版配置");
+    save();
+  }
+
   DEBUG_PRINTLN("[配置] ✅ 配置加载成功");
   loaded = true;
   return true;
 }
 
 bool ConfigManager::save() {
-  // ✅ 强制刷新
-  EEPROM.end();
-  EEPROM.begin(EEPROM_SIZE);
-
-  DEBUG_PRINTLN("[配置] 保存配置到EEPROM...");
+  DEBUG_PRINTLN("[配置] 保存配置...");
 
   // 计算校验和
   config.checksum = calculateChecksum();
 
-  // 写入EEPROM
-  EEPROM.put(EEPROM_CONFIG_ADDR, config);
-
-  // ✅ 关键修复：同步保存 userId 到独立槽位，防止 load() 时被旧数据覆盖
-  EEPROM.put(EEPROM_USER_ID, config.userId);
+  // 配置和deviceId作为一个事务写入，未变化的键不产生写入
+  KVStore::beginTransaction();
+  KVStore::put(KV_KEY_DEVICE_CONFIG, &config, sizeof(DeviceConfig));
+  KVStore::put(KV_KEY_DEVICE_ID, &deviceId, sizeof(deviceId));
+  KVStore::put(KV_KEY_GROUPS, &groups, sizeof(groups));
+  bool success = KVStore::commit();
 
-  bool success = EEPROM.commit();
-  DEBUG_PRINTF("[配置] EEPROM提交结果: %s\n", success ? "成功" : "失败");
-
-  DEBUG_PRINTLN("[配置] ✅ 配置已保存");
-  DEBUG_PRINTF("[配置] 写入Checksum: 0x%02X, UserID: %u\n", config.checksum,
+  DEBUG_PRINTF("[配置] %s Checksum: 0x%02X, UserID: %u\n",
+               success ? "✅ 已保存" : "❌ 保存失败", config.checksum,
                config.userId);
   return success;
 }
 
 void ConfigManager::resetToDefault() {
-  EEPROM.begin(EEPROM_SIZE); // ✅ 确保EEPROM已初始化
   DEBUG_PRINTLN("[配置] 重置为默认配置");
 
   // 清空整个结构体（防止残留数据）
@@ -153,6 +172,7 @@ void ConfigManager::resetToDefault() {
 
   // 用户ID：默认为0（未绑定）
   config.userId = 0;
+  deviceId = 0;
 
   // 定时器配置
   config.sensorInterval = DEFAULT_SENSOR_INTERVAL;
@@ -162,25 +182,27 @@ void ConfigManager::resetToDefault() {
   config.brand[0] = '\0';
   config.model = 1; // ✅ Default Model = 1 (IRremote standard)
 
+  // 备用服务器：默认无
+  memset(config.backupBrokers, 0, sizeof(config.backupBrokers));
+
+  // 分组：默认无
+  memset(&groups, 0, sizeof(groups));
+
   // 计算校验和
   config.checksum = calculateChecksum();
-
-  // ✅ 关键修复：同时清除单独存储的userId和deviceId
-  EEPROM.put(EEPROM_USER_ID, (uint32_t)0);
-  EEPROM.put(EEPROM_DEVICE_ID, (uint32_t)0);
 }
 
 bool ConfigManager::updateFromJSON(const char *json) {
   DEBUG_PRINTLN("[配置] 从JSON更新配置");
-  DEBUG_PRINTF("[配置] JSON: %s\n", json);
+  LOG_PRINTF(DEBUG, "[配置] JSON: %s\n", json);
 
   // 解析JSON
-  StaticJsonDocument<512> doc;
+  StaticJsonDocument<768> doc; // 含服务器列表
   DeserializationError error = deserializeJson(doc, json);
 
   if (error) {
-    DEBUG_PRINT("[配置] ❌ JSON解析失败: ");
-    DEBUG_PRINTLN(error.c_str());
+    LOG_PRINT(ERROR, "[配置] ❌ JSON解析失败: ");
+    LOG_PRINTLN(ERROR, error.c_str());
     return false;
   }
 
@@ -198,6 +220,49 @@ bool ConfigManager::updateFromJSON(const char *json) {
     changed = true;
   }
 
+  // 服务器列表：第一个为主服务器，其余为备用（按顺序）
+  if (doc.containsKey("brokers")) {
+    JsonArray list = doc["brokers"].as<JsonArray>();
+    memset(config.backupBrokers, 0, sizeof(config.backupBrokers));
+    uint8_t i = 0;
+    for (JsonObject b : list) {
+      const char *host = b["host"] | "";
+      uint16_t port = b["port"] | MQTT_PORT;
+      if (host[0] == '\0')
+        continue;
+      if (i == 0) {
+        strncpy(config.mqttServer, host, sizeof(config.mqttServer) - 1);
+        config.mqttPort = port;
+      } else if (i < MQTT_MAX_BROKERS) {
+        BrokerEntry &e = config.backupBrokers[i - 1];
+        strncpy(e.host, host, sizeof(e.host) - 1);
+        e.port = port;
+      }
+      i++;
+    }
+    changed = true;
+    DEBUG_PRINTF("[配置] 更新服务器列表: %d 个\n", min(i, (uint8_t)MQTT_MAX_BROKERS));
+  }
+
+  // 分组列表：整体替换（空数组=退出所有分组）
+  if (doc.containsKey("groups")) {
+    memset(&groups, 0, sizeof(groups));
+    uint8_t n = 0;
+    for (JsonVariant v : doc["groups"].as<JsonArray>()) {
+      if (n >= GROUP_MAX)
+        break;
+      const char *name = v.as<const char *>();
+      if (name == nullptr || strlen(name) >= GROUP_NAME_SIZE ||
+          !isValidGroupName(name)) {
+        LOG_PRINTF(WARN, "[配置] ⚠️ 忽略无效分组名: %s\n", name ? name : "null");
+        continue;
+      }
+      strncpy(groups.names[n++], name, GROUP_NAME_SIZE - 1);
+    }
+    changed = true;
+    DEBUG_PRINTF("[配置] 更新分组: %d 个\n", n);
+  }
+
   if (doc.containsKey("mqttUser")) {
     strncpy(config.mqttUser, doc["mqttUser"], sizeof(config.mqttUser) - 1);
     changed = true;
@@ -247,9 +312,30 @@ bool ConfigManager::updateFromJSON(const char *json) {
 
   // ✅ 新增：支持 deviceId 更新
   if (doc.containsKey("deviceId")) {
-    uint32_t newId = doc["deviceId"];
-    saveDeviceId(newId); // 直接保存到独立槽位
-    DEBUG_PRINTF("[配置] 更新deviceId: %u\n", newId);
+    deviceId = doc["deviceId"];
+    changed = true;
+    DEBUG_PRINTF("[配置] 更新deviceId: %u\n", deviceId);
+  }
+
+  // 日志级别和上报开关：只在运行时生效，不写入Flash（重启后恢复默认）
+  bool runtime = false;
+
+  if (doc.containsKey("log")) {
+    for (JsonPair kv : doc["log"].as<JsonObject>()) {
+      const char *level = kv.value().as<const char *>();
+      if (level == nullptr || !Logger::setLevel(kv.key().c_str(), level)) {
+        LOG_PRINTF(WARN, "[配置] ⚠️ 忽略无效日志级别: %s\n", kv.key().c_str());
+        continue;
+      }
+      DEBUG_PRINTF("[配置] 日志级别 %s: %s\n", kv.key().c_str(), level);
+    }
+    runtime = true;
+  }
+
+  if (doc.containsKey("logShip")) {
+    Logger::setShipping(doc["logShip"].as<bool>());
+    runtime = true;
+    DEBUG_PRINTF("[配置] 日志上报: %s\n", Logger::isShipping() ? "开" : "关");
   }
 
   if (changed) {
@@ -258,19 +344,42 @@ bool ConfigManager::updateFromJSON(const char *json) {
     return true;
   }
 
-  return false;
+  return runtime;
 }
 
 DeviceConfig &ConfigManager::getConfig() { return config; }
 
+const GroupList &ConfigManager::getGroups() { return groups; }
+
+bool ConfigManager::isValidGroupName(const char *name) {
+  if (name[0] == '\0')
+    return false;
+  for (const char *p = name; *p != '\0'; p++) {
+    if (!isalnum((unsigned char)*p) && *p != '_' && *p != '-')
+      return false;
+  }
+  return true;
+}
+
 void ConfigManager::printConfig() {
   DEBUG_PRINTLN("\n========== 设备配置 ==========");
   DEBUG_PRINTF("MQTT服务器: %s:%d\n", config.mqttServer, config.mqttPort);
+  for (uint8_t i = 0; i < MQTT_MAX_BROKERS - 1; i++) {
+    if (config.backupBrokers[i].host[0] != '\0') {
+      DEBUG_PRINTF("备用服务器%d: %s:%d\n", i + 1, config.backupBrokers[i].host,
+                   config.backupBrokers[i].port);
+    }
+  }
   DEBUG_PRINTF("MQTT用户: %s\n", config.mqttUser);
   DEBUG_PRINTF("设备UUID: %s\n", config.deviceUUID);
   DEBUG_PRINTF("用户ID: %u\n", config.userId);
   DEBUG_PRINTF("传感器间隔: %u ms\n", config.sensorInterval);
   DEBUG_PRINTF("Ghost窗口: %u ms\n", config.ghostWindow);
+  for (uint8_t i = 0; i < GROUP_MAX; i++) {
+    if (groups.names[i][0] != '\0') {
+      DEBUG_PRINTF("分组%d: %s\n", i + 1, groups.names[i]);
+    }
+  }
 
   // ✅ 品牌配置
   if (config.brand[0] != '\0') {
@@ -312,19 +421,83 @@ String ConfigManager::generateUUID() {
   return "ESP_" + mac;
 }
 
-// ✅ 新增：保存userId到EEPROM
-void ConfigManager::saveUserId(uint32_t userId) {
-  EEPROM.begin(EEPROM_SIZE); // ✅ 确保EEPROM已初始化
+bool ConfigManager::saveBinding(uint32_t userId, uint32_t newDeviceId) {
   config.userId = userId;
-  EEPROM.put(EEPROM_USER_ID, userId);
-  EEPROM.commit();
-  DEBUG_PRINTF("[配置] ✅ 已保存userId: %u\n", userId);
+  deviceId = newDeviceId;
+  return save();
+}
+
+uint32_t ConfigManager::getDeviceId() { return deviceId; }
+
+bool ConfigManager::adoptLegacyLayout() {
+  uint8_t *ptr = (uint8_t *)&config;
+
+  // 旧布局的校验和位于 LEGACY_CONFIG_SIZE - 1
+  uint8_t sum = 0;
+  for (size_t i = 0; i < LEGACY_CONFIG_SIZE - 1; i++) {
+    sum ^= ptr[i];
+  }
+  if (sum != ptr[LEGACY_CONFIG_SIZE - 1])
+    return false;
+
+  memset(config.backupBrokers, 0, sizeof(config.backupBrokers));
+  config.checksum = calculateChecksum();
+  return true;
 }
 
-// ✅ 新增：保存deviceId到EEPROM
-void ConfigManager::saveDeviceId(uint32_t deviceId) {
-  EEPROM.begin(EEPROM_SIZE); // ✅ 确保EEPROM已初始化
-  EEPROM.put(EEPROM_DEVICE_ID, deviceId);
-  EEPROM.commit();
-  DEBUG_PRINTF("[配置] ✅ 已保存deviceId: %u\n", deviceId);
+void ConfigManager::migrateLegacy() {
+  DEBUG_PRINTLN("[配置] 新建存储，检查旧EEPROM数据...");
+
+  EEPROM.begin(EEPROM_SIZE);
+
+  // 旧布局的 DeviceConfig 没有备用服务器字段
+  DeviceConfig legacy;
+  memset(&legacy, 0, sizeof(legacy));
+  for (size_t i = 0; i < LEGACY_CONFIG_SIZE; i++)
+    ((uint8_t *)&legacy)[i] = EEPROM.read(EEPROM_CONFIG_ADDR + i);
+
+  uint32_t legacyDeviceId;
+  EEPROM.get(EEPROM_DEVICE_ID, legacyDeviceId);
+
+  uint32_t legacyUserId;
+  EEPROM.get(EEPROM_USER_ID, legacyUserId);
+
+  WiFiCredentials creds;
+  memset(&creds, 0, sizeof(creds));
+  for (int i = 0; i < 32; i++)
+    creds.ssid[i] = EEPROM.read(EEPROM_WIFI_SSID + i);
+  for (int i = 0; i < 64; i++)
+    creds.password[i] = EEPROM.read(EEPROM_WIFI_PASS + i);
+
+  EEPROM.end();
+
+  // 所有迁移的键一次提交
+  KVStore::beginTransaction();
+  uint8_t migrated = 0;
+
+  config = legacy;
+  if (adoptLegacyLayout() && config.mqttPort != 0) {
+    KVStore::put(KV_KEY_DEVICE_CONFIG, &config, sizeof(DeviceConfig));
+    migrated++;
+  } else if (legacyUserId != 0 && legacyUserId != 0xFFFFFFFF) {
+    // 配置损坏但独立槽位有userId：保留绑定关系
+    resetToDefault();
+    config.userId = legacyUserId;
+    config.checksum = calculateChecksum();
+    KVStore::put(KV_KEY_DEVICE_CONFIG, &config, sizeof(DeviceConfig));
+    migrated++;
+  }
+
+  if (legacyDeviceId != 0 && legacyDeviceId != 0xFFFFFFFF) {
+    KVStore::put(KV_KEY_DEVICE_ID, &legacyDeviceId, sizeof(legacyDeviceId));
+    migrated++;
+  }
+
+  if (creds.ssid[0] != '\0' && creds.ssid[0] != (char)0xFF) {
+    KVStore::put(KV_KEY_WIFI_CREDENTIALS, &creds, sizeof(creds));
+    migrated++;
+  }
+
+  KVStore::commit();
+  DEBUG_PRINTF("[配置] 已迁移 %d 项旧数据\n", migrated);
 }
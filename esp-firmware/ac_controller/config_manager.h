@@ -2,8 +2,8 @@
  * 配置管理模块
  *
  * 功能：
- * - 从EEPROM加载配置
- * - 保存配置到EEPROM
+ * - 从日志式键值存储加载/保存配置（见 kv_store.h）
+ * - 首次启动时从旧EEPROM布局迁移
  * - 支持MQTT动态配置更新
  * - 生成默认配置（使用MAC地址）
  */
@@ -12,10 +12,27 @@
 #define CONFIG_MANAGER_H
 
 #include "config.h"
+#include "kv_store.h"
 #include <Arduino.h>
-#include <EEPROM.h>
 #include <ESP8266WiFi.h>
 
+// WiFi凭证（KV_KEY_WIFI_CREDENTIALS）
+struct WiFiCredentials {
+  char ssid[33];
+  char password[65];
+};
+
+// 备用MQTT服务器
+struct BrokerEntry {
+  char host[64]; // 空字符串=未使用
+  uint16_t port;
+} __attribute__((packed));
+
+// 设备所属分组（KV_KEY_GROUPS，独立于 DeviceConfig 保存）
+struct GroupList {
+  char names[GROUP_MAX][GROUP_NAME_SIZE]; // 空字符串=未使用
+};
+
 // 配置结构体
 struct DeviceConfig {
   char mqttServer[64];     // MQTT服务器地址
@@ -31,6 +48,9 @@ struct DeviceConfig {
   char brand[16]; // 品牌："GREE", "MIDEA", "DAIKIN" 等
   uint8_t model;  // 型号代码 (0-255)
 
+  // 备用MQTT服务器（按优先级排列，主服务器为 mqttServer/mqttPort）
+  BrokerEntry backupBrokers[MQTT_MAX_BROKERS - 1];
+
   uint8_t checksum;        // 校验和
 } __attribute__((packed)); // ✅ 强制字节对齐，防止 Padding 导致校验和计算错误
 
@@ -39,10 +59,10 @@ public:
   // 初始化配置管理器
   static void init();
 
-  // 加载配置（从EEPROM或生成默认配置）
+  // 加载配置（从存储或生成默认配置）
   static bool load();
 
-  // 保存配置到EEPROM
+  // 保存配置和deviceId（一个事务，未变化的值不写入）
   static bool save();
 
   // 重置为默认配置
@@ -54,17 +74,22 @@ public:
   // 获取配置
   static DeviceConfig &getConfig();
 
+  // 设备所属分组
+  static const GroupList &getGroups();
+
   // 打印配置信息
   static void printConfig();
 
-  // ✅ 新增：保存userId到EEPROM
-  static void saveUserId(uint32_t userId);
+  // 保存绑定信息（userId + deviceId 一次写入）
+  static bool saveBinding(uint32_t userId, uint32_t deviceId);
 
-  // ✅ 新增：保存deviceId到EEPROM
-  static void saveDeviceId(uint32_t deviceId);
+  // 服务器分配的设备ID（0=未绑定）
+  static uint32_t getDeviceId();
 
 private:
   static DeviceConfig config;
+  static GroupList groups;
+  static uint32_t deviceId;
   static bool loaded;
 
   // 计算校验和
@@ -73,11 +98,24 @@ private:
   // 验证校验和
   static bool verifyChecksum();
 
+  // 分组名只允许字母、数字、'_' 和 '-'（会拼入topic）
+  static bool isValidGroupName(const char *name);
+
   // 生成基于MAC的默认UUID
   static String generateUUID();
 
-  // EEPROM配置存储地址
+  // 从旧EEPROM布局迁移（仅新建日志时执行一次）
+  static void migrateLegacy();
+
+  // 接受没有备用服务器字段的旧版配置（长度 LEGACY_CONFIG_SIZE）
+  static bool adoptLegacyLayout();
+
+  // 旧EEPROM布局中的配置地址
   static const uint16_t EEPROM_CONFIG_ADDR = 256;
+
+  // 加入备用服务器之前的配置长度（校验和紧跟 model 字段）
+  static const size_t LEGACY_CONFIG_SIZE =
+      offsetof(DeviceConfig, backupBrokers) + 1;
 };
 
 #endif // CONFIG_MANAGER_H
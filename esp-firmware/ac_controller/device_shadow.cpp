@@ -0,0 +1,129 @@
+/*
+ * 设备影子模块 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_STATE
+
+#include "device_shadow.h"
+#include "command_parser.h"
+#include "message_arena.h"
+#include "mqtt_client.h"
+#include <ArduinoJson.h>
+
+// 静态成员初始化
+uint32_t DeviceShadow::version = 0;
+uint32_t DeviceShadow::reportedVersion = 0;
+ACState DeviceShadow::reported;
+bool DeviceShadow::synced = false;
+void (*DeviceShadow::handler)(const char *json) = nullptr;
+
+void DeviceShadow::init() {
+  EventBus::subscribe(EVT_STATE_CHANGED, onStateChanged);
+}
+
+void DeviceShadow::setHandler(void (*h)(const char *json)) { handler = h; }
+
+void DeviceShadow::handleDesired(const char *json) {
+  StaticJsonDocument<256> doc;
+  if (deserializeJson(doc, json)) {
+    LOG_PRINTLN(ERROR, "[影子] ❌ JSON解析失败");
+    return;
+  }
+
+  uint32_t desiredVersion = doc["version"] | 0;
+  if (desiredVersion <= version) {
+    DEBUG_PRINTF("[影子] 忽略旧版本 %u (已应用 %u)\n", desiredVersion, version);
+    return;
+  }
+  version = desiredVersion;
+
+  // 与当前状态相同的期望（如重启后服务器补发）不再发射红外；
+  // 按 /cmd 的规则解析（缺省字段取当前值，温度和风速归一）后整体比较
+  const ACState &state = StateManager::getState();
+  ControlCommand desired;
+  bool differs = CommandParser::parse(json, state, desired) &&
+                 !acSameSettings(desired.state, state);
+
+  if (differs && handler != nullptr) {
+    DEBUG_PRINTF("[影子] 应用期望状态 v%u\n", version);
+    ACState before = state;
+    handler(json);
+
+    // 状态已变化：由状态变更事件的增量上报一并带上新版本
+    if (!acSameSettings(before, StateManager::getState()))
+      return;
+  }
+
+  // 没有产生状态变化（期望与当前相同或执行失败）：只确认版本
+  if (reportedVersion != version) {
+    publish(false);
+  }
+}
+
+void DeviceShadow::sync() {
+  synced = false;
+  publish(true);
+}
+
+uint32_t DeviceShadow::getVersion() { return version; }
+
+void DeviceShadow::onStateChanged(const Event &event) {
+  // 未发布完整状态前不发增量（连接后由 sync() 发布）
+  if (synced) {
+    publish(false);
+  }
+}
+
+void DeviceShadow::publish(bool full) {
+  if (!MQTTClient::isConnected())
+    return;
+
+  ACState now = StateManager::getState();
+
+  ArenaJsonDocument doc(256);
+  doc["version"] = version;
+  if (full) {
+    doc["full"] = true;
+  }
+
+  uint8_t fields = 0;
+  if (full || now.power != reported.power) {
+    doc["power"] = (bool)now.power;
+    fields++;
+  }
+  if (full || now.mode != reported.mode) {
+    doc["mode"] = acModeName(now.mode);
+    fields++;
+  }
+  if (full || now.temp != reported.temp) {
+    doc["setTemp"] = now.temp;
+    fields++;
+  }
+  if (full || now.fan != reported.fan) {
+    doc["fan"] = (uint8_t)now.fan;
+    fields++;
+  }
+  if (full || now.swingV != reported.swingV) {
+    doc["swingVertical"] = (bool)now.swingV;
+    fields++;
+  }
+  if (full || now.swingH != reported.swingH) {
+    doc["swingHorizontal"] = (bool)now.swingH;
+    fields++;
+  }
+
+  // 状态和版本都没有变化：无需上报
+  if (fields == 0 && reportedVersion == version) {
+    return;
+  }
+  doc["source"] = acSourceName(now.source);
+
+  String topic = MQTTClient::getTopic("shadow/reported");
+  if (MQTTClient::publishJson(topic.c_str(), doc)) {
+    reported = now;
+    reportedVersion = version;
+    synced = true;
+    DEBUG_PRINTF("[影子] ✅ 已上报 v%u (%s, %d 个字段)\n", version,
+                 full ? "完整" : "增量", fields);
+  }
+}
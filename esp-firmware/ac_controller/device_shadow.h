@@ -0,0 +1,58 @@
+/*
+ * 设备影子模块
+ *
+ * 功能：
+ * - 期望状态（desired）按版本号增量下发：服务器只发送变化的字段，
+ *   未包含的字段保持当前值，版本号不大于已应用版本的消息忽略
+ * - 实际状态（reported）增量上报：只发送相对上次上报变化的字段，
+ *   并带上已应用的期望版本号
+ * - 重连后发布一条完整的 reported（full=true），服务器比较版本号后
+ *   最多补发一条期望状态，不需要重新下发全部命令
+ *
+ * 下行 shadow/desired：{"version":42,"setTemp":24}
+ * 上行 shadow/reported：{"version":42,"setTemp":24,"source":"api"}
+ *
+ * 已应用版本只保存在内存中：重启后从0开始，服务器会补发最新的期望状态，
+ * 与当前状态相同的字段不会再次发射红外。
+ */
+
+#ifndef DEVICE_SHADOW_H
+#define DEVICE_SHADOW_H
+
+#include "config.h"
+#include "event_bus.h"
+#include "state_manager.h"
+#include <Arduino.h>
+
+class DeviceShadow {
+public:
+  // 订阅状态变更事件（在 StateManager::init 之后调用）
+  static void init();
+
+  // 设置期望状态的执行函数（与 /cmd 使用同一个处理函数，缺省字段保持当前值）
+  static void setHandler(void (*handler)(const char *json));
+
+  // 处理 shadow/desired 消息
+  static void handleDesired(const char *json);
+
+  // 连接建立后发布完整的 reported
+  static void sync();
+
+  // 已应用的期望版本
+  static uint32_t getVersion();
+
+private:
+  static uint32_t version;         // 已应用的期望版本
+  static uint32_t reportedVersion; // 上次上报时的版本
+  static ACState reported;         // 上次上报的状态
+  static bool synced;              // 本次连接已发布完整状态
+  static void (*handler)(const char *json);
+
+  // 发布 reported（full=false 时只含变化字段，无变化时不发布）
+  static void publish(bool full);
+
+  // EVT_STATE_CHANGED 消费者：上报增量
+  static void onStateChanged(const Event &event);
+};
+
+#endif // DEVICE_SHADOW_H
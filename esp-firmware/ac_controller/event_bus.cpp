@@ -0,0 +1,120 @@
+/*
+ * 内部事件总线 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_SYS
+
+#include "event_bus.h"
+
+// 静态成员初始化
+Event EventBus::queue[EVENT_QUEUE_SIZE];
+uint8_t EventBus::head = 0;
+uint8_t EventBus::count = 0;
+uint8_t EventBus::maxDepth = 0;
+EventHandler EventBus::handlers[EVT_TYPE_COUNT][EVENT_MAX_HANDLERS] = {};
+EventStats EventBus::stats[EVT_TYPE_COUNT] = {};
+TaskId EventBus::dispatchTask = SCHED_INVALID_TASK;
+
+void EventBus::init() {
+  DEBUG_PRINTLN("[事件] 初始化事件总线");
+  dispatchTask = Scheduler::addOneShot("events", dispatch);
+}
+
+bool EventBus::subscribe(EventType type, EventHandler handler) {
+  if (type >= EVT_TYPE_COUNT)
+    return false;
+
+  for (uint8_t i = 0; i < EVENT_MAX_HANDLERS; i++) {
+    if (handlers[type][i] == nullptr) {
+      handlers[type][i] = handler;
+      return true;
+    }
+  }
+
+  LOG_PRINTF(ERROR, "[事件] ❌ %s 订阅者已满\n", typeName(type));
+  return false;
+}
+
+bool EventBus::post(const Event &event) {
+  if (event.type >= EVT_TYPE_COUNT)
+    return false;
+
+  EventStats &s = stats[event.type];
+
+  if (count >= EVENT_QUEUE_SIZE) {
+    s.dropped++;
+    LOG_PRINTF(WARN, "[事件] ⚠️ 队列已满，丢弃 %s\n", typeName(event.type));
+    return false;
+  }
+
+  Event &slot = queue[(head + count) % EVENT_QUEUE_SIZE];
+  slot = event;
+  if (slot.timestamp == 0)
+    slot.timestamp = millis();
+  count++;
+
+  s.posted++;
+  s.depth++;
+  if (s.depth > s.maxDepth)
+    s.maxDepth = s.depth;
+  if (count > maxDepth)
+    maxDepth = count;
+
+  // 下一个调度周期分发
+  Scheduler::trigger(dispatchTask);
+  return true;
+}
+
+bool EventBus::post(EventType type) {
+  Event event;
+  memset(&event, 0, sizeof(Event));
+  event.type = type;
+  return post(event);
+}
+
+void EventBus::dispatch() {
+  // 只处理进入时已排队的事件，处理过程中新投递的留到下一周期
+  uint8_t pending = count;
+
+  while (pending-- > 0 && count > 0) {
+    Event event = queue[head];
+    head = (head + 1) % EVENT_QUEUE_SIZE;
+    count--;
+
+    EventStats &s = stats[event.type];
+    s.depth--;
+    s.dispatched++;
+
+    for (uint8_t i = 0; i < EVENT_MAX_HANDLERS; i++) {
+      EventHandler handler = handlers[event.type][i];
+      if (handler == nullptr)
+        break;
+      handler(event);
+    }
+  }
+
+  if (count > 0) {
+    Scheduler::trigger(dispatchTask);
+  }
+}
+
+const EventStats &EventBus::getStats(EventType type) {
+  return stats[type < EVT_TYPE_COUNT ? type : 0];
+}
+
+uint8_t EventBus::getMaxDepth() { return maxDepth; }
+
+const char *EventBus::typeName(EventType type) {
+  switch (type) {
+  case EVT_IR_FRAME:
+    return "ir_frame";
+  case EVT_STATE_CHANGED:
+    return "state";
+  case EVT_MIC_BEEP:
+    return "mic";
+  case EVT_SENSOR_SAMPLE:
+    return "sensor";
+  default:
+    return "unknown";
+  }
+}
@@ -0,0 +1,85 @@
+/*
+ * 内部事件总线
+ *
+ * 功能：
+ * - 固定容量的类型化事件队列（无动态分配）
+ * - 生产者投递后立即返回，消费者在下一个调度周期处理
+ * - 按事件类型统计投递/丢弃/处理次数和队列深度
+ */
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include "config.h"
+#include "scheduler.h"
+#include <Arduino.h>
+
+class decode_results;
+
+// 事件类型
+enum EventType : uint8_t {
+  EVT_IR_FRAME,      // 收到一帧红外信号（待解码）
+  EVT_STATE_CHANGED, // 空调状态已变更
+  EVT_MIC_BEEP,      // 麦克风检测到蜂鸣
+  EVT_SENSOR_SAMPLE, // 传感器完成一次采样
+  EVT_TYPE_COUNT
+};
+
+// 事件（按值拷贝进队列）
+struct Event {
+  EventType type;
+  uint32_t timestamp; // 投递时间（millis）
+  union {
+    decode_results *irFrame; // EVT_IR_FRAME：处理完前保持有效
+    uint32_t micTime;        // EVT_MIC_BEEP：中断记录的触发时间
+    struct {
+      float temperature;
+      float humidity;
+      float current;
+    } sensor; // EVT_SENSOR_SAMPLE
+  } data;
+};
+
+typedef void (*EventHandler)(const Event &event);
+
+// 单个事件类型的统计
+struct EventStats {
+  uint32_t posted;     // 成功投递
+  uint32_t dropped;    // 队列满丢弃
+  uint32_t dispatched; // 已处理
+  uint8_t depth;       // 当前排队数
+  uint8_t maxDepth;    // 排队数峰值
+};
+
+class EventBus {
+public:
+  // 初始化（注册分发任务）
+  static void init();
+
+  // 订阅事件（同类型按订阅顺序调用）
+  static bool subscribe(EventType type, EventHandler handler);
+
+  // 投递事件，队列满时返回false
+  static bool post(const Event &event);
+  static bool post(EventType type);
+
+  // 分发排队事件（调度器任务）
+  static void dispatch();
+
+  // 统计信息
+  static const EventStats &getStats(EventType type);
+  static uint8_t getMaxDepth();
+  static const char *typeName(EventType type);
+
+private:
+  static Event queue[EVENT_QUEUE_SIZE];
+  static uint8_t head;
+  static uint8_t count;
+  static uint8_t maxDepth;
+
+  static EventHandler handlers[EVT_TYPE_COUNT][EVENT_MAX_HANDLERS];
+  static EventStats stats[EVT_TYPE_COUNT];
+  static TaskId dispatchTask;
+};
+
+#endif // EVENT_BUS_H
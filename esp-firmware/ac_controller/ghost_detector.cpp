@@ -2,17 +2,23 @@
  * Ghost检测器模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_IR
+
 #include "ghost_detector.h"
 #include "config_manager.h"
+#include "message_arena.h"
 #include "mqtt_client.h"
 #include <ArduinoJson.h>
 
+#if GHOST_DETECTOR_ENABLED
+
 
 // 静态成员初始化
 MicConfig GhostDetector::micConfig = {true, 50, 500, "short"};
 unsigned long GhostDetector::lastIRTime = 0;
 unsigned long GhostDetector::lastMicTime = 0;
-bool GhostDetector::lastMicState = LOW;
+volatile unsigned long GhostDetector::micEdgeTime = 0;
+TaskId GhostDetector::micTask = SCHED_INVALID_TASK;
 
 void GhostDetector::init() {
   DEBUG_PRINTLN("[Ghost] 初始化Ghost检测器");
@@ -20,22 +26,36 @@ void GhostDetector::init() {
   // 配置麦克风引脚
   pinMode(PIN_MIC, INPUT);
 
+  // 上升沿由中断捕获，主循环睡眠期间也不会漏掉短促的蜂鸣
+  micTask = Scheduler::addOneShot("ghost_mic", update);
+  EventBus::subscribe(EVT_MIC_BEEP, onMicBeep);
+  attachInterrupt(digitalPinToInterrupt(PIN_MIC), onMicEdge, RISING);
+
   DEBUG_PRINTLN("[Ghost] ✅ Ghost检测器就绪");
 }
 
+void IRAM_ATTR GhostDetector::onMicEdge() {
+  micEdgeTime = millis();
+  Scheduler::triggerFromISR(micTask);
+}
+
 void GhostDetector::update() {
   if (!micConfig.enabled)
     return;
 
-  // 读取麦克风状态
-  bool micState = digitalRead(PIN_MIC);
+  Event event;
+  memset(&event, 0, sizeof(Event));
+  event.type = EVT_MIC_BEEP;
+  event.data.micTime = micEdgeTime;
+  EventBus::post(event);
+}
 
-  // 检测上升沿（麦克风触发）
-  if (micState == HIGH && lastMicState == LOW) {
-    onMicTriggered();
-  }
+void GhostDetector::onMicBeep(const Event &event) {
+  onMicTriggered();
 
-  lastMicState = micState;
+  // 以中断记录的时间为准，不受事件排队延迟影响
+  if (event.data.micTime != 0)
+    lastMicTime = event.data.micTime;
 }
 
 void GhostDetector::onIRReceived() {
@@ -83,17 +103,16 @@ void GhostDetector::publishGhostEvent() {
     return;
 
   // 构建Ghost事件消息
-  StaticJsonDocument<256> doc;
+  ArenaJsonDocument doc(128);
   doc["type"] = "ghost";
   doc["timestamp"] = millis() / 1000;
   doc["timeSinceMic"] = lastIRTime - lastMicTime;
 
-  char payload[256];
-  serializeJson(doc, payload);
-
   // 发布到MQTT
   String topic = MQTTClient::getTopic("event");
-  if (MQTTClient::publish(topic.c_str(), payload)) {
+  if (MQTTClient::publishJson(topic.c_str(), doc)) {
     DEBUG_PRINTLN("[Ghost] ✅ Ghost事件已发布");
   }
 }
+
+#endif // GHOST_DETECTOR_ENABLED
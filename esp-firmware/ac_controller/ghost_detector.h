@@ -12,6 +12,8 @@
 #define GHOST_DETECTOR_H
 
 #include "config.h"
+#include "event_bus.h"
+#include "scheduler.h"
 #include <Arduino.h>
 
 
@@ -28,7 +30,7 @@ public:
   // 初始化Ghost检测器
   static void init();
 
-  // 更新检测状态（在loop中调用）
+  // 投递 EVT_MIC_BEEP（由中断触发的调度任务）
   static void update();
 
   // 红外接收回调
@@ -48,7 +50,14 @@ private:
   static MicConfig micConfig;
   static unsigned long lastIRTime;
   static unsigned long lastMicTime;
-  static bool lastMicState;
+  static volatile unsigned long micEdgeTime; // 中断记录的上升沿时间
+  static TaskId micTask;
+
+  // 麦克风上升沿中断
+  static void IRAM_ATTR onMicEdge();
+
+  // EVT_MIC_BEEP 消费者
+  static void onMicBeep(const Event &event);
 
   // 发布Ghost事件
   static void publishGhostEvent();
@@ -0,0 +1,86 @@
+/*
+ * 分组命令模块 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_STATE
+
+#include "group_command.h"
+#include "checksum.h"
+#include <ArduinoJson.h>
+#include <ESP8266WiFi.h>
+
+// 静态成员初始化
+char GroupCommand::pending[GROUP_CMD_SIZE] = {0};
+TaskId GroupCommand::task = SCHED_INVALID_TASK;
+void (*GroupCommand::handler)(const char *json) = nullptr;
+
+void GroupCommand::setHandler(void (*h)(const char *json)) { handler = h; }
+
+bool GroupCommand::isGroupTopic(const char *topic) {
+  return strstr(topic, "/group/") != nullptr;
+}
+
+void GroupCommand::handle(const char *topic, const char *json) {
+  size_t length = strlen(json);
+  if (length >= GROUP_CMD_SIZE) {
+    LOG_PRINTF(ERROR, "[分组] ❌ 命令过长 (%u 字节)，丢弃\n", length);
+    return;
+  }
+
+  // 只取出错峰窗口，命令本身在执行时再完整解析
+  StaticJsonDocument<32> filter;
+  filter["jitter"] = true;
+  StaticJsonDocument<64> doc;
+  DeserializationError error =
+      deserializeJson(doc, json, DeserializationOption::Filter(filter));
+  if (error) {
+    LOG_PRINTLN(ERROR, "[分组] ❌ JSON解析失败");
+    return;
+  }
+
+  uint32_t window = doc["jitter"] | GROUP_JITTER_DEFAULT;
+  if (window > GROUP_JITTER_MAX) {
+    window = GROUP_JITTER_MAX;
+  }
+  uint32_t delayMs = jitterFor(window);
+
+  if (task == SCHED_INVALID_TASK) {
+    task = Scheduler::addOneShot("group_cmd", execute);
+  }
+  if (pending[0] != '\0') {
+    LOG_PRINTLN(WARN, "[分组] ⚠️ 上一条分组命令尚未执行，已被替换");
+  }
+  memcpy(pending, json, length + 1);
+
+  DEBUG_PRINTF("[分组] 收到分组命令: %s，%u ms 后执行\n", topic, delayMs);
+  if (delayMs == 0) {
+    execute();
+  } else {
+    Scheduler::schedule(task, delayMs);
+  }
+}
+
+uint32_t GroupCommand::jitterFor(uint32_t window) {
+  if (window == 0)
+    return 0;
+
+  // 同一设备每次得到相同的偏移，便于排查；CRC使各设备在窗口内均匀分布
+  static uint32_t seed = 0;
+  if (seed == 0) {
+    String mac = WiFi.macAddress();
+    seed = Checksum::crc32(mac.c_str(), mac.length());
+  }
+  return seed % window;
+}
+
+void GroupCommand::execute() {
+  Scheduler::cancel(task);
+  if (pending[0] == '\0')
+    return;
+
+  DEBUG_PRINTLN("[分组] → 执行分组命令");
+  if (handler != nullptr) {
+    handler(pending);
+  }
+  pending[0] = '\0';
+}
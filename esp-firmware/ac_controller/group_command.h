@@ -0,0 +1,43 @@
+/*
+ * 分组命令模块
+ *
+ * 功能：
+ * - 处理分组topic（ac/user_X/group/<name>/cmd）上的共享控制命令，
+ *   服务器对一个分组只需发布一次
+ * - 按设备确定性错峰执行：延迟由MAC的CRC在错峰窗口内取值，
+ *   同一设备每次相同、不同设备均匀分散，红外发射和随后的状态上报不会同时发生
+ * - 命令格式与 /cmd 相同，可附加 "jitter"（错峰窗口毫秒数，0=立即执行）
+ * - 等待期间收到新的分组命令时，以新命令为准
+ */
+
+#ifndef GROUP_COMMAND_H
+#define GROUP_COMMAND_H
+
+#include "config.h"
+#include "scheduler.h"
+#include <Arduino.h>
+
+class GroupCommand {
+public:
+  // 设置命令执行函数（与 /cmd 使用同一个处理函数）
+  static void setHandler(void (*handler)(const char *json));
+
+  // 是否为分组命令topic
+  static bool isGroupTopic(const char *topic);
+
+  // 收到分组命令：按本设备的错峰延迟安排执行
+  static void handle(const char *topic, const char *json);
+
+  // 本设备在给定错峰窗口内的延迟（毫秒）
+  static uint32_t jitterFor(uint32_t window);
+
+private:
+  static char pending[GROUP_CMD_SIZE];
+  static TaskId task;
+  static void (*handler)(const char *json);
+
+  // 错峰延迟到期：执行等待中的命令
+  static void execute();
+};
+
+#endif // GROUP_COMMAND_H
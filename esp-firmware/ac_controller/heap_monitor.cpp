@@ -0,0 +1,262 @@
+/*
+ * 内存监控模块 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_SYS
+
+#include "heap_monitor.h"
+#include "message_arena.h"
+#include "mqtt_client.h"
+#include <ArduinoJson.h>
+#include <cont.h>
+
+static const char *const LEVEL_NAMES[MEM_LEVEL_COUNT] = {"ok", "low",
+                                                         "critical"};
+
+// 静态成员初始化
+HeapStats HeapMonitor::stats = {};
+MemoryLevel HeapMonitor::level = MEM_OK;
+uint32_t HeapMonitor::lastPublish = 0;
+TaskId HeapMonitor::task = SCHED_INVALID_TASK;
+MessageHeapStats HeapMonitor::messages[HEAP_MSG_TYPES];
+uint8_t HeapMonitor::messageCount = 0;
+MessageHeapStats *HeapMonitor::current = nullptr;
+uint32_t HeapMonitor::messageFreeHeap = 0;
+uint32_t HeapMonitor::allocCount = 0;
+uint32_t HeapMonitor::allocBytes = 0;
+uint32_t HeapMonitor::messageAllocs = 0;
+uint32_t HeapMonitor::messageAllocBytes = 0;
+
+void HeapMonitor::init() {
+  stats.minFreeHeap = UINT32_MAX;
+  stats.minMaxBlock = UINT32_MAX;
+  task = Scheduler::addPeriodic("heap", HEAP_SAMPLE_INTERVAL, sample);
+  sample();
+}
+
+void HeapMonitor::sample() {
+  stats.freeHeap = ESP.getFreeHeap();
+  stats.maxBlock = ESP.getMaxFreeBlockSize();
+  stats.fragmentation = ESP.getHeapFragmentation();
+  stats.samples++;
+
+  if (stats.freeHeap < stats.minFreeHeap)
+    stats.minFreeHeap = stats.freeHeap;
+  if (stats.maxBlock < stats.minMaxBlock)
+    stats.minMaxBlock = stats.maxBlock;
+  if (stats.fragmentation > stats.maxFragmentation)
+    stats.maxFragmentation = stats.fragmentation;
+
+  // 栈峰值：当前水位（自上次重绘以来）和各任务的抽样峰值
+  uint16_t stackUsed = CONT_STACKSIZE - ESP.getFreeContStack();
+  if (stackUsed > stats.stackPeak)
+    stats.stackPeak = stackUsed;
+  for (uint8_t i = 0; i < Scheduler::getTaskCount(); i++) {
+    const SchedulerTask *t = Scheduler::getTask(i);
+    if (t->stackPeak > stats.stackPeak)
+      stats.stackPeak = t->stackPeak;
+  }
+
+  // 变差立即生效，恢复需要高出阈值 HEAP_RECOVER_MARGIN
+  MemoryLevel next = levelFor(stats.freeHeap, stats.maxBlock, 0);
+  if (next < level) {
+    next = levelFor(stats.freeHeap, stats.maxBlock, HEAP_RECOVER_MARGIN);
+  }
+
+  bool changed = next != level;
+  if (changed) {
+    if (next > level) {
+      if (level == MEM_OK)
+        stats.lowEvents++;
+      LOG_PRINTF(WARN, "[内存] ⚠️ 内存%s: 空闲 %u, 最大块 %u, 碎片 %u%%\n",
+                 next == MEM_CRITICAL ? "严重不足" : "不足", stats.freeHeap,
+                 stats.maxBlock, stats.fragmentation);
+    } else {
+      DEBUG_PRINTF("[内存] 内存恢复到 %s: 空闲 %u, 最大块 %u\n",
+                   LEVEL_NAMES[next], stats.freeHeap, stats.maxBlock);
+    }
+    level = next;
+  }
+
+  if (changed || millis() - lastPublish >= HEAP_PUBLISH_INTERVAL) {
+    publish();
+  }
+}
+
+MemoryLevel HeapMonitor::levelFor(uint32_t freeHeap, uint32_t maxBlock,
+                                  uint32_t margin) {
+  if (freeHeap < HEAP_CRITICAL_FREE + margin ||
+      maxBlock < HEAP_CRITICAL_BLOCK + margin)
+    return MEM_CRITICAL;
+  if (freeHeap < HEAP_LOW_FREE + margin || maxBlock < HEAP_LOW_BLOCK + margin)
+    return MEM_LOW;
+  return MEM_OK;
+}
+
+MemoryLevel HeapMonitor::getLevel() { return level; }
+
+const char *HeapMonitor::levelName(MemoryLevel value) {
+  return value < MEM_LEVEL_COUNT ? LEVEL_NAMES[value] : "?";
+}
+
+bool HeapMonitor::allowOptional() {
+  if (level == MEM_OK)
+    return true;
+  stats.deferred++;
+  return false;
+}
+
+bool HeapMonitor::canAllocate(size_t size) {
+  // 实时检查：分配后空闲堆不能低于严重阈值
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (level != MEM_CRITICAL && ESP.getMaxFreeBlockSize() >= size &&
+      freeHeap >= size + HEAP_CRITICAL_FREE)
+    return true;
+
+  stats.refused++;
+  LOG_PRINTF(WARN, "[内存] ⚠️ 拒绝分配 %u 字节 (空闲 %u)\n", size, freeHeap);
+  return false;
+}
+
+void HeapMonitor::beginMessage(const char *type) {
+  if (type == nullptr)
+    type = "other";
+
+  current = nullptr;
+  for (uint8_t i = 0; i < messageCount; i++) {
+    if (strcmp(messages[i].type, type) == 0) {
+      current = &messages[i];
+      break;
+    }
+  }
+  if (current == nullptr) {
+    if (messageCount >= HEAP_MSG_TYPES)
+      return; // 统计表已满，不记录新类型
+    current = &messages[messageCount++];
+    memset(current, 0, sizeof(MessageHeapStats));
+    current->type = type;
+  }
+
+  messageFreeHeap = ESP.getFreeHeap();
+  messageAllocs = allocCount;
+  messageAllocBytes = allocBytes;
+  // 重绘栈：处理结束时的水位即为本条消息的峰值
+  ESP.resetFreeContStack();
+}
+
+void HeapMonitor::endMessage() {
+  if (current == nullptr)
+    return;
+
+  uint16_t stackUsed = CONT_STACKSIZE - ESP.getFreeContStack();
+  uint32_t freeHeap = ESP.getFreeHeap();
+
+  current->count++;
+  if (stackUsed > current->stackPeak)
+    current->stackPeak = stackUsed;
+  if (stackUsed > stats.stackPeak)
+    stats.stackPeak = stackUsed;
+  if (messageFreeHeap > freeHeap &&
+      messageFreeHeap - freeHeap > current->heapKept)
+    current->heapKept = messageFreeHeap - freeHeap;
+  current->allocs += allocCount - messageAllocs;
+  current->allocBytes += allocBytes - messageAllocBytes;
+  current = nullptr;
+}
+
+void HeapMonitor::countAllocation(size_t size) {
+  allocCount++;
+  allocBytes += size;
+}
+
+const HeapStats &HeapMonitor::getStats() { return stats; }
+
+uint8_t HeapMonitor::getMessageTypeCount() { return messageCount; }
+
+const MessageHeapStats &HeapMonitor::getMessageStats(uint8_t index) {
+  return messages[index < messageCount ? index : 0];
+}
+
+// 摘要字段（低内存时只发这些）
+static void addSummary(JsonDocument &doc, MemoryLevel level,
+                       const HeapStats &stats) {
+  doc["level"] = HeapMonitor::levelName(level);
+  doc["free"] = stats.freeHeap;
+  doc["maxBlock"] = stats.maxBlock;
+  doc["frag"] = stats.fragmentation;
+  doc["minFree"] = stats.minFreeHeap;
+  doc["minBlock"] = stats.minMaxBlock;
+  doc["maxFrag"] = stats.maxFragmentation;
+  doc["stackPeak"] = stats.stackPeak;
+  doc["lowEvents"] = stats.lowEvents;
+  doc["deferred"] = stats.deferred;
+  doc["refused"] = stats.refused;
+}
+
+void HeapMonitor::publish() {
+  if (!MQTTClient::isConnected())
+    return;
+
+  String topic = MQTTClient::getTopic("diag/heap");
+  bool ok;
+  if (level != MEM_OK) {
+    // 低内存：摘要放在静态缓冲区，不再占用堆
+    ArenaJsonDocument doc(256);
+    addSummary(doc, level, stats);
+    ok = MQTTClient::publishJson(topic.c_str(), doc);
+  } else {
+    DynamicJsonDocument doc(2048);
+    addSummary(doc, level, stats);
+
+    // 各任务的栈使用峰值（尚未抽样的任务不列出）
+    JsonObject tasks = doc.createNestedObject("tasks");
+    for (uint8_t i = 0; i < Scheduler::getTaskCount(); i++) {
+      const SchedulerTask *t = Scheduler::getTask(i);
+      if (t->stackPeak > 0)
+        tasks[t->name] = t->stackPeak;
+    }
+
+    // 按消息类型
+    JsonObject msgs = doc.createNestedObject("messages");
+    for (uint8_t i = 0; i < messageCount; i++) {
+      const MessageHeapStats &m = messages[i];
+      JsonObject o = msgs.createNestedObject(m.type);
+      o["n"] = m.count;
+      o["stack"] = m.stackPeak;
+      o["kept"] = m.heapKept;
+#if HEAP_ALLOC_TRACKING
+      o["allocs"] = m.allocs;
+      o["bytes"] = m.allocBytes;
+#endif
+    }
+    ok = MQTTClient::publishJson(topic.c_str(), doc);
+  }
+
+  if (ok)
+    lastPublish = millis();
+}
+
+#if HEAP_ALLOC_TRACKING
+// 链接选项 -Wl,--wrap=malloc,--wrap=realloc,--wrap=calloc 把其他目标文件中
+// 对这些函数的调用转到这里（String、ArduinoJson、new 都经过 malloc）
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_calloc(size_t count, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  HeapMonitor::countAllocation(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  HeapMonitor::countAllocation(size);
+  return __real_realloc(ptr, size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  HeapMonitor::countAllocation(count * size);
+  return __real_calloc(count, size);
+}
+}
+#endif
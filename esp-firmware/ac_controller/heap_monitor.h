@@ -0,0 +1,107 @@
+/*
+ * 内存监控模块
+ *
+ * 功能：
+ * - 周期采样空闲堆、最大连续块、碎片率，记录各自的最差值
+ * - 汇总栈使用峰值：调度器按任务抽样，MQTT消息按类型逐条测量
+ * - 低内存策略：空闲堆或最大连续块低于阈值时推迟可选工作，
+ *   严重不足时拒绝大块分配；恢复时带滞回，避免反复切换
+ * - 发布 diag/heap（定时，级别变化时立即发布）
+ * - 可选（HEAP_ALLOC_TRACKING）：按消息类型统计 malloc 次数和字节数
+ *
+ * 用法：
+ *   if (!HeapMonitor::allowOptional()) return; // 低内存时跳过本次
+ *   if (!HeapMonitor::canAllocate(2048)) ...   // 大块分配前检查
+ */
+
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include "config.h"
+#include "scheduler.h"
+#include <Arduino.h>
+
+// 内存级别
+enum MemoryLevel : uint8_t {
+  MEM_OK,
+  MEM_LOW,      // 推迟可选工作
+  MEM_CRITICAL, // 另外拒绝大块分配
+  MEM_LEVEL_COUNT
+};
+
+// 堆统计
+struct HeapStats {
+  uint32_t freeHeap;      // 最近一次采样
+  uint32_t maxBlock;
+  uint8_t fragmentation;  // 碎片率（%）
+  uint32_t minFreeHeap;   // 历史最差值
+  uint32_t minMaxBlock;
+  uint8_t maxFragmentation;
+  uint16_t stackPeak;     // 所有任务和消息中的栈使用峰值（字节）
+  uint32_t samples;
+  uint32_t lowEvents;     // 进入低内存的次数
+  uint32_t deferred;      // 因低内存推迟的可选工作
+  uint32_t refused;       // 因低内存拒绝的大块分配
+};
+
+// 单个消息类型的统计
+struct MessageHeapStats {
+  const char *type;   // 消息类型（订阅管理中的命令名，字符串常量）
+  uint32_t count;     // 处理次数
+  uint16_t stackPeak; // 处理期间的栈使用峰值（字节）
+  uint32_t heapKept;  // 处理前后空闲堆减少的最大值（留存的分配）
+  uint32_t allocs;    // malloc/realloc/calloc 次数（HEAP_ALLOC_TRACKING）
+  uint32_t allocBytes;
+};
+
+class HeapMonitor {
+public:
+  // 注册采样任务
+  static void init();
+
+  // 采样并更新级别（调度器任务）
+  static void sample();
+
+  static MemoryLevel getLevel();
+  static const char *levelName(MemoryLevel level);
+
+  // 可选工作是否执行（低内存时返回 false 并计入 deferred）
+  static bool allowOptional();
+
+  // 大块分配前检查：严重不足或最大连续块放不下时返回 false
+  static bool canAllocate(size_t size);
+
+  // MQTT消息处理前后调用（type 为字符串常量），测量栈和堆的变化
+  static void beginMessage(const char *type);
+  static void endMessage();
+
+  // 分配钩子调用（HEAP_ALLOC_TRACKING）
+  static void countAllocation(size_t size);
+
+  static const HeapStats &getStats();
+  static uint8_t getMessageTypeCount();
+  static const MessageHeapStats &getMessageStats(uint8_t index);
+
+  // 发布 diag/heap
+  static void publish();
+
+private:
+  static HeapStats stats;
+  static MemoryLevel level;
+  static uint32_t lastPublish;
+  static TaskId task;
+
+  static MessageHeapStats messages[HEAP_MSG_TYPES];
+  static uint8_t messageCount;
+  static MessageHeapStats *current; // 正在处理的消息
+  static uint32_t messageFreeHeap;  // 处理前的空闲堆
+  static uint32_t allocCount;
+  static uint32_t allocBytes;
+  static uint32_t messageAllocs; // 处理前的分配计数
+  static uint32_t messageAllocBytes;
+
+  static MemoryLevel levelFor(uint32_t freeHeap, uint32_t maxBlock,
+                              uint32_t margin);
+};
+
+#endif // HEAP_MONITOR_H
@@ -2,7 +2,10 @@
  * 红外控制器模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_IR
+
 #include "ir_controller.h"
+#include "command_trace.h"
 #include "mqtt_client.h"
 #include <ArduinoJson.h>
 
@@ -12,7 +15,8 @@ IRrecv IRController::irrecv(PIN_IR_RECV, IR_RECV_BUFFER_SIZE, IR_RECV_TIMEOUT,
                             true);
 IRac IRController::ac(PIN_IR_SEND); // ✅ 新增：统一AC控制器
 decode_results IRController::results;
-void (*IRController::receiveCallback)(decode_results *) = nullptr;
+IRCapture IRController::captures[IR_CAPTURE_SLOTS];
+IRCaptureStats IRController::captureStats = {0, 0, 0, 0};
 unsigned long IRController::lastSendTime = 0; // ✅ 初始化
 
 void IRController::init() {
@@ -24,18 +28,25 @@ void IRController::init() {
   // 初始化接收器
   irrecv.enableIRIn();
 
+  // 定时检查接收缓冲区（帧结束需要 IR_RECV_TIMEOUT 的静默，轮询足够及时）
+  Scheduler::addPeriodic("ir_recv", IR_POLL_INTERVAL, handleReceive);
+
   DEBUG_PRINTLN("[红外] ✅ 红外模块就绪");
 }
 
 bool IRController::sendRaw(const char *rawDataStr) {
-  DEBUG_PRINTF("[红外] 发送原始数据: %s\n", rawDataStr);
+  return sendRaw(rawDataStr, strlen(rawDataStr));
+}
+
+bool IRController::sendRaw(const char *rawDataStr, size_t rawLength) {
+  LOG_PRINTF(DEBUG, "[红外] 发送原始数据: %.*s\n", (int)rawLength, rawDataStr);
 
   // 解析字符串
   uint16_t rawData[512]; // 最多512个时序值
-  uint16_t length = parseRawString(rawDataStr, rawData, 512);
+  uint16_t length = parseRawString(rawDataStr, rawLength, rawData, 512);
 
   if (length == 0) {
-    DEBUG_PRINTLN("[红外] ❌ 数据解析失败");
+    LOG_PRINTLN(ERROR, "[红外] ❌ 数据解析失败");
     return false;
   }
 
@@ -49,80 +60,126 @@ bool IRController::sendRaw(uint16_t *rawData, uint16_t length) {
   lastSendTime = millis();
 
   // 发送原始数据（38kHz载波）
+  CommandTrace::mark(TRACE_IR_START);
   irsend.sendRaw(rawData, length, IR_CARRIER_FREQ);
+  CommandTrace::mark(TRACE_IR_END);
 
   DEBUG_PRINTLN("[红外] ✅ 发送完成");
   return true;
 }
 
 void IRController::handleReceive() {
-  if (irrecv.decode(&results)) {
-    // ✅ 过滤自发自收的回声 (主动丢弃模式)
-    if (millis() - lastSendTime < SEND_IGNORE_WINDOW) {
-      DEBUG_PRINTLN("[红外] 🔇 忽略回声信号 (Cooling down)");
-      irrecv.resume();
-      return;
-    }
-    // 过滤重复码
-    if (results.value == 0xFFFFFFFF || results.value == 0x0) {
-      irrecv.resume();
-      return;
-    }
-
-    // 红外LED指示
-    LEDIndicator::blinkIR();
+  // irrecv 以 save_buffer 模式构造：decode() 把中断缓冲区拷贝到内部保存区后
+  // 已经重新启动接收，这里不能再调用 resume()，否则会清掉正在接收的下一帧
+  if (!irrecv.decode(&results))
+    return;
+
+  // ✅ 过滤自发自收的回声 (主动丢弃模式)
+  if (millis() - lastSendTime < SEND_IGNORE_WINDOW) {
+    DEBUG_PRINTLN("[红外] 🔇 忽略回声信号 (Cooling down)");
+    return;
+  }
+  // 过滤重复码
+  if (results.value == 0xFFFFFFFF || results.value == 0x0) {
+    return;
+  }
 
-    DEBUG_PRINTLN("[红外] 📡 收到红外信号");
-    DEBUG_PRINTF("[红外] 协议: ");
+  if (results.overflow) {
+    captureStats.overflow++;
+  }
 
-    // 打印协议类型
-    if (results.decode_type == UNKNOWN) {
-      DEBUG_PRINTLN("UNKNOWN (自定义协议)");
-    } else {
-      DEBUG_PRINTLN(typeToString(results.decode_type));
+  // 内部保存区会被下一次 decode() 覆盖，先拷贝到空闲的捕获槽
+  IRCapture *slot = nullptr;
+  uint8_t inUse = 0;
+  for (uint8_t i = 0; i < IR_CAPTURE_SLOTS; i++) {
+    if (captures[i].inUse) {
+      inUse++;
+    } else if (slot == nullptr) {
+      slot = &captures[i];
     }
+  }
 
-    DEBUG_PRINTF("[红外] 位数: %d\n", results.bits);
-    DEBUG_PRINTF("[红外] 值: 0x%llX\n", results.value);
+  if (slot == nullptr) {
+    captureStats.dropped++;
+    LOG_PRINTLN(WARN, "[红外] ⚠️ 捕获槽已满，丢弃本帧");
+    return;
+  }
 
-    // 打印原始数据（用于学习）
-    String rawStr = resultsToRawString(&results);
-    DEBUG_PRINTF("[红外] 原始数据: %s\n", rawStr.c_str());
+  slot->results = results;
+  uint16_t rawlen = min(results.rawlen, (uint16_t)IR_RECV_BUFFER_SIZE);
+  for (uint16_t i = 0; i < rawlen; i++) {
+    slot->rawbuf[i] = results.rawbuf[i];
+  }
+  slot->results.rawbuf = slot->rawbuf;
+  slot->results.rawlen = rawlen;
+  slot->inUse = true;
+
+  captureStats.captured++;
+  if (inUse + 1 > captureStats.maxInUse)
+    captureStats.maxInUse = inUse + 1;
+
+  // 红外LED指示
+  LEDIndicator::blinkIR();
+
+  DEBUG_PRINTLN("[红外] 📡 收到红外信号");
+  DEBUG_PRINTF("[红外] 协议: %s, 位数: %d, 值: 0x%llX\n",
+               results.decode_type == UNKNOWN
+                   ? "UNKNOWN (自定义协议)"
+                   : typeToString(results.decode_type).c_str(),
+               results.bits, results.value);
+
+  // 投递事件后立即返回，解析和发布由消费者在下一个调度周期完成
+  Event event;
+  memset(&event, 0, sizeof(Event));
+  event.type = EVT_IR_FRAME;
+  event.data.irFrame = &slot->results;
+
+  if (!EventBus::post(event)) {
+    // 队列满：丢弃本帧
+    slot->inUse = false;
+    captureStats.dropped++;
+  }
+}
 
-    // 触发回调（由主程序处理解析和发布）
-    if (receiveCallback != nullptr) {
-      receiveCallback(&results);
+void IRController::releaseFrame(decode_results *frame) {
+  for (uint8_t i = 0; i < IR_CAPTURE_SLOTS; i++) {
+    if (&captures[i].results == frame) {
+      captures[i].inUse = false;
+      return;
     }
-
-    // ⚠️ 移除了自动发布事件的代码，现在由主程序的 onIRReceived() 统一处理
-
-    // 准备接收下一个信号
-    irrecv.resume();
   }
 }
 
-String IRController::getLastRawData() { return resultsToRawString(&results); }
+const IRCaptureStats &IRController::getCaptureStats() { return captureStats; }
 
-void IRController::setReceiveCallback(void (*callback)(decode_results *)) {
-  receiveCallback = callback;
+String IRController::getRawData(const decode_results *results) {
+  return resultsToRawString(results);
 }
 
-uint16_t IRController::parseRawString(const char *str, uint16_t *buffer,
-                                      uint16_t maxLen) {
+uint16_t IRController::parseRawString(const char *str, size_t length,
+                                      uint16_t *buffer, uint16_t maxLen) {
+  // 逐字符累加，不复制字符串（str 可以是命令JSON中的视图）
   uint16_t count = 0;
-  char *strCopy = strdup(str);
-  char *token = strtok(strCopy, ",");
-
-  while (token != nullptr && count < maxLen) {
-    buffer[count++] = atoi(token);
-    token = strtok(nullptr, ",");
+  uint32_t value = 0;
+  bool digits = false;
+
+  for (size_t i = 0; i <= length && count < maxLen; i++) {
+    char c = i < length ? str[i] : ',';
+    if (c >= '0' && c <= '9') {
+      value = min(value * 10 + (c - '0'), (uint32_t)0xFFFF);
+      digits = true;
+    } else if (c == ',') {
+      if (digits) {
+        buffer[count++] = value;
+      }
+      value = 0;
+      digits = false;
+    }
   }
-
-  free(strCopy);
   return count;
 }
 
-String IRController::resultsToRawString(decode_results *results) {
+String IRController::resultsToRawString(const decode_results *results) {
   String rawStr = "";
 
   // 将rawbuf转换为逗号分隔的字符串
@@ -137,9 +194,8 @@ String IRController::resultsToRawString(decode_results *results) {
 
 // ===== ✅ 新增：品牌协议支持 =====
 
-bool IRController::sendBrand(const char *brand, int model, bool power,
-                             const char *mode, uint8_t temp, uint8_t fanSpeed,
-                             bool swingV, bool swingH) {
+bool IRController::sendBrand(const char *brand, int model,
+                             const ACState &acState) {
   DEBUG_PRINTF("[红外] 发送品牌协议: %s (型号: %d)\n", brand, model);
 
   // ✅ 记录发送时间，防止收到回声
@@ -148,67 +204,29 @@ bool IRController::sendBrand(const char *brand, int model, bool power,
   // 1. 转换品牌字符串为协议类型
   decode_type_t protocol = stringToProtocol(brand);
   if (protocol == decode_type_t::UNKNOWN) {
-    DEBUG_PRINTLN("[红外] ❌ 不支持的品牌");
+    LOG_PRINTLN(ERROR, "[红外] ❌ 不支持的品牌");
     return false;
   }
 
-  // 2. 构建空调状态
+  // 2. 构建空调状态（模式、风速、摆风按 ac_state.h 的转换表）
   stdAc::state_t state;
   state.protocol = protocol;
   state.model = model;
-  state.power = power;
-
-  // 3. 转换模式
-  if (strcmp(mode, "cool") == 0) {
-    state.mode = stdAc::opmode_t::kCool;
-  } else if (strcmp(mode, "heat") == 0) {
-    state.mode = stdAc::opmode_t::kHeat;
-  } else if (strcmp(mode, "dry") == 0) {
-    state.mode = stdAc::opmode_t::kDry;
-  } else if (strcmp(mode, "fan") == 0 || strcmp(mode, "fan_only") == 0) {
-    state.mode = stdAc::opmode_t::kFan;
-  } else {
-    state.mode = stdAc::opmode_t::kAuto;
-  }
-
-  // 4. 设置温度和风速
-  state.degrees = temp;
-
-  switch (fanSpeed) {
-  case 1:
-    state.fanspeed = stdAc::fanspeed_t::kMin;
-    break;
-  case 2:
-    state.fanspeed = stdAc::fanspeed_t::kLow;
-    break;
-  case 3:
-    state.fanspeed = stdAc::fanspeed_t::kMedium;
-    break;
-  case 4:
-    state.fanspeed = stdAc::fanspeed_t::kHigh;
-    break;
-  case 5:
-    state.fanspeed = stdAc::fanspeed_t::kMax;
-    break;
-  default:
-    state.fanspeed = stdAc::fanspeed_t::kAuto;
-    break;
-  }
-
-  // 5. 设置摆风
-  state.swingv = swingV ? stdAc::swingv_t::kAuto : stdAc::swingv_t::kOff;
-  state.swingh = swingH ? stdAc::swingh_t::kAuto : stdAc::swingh_t::kOff;
+  acStateToStdAc(acState, state);
 
-  // 6. 发送
-  DEBUG_PRINTF("[红外] 参数: Power=%d, Mode=%d, Temp=%d, Fan=%d\n", power,
-               state.mode, temp, fanSpeed);
+  // 3. 发送
+  DEBUG_PRINTF("[红外] 参数: Power=%d, Mode=%s, Temp=%d, Fan=%d\n",
+               acState.power, acModeName(acState.mode), acState.temp,
+               acState.fan);
 
+  CommandTrace::mark(TRACE_IR_START);
   bool success = ac.sendAc(state);
+  CommandTrace::mark(TRACE_IR_END);
 
   if (success) {
     DEBUG_PRINTLN("[红外] ✅ 品牌协议发送成功");
   } else {
-    DEBUG_PRINTLN("[红外] ❌ 品牌协议发送失败");
+    LOG_PRINTLN(ERROR, "[红外] ❌ 品牌协议发送失败");
   }
 
   return success;
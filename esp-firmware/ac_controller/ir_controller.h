@@ -10,8 +10,11 @@
 #ifndef IR_CONTROLLER_H
 #define IR_CONTROLLER_H
 
+#include "ac_state.h"
 #include "config.h"
+#include "event_bus.h"
 #include "led_indicator.h"
+#include "scheduler.h"
 #include <Arduino.h>
 #include <IRac.h> // ✅ 新增：品牌协议统一接口
 #include <IRrecv.h>
@@ -19,6 +22,21 @@
 #include <IRsend.h>
 #include <IRutils.h>
 
+// 捕获槽：decode_results 及其原始时序的独立副本
+struct IRCapture {
+  decode_results results; // results.rawbuf 指向下面的 rawbuf
+  uint16_t rawbuf[IR_RECV_BUFFER_SIZE];
+  bool inUse; // 已投递，等待消费者释放
+};
+
+// 捕获统计
+struct IRCaptureStats {
+  uint32_t captured; // 成功捕获的帧
+  uint32_t dropped;  // 捕获槽或事件队列满而丢弃的帧
+  uint32_t overflow; // 接收缓冲区溢出的帧
+  uint8_t maxInUse;  // 同时占用的捕获槽峰值
+};
+
 class IRController {
 public:
   // 初始化红外模块
@@ -26,28 +44,26 @@ public:
 
   // 发送原始时序数据（学习模式核心）
   static bool sendRaw(const char *rawDataStr);
+  static bool sendRaw(const char *rawDataStr, size_t length); // 不要求 '\0' 结尾
   static bool sendRaw(uint16_t *rawData, uint16_t length);
 
   // ✅ 新增：发送品牌协议
-  static bool
-  sendBrand(const char *brand, // 品牌："GREE", "MIDEA", "DAIKIN" 等
-            int model,         // 型号代码
-            bool power,        // 开关
-            const char *mode,  // 模式："cool", "heat", "dry", "fan", "auto"
-            uint8_t temp,      // 温度 (16-30)
-            uint8_t fanSpeed,  // 风速 (0=auto, 1=low, 2=mid, 3=high)
-            bool swingV,       // 垂直摆风
-            bool swingH        // 水平摆风
-  );
-
-  // 处理红外接收（在loop中调用）
+  static bool sendBrand(const char *brand, // 品牌："GREE", "MIDEA", "DAIKIN" 等
+                        int model,         // 型号代码
+                        const ACState &state);
+
+  // 处理红外接收（调度器周期任务），收到的帧拷贝到捕获槽后以
+  // EVT_IR_FRAME 事件投递
   static void handleReceive();
 
-  // 获取最后接收到的原始数据
-  static String getLastRawData();
+  // 消费者处理完 EVT_IR_FRAME 后调用，释放捕获槽
+  static void releaseFrame(decode_results *frame);
+
+  // 获取原始时序字符串（"9000,4500,560,..."）
+  static String getRawData(const decode_results *results);
 
-  // 设置接收回调
-  static void setReceiveCallback(void (*callback)(decode_results *));
+  // 捕获统计
+  static const IRCaptureStats &getCaptureStats();
 
   // ✅ 新增：获取支持的品牌列表JSON
   static String getSupportedBrandsJSON();
@@ -56,15 +72,16 @@ private:
   static IRsend irsend;
   static IRrecv irrecv;
   static IRac ac; // ✅ 新增：统一AC控制器
-  static decode_results results;
-  static void (*receiveCallback)(decode_results *);
+  static decode_results results; // decode() 输出，指向库内部保存区
+  static IRCapture captures[IR_CAPTURE_SLOTS];
+  static IRCaptureStats captureStats;
 
   // 解析原始数据字符串（"9000,4500,560,..."）
-  static uint16_t parseRawString(const char *str, uint16_t *buffer,
-                                 uint16_t maxLen);
+  static uint16_t parseRawString(const char *str, size_t length,
+                                 uint16_t *buffer, uint16_t maxLen);
 
   // 将decode_results转换为字符串
-  static String resultsToRawString(decode_results *results);
+  static String resultsToRawString(const decode_results *results);
 
   // ✅ 新增：品牌字符串转协议类型
   static decode_type_t stringToProtocol(const char *brand);
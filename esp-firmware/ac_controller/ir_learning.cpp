@@ -2,8 +2,12 @@
  * 红外学习模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_IR
+
 #include "ir_learning.h"
+#include "ir_transfer.h"
 #include "led_indicator.h"
+#include "message_arena.h"
 #include "mqtt_client.h"
 #include <ArduinoJson.h>
 
@@ -11,14 +15,19 @@
 // 静态成员初始化
 bool IRLearning::learning = false;
 char IRLearning::learningKey[32] = {0};
-unsigned long IRLearning::learningStartTime = 0;
+TaskId IRLearning::timeoutTask = SCHED_INVALID_TASK;
 
 void IRLearning::start(const char *key) {
   DEBUG_PRINTF("[学习] 启动学习模式: %s\n", key);
 
   learning = true;
   strncpy(learningKey, key, sizeof(learningKey) - 1);
-  learningStartTime = millis();
+
+  // 超时截止时间（30秒）
+  if (timeoutTask == SCHED_INVALID_TASK) {
+    timeoutTask = Scheduler::addOneShot("learn_timeout", onTimeout);
+  }
+  Scheduler::schedule(timeoutTask, IR_LEARNING_TIMEOUT);
 
   // LED指示进入学习模式（快闪）
   LEDIndicator::setStatus(STATUS_MQTT_CONNECTING); // 复用快闪状态
@@ -30,22 +39,20 @@ void IRLearning::stop() {
   if (learning) {
     DEBUG_PRINTLN("[学习] 退出学习模式");
     learning = false;
+    Scheduler::cancel(timeoutTask);
     LEDIndicator::setStatus(STATUS_READY);
   }
 }
 
 bool IRLearning::isLearning() { return learning; }
 
-void IRLearning::update() {
+void IRLearning::onTimeout() {
   if (!learning)
     return;
 
-  // 检查超时（30秒）
-  if (millis() - learningStartTime > IR_LEARNING_TIMEOUT) {
-    DEBUG_PRINTLN("[学习] ❌ 学习超时");
-    publishTimeout();
-    stop();
-  }
+  LOG_PRINTLN(ERROR, "[学习] ❌ 学习超时");
+  publishTimeout();
+  stop();
 }
 
 void IRLearning::onIRReceived(decode_results *results) {
@@ -55,7 +62,7 @@ void IRLearning::onIRReceived(decode_results *results) {
   DEBUG_PRINTLN("[学习] ✅ 捕获到红外信号");
 
   // 获取原始数据
-  String rawData = IRController::getLastRawData();
+  String rawData = IRController::getRawData(results);
 
   DEBUG_PRINTF("[学习] 原始数据长度: %d\n", rawData.length());
   DEBUG_PRINTF("[学习] 数据: %s\n", rawData.c_str());
@@ -69,26 +76,34 @@ void IRLearning::onIRReceived(decode_results *results) {
 
 void IRLearning::publishResult(const char *rawData) {
   if (!MQTTClient::isConnected()) {
-    DEBUG_PRINTLN("[学习] ⚠️  MQTT未连接，无法发布结果");
+    LOG_PRINTLN(WARN, "[学习] ⚠️  MQTT未连接，无法发布结果");
+    return;
+  }
+
+  // 长帧超过单条消息容量，分片发布到 learn/result/chunk（见 ir_transfer.h）
+  if (strlen(rawData) > IR_CHUNK_SIZE) {
+    if (IRTransfer::publish("learn/result/chunk", learningKey, rawData)) {
+      DEBUG_PRINTLN("[学习] ✅ 学习结果已分片发布");
+    } else {
+      LOG_PRINTLN(ERROR, "[学习] ❌ 学习结果发布失败");
+    }
     return;
   }
 
   // 构建JSON消息
-  StaticJsonDocument<1024> doc;
+  // raw 只保存指针，序列化时直接从学习缓冲区读取
+  ArenaJsonDocument doc(128);
   doc["key"] = learningKey;
   doc["raw"] = rawData;
   doc["success"] = true;
   doc["timestamp"] = millis() / 1000;
 
-  char payload[1024];
-  serializeJson(doc, payload);
-
   // 发布到MQTT
   String topic = MQTTClient::getTopic("learn/result");
-  if (MQTTClient::publish(topic.c_str(), payload)) {
+  if (MQTTClient::publishJson(topic.c_str(), doc)) {
     DEBUG_PRINTLN("[学习] ✅ 学习结果已发布");
   } else {
-    DEBUG_PRINTLN("[学习] ❌ 学习结果发布失败");
+    LOG_PRINTLN(ERROR, "[学习] ❌ 学习结果发布失败");
   }
 }
 
@@ -97,15 +112,12 @@ void IRLearning::publishTimeout() {
     return;
 
   // 构建超时消息
-  StaticJsonDocument<256> doc;
+  ArenaJsonDocument doc(128);
   doc["key"] = learningKey;
   doc["success"] = false;
   doc["error"] = "timeout";
 
-  char payload[256];
-  serializeJson(doc, payload);
-
   // 发布到MQTT
   String topic = MQTTClient::getTopic("learn/result");
-  MQTTClient::publish(topic.c_str(), payload);
+  MQTTClient::publishJson(topic.c_str(), doc);
 }
@@ -13,6 +13,7 @@
 
 #include "config.h"
 #include "ir_controller.h"
+#include "scheduler.h"
 #include <Arduino.h>
 
 
@@ -27,16 +28,16 @@ public:
   // 检查是否在学习模式
   static bool isLearning();
 
-  // 更新学习状态（在loop中调用）
-  static void update();
-
   // 处理接收到的红外数据（由IRController回调）
   static void onIRReceived(decode_results *results);
 
 private:
   static bool learning;
   static char learningKey[32];
-  static unsigned long learningStartTime;
+  static TaskId timeoutTask;
+
+  // 学习超时（单次任务）
+  static void onTimeout();
 
   // 发布学习结果
   static void publishResult(const char *rawData);
@@ -0,0 +1,285 @@
+/*
+ * 红外数据分片传输模块 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_IR
+
+#include "ir_transfer.h"
+#include "checksum.h"
+#include "heap_monitor.h"
+#include "ir_controller.h"
+#include "message_arena.h"
+#include "mqtt_client.h"
+#include <ArduinoJson.h>
+
+// 帧分隔标记（有效时序值不会为0）
+#define FRAME_BREAK 0
+
+// 静态成员初始化
+uint16_t *IRTransfer::timings = nullptr;
+uint16_t IRTransfer::timingCount = 0;
+uint16_t IRTransfer::rxId = 0;
+uint16_t IRTransfer::rxNext = 0;
+uint16_t IRTransfer::rxTotal = 0;
+uint32_t IRTransfer::rxCrc = 0;
+uint32_t IRTransfer::rxCrcCalc = 0;
+uint32_t IRTransfer::pending = 0;
+bool IRTransfer::pendingDigits = false;
+bool IRTransfer::sending = false;
+uint16_t IRTransfer::sendPos = 0;
+uint8_t IRTransfer::framesSent = 0;
+TaskId IRTransfer::task = SCHED_INVALID_TASK;
+uint16_t IRTransfer::txId = 0;
+IRTransferStats IRTransfer::stats = {0, 0, 0, 0};
+
+void IRTransfer::handleChunk(char *json) {
+  StaticJsonDocument<192> doc;
+  if (deserializeJson(doc, json)) {
+    LOG_PRINTLN(ERROR, "[分片] ❌ JSON解析失败");
+    return;
+  }
+
+  uint16_t id = doc["id"] | 0;
+  uint16_t index = doc["index"] | 0;
+  const char *data = doc["data"] | "";
+  stats.chunksIn++;
+
+  if (index == 0 && timings != nullptr && id == rxId) {
+    return; // 重发的首个分片
+  }
+
+  if (index == 0) {
+    // 新传输：放弃未完成的旧传输
+    if (timings != nullptr) {
+      LOG_PRINTF(WARN, "[分片] ⚠️ 传输 %u 未完成，被传输 %u 取代\n", rxId, id);
+      finish(false, "superseded", 0);
+    }
+
+    rxTotal = doc["total"] | 0;
+    if (rxTotal == 0 || !doc.containsKey("crc")) {
+      rxId = id;
+      finish(false, "format", 0);
+      return;
+    }
+
+    // 内存严重不足时不开始新传输（暂存区占用2KB）
+    size_t bufferSize = IR_CHUNK_MAX_TIMINGS * sizeof(uint16_t);
+    if (HeapMonitor::canAllocate(bufferSize)) {
+      timings = (uint16_t *)malloc(bufferSize);
+    }
+    if (timings == nullptr) {
+      rxId = id;
+      finish(false, "memory", 0);
+      return;
+    }
+    rxId = id;
+    rxNext = 0;
+    rxCrc = doc["crc"].as<uint32_t>();
+    rxCrcCalc = 0;
+    timingCount = 0;
+    pending = 0;
+    pendingDigits = false;
+
+    if (task == SCHED_INVALID_TASK) {
+      task = Scheduler::addOneShot("ir_chunk", onTask);
+    }
+    DEBUG_PRINTF("[分片] 开始接收传输 %u (%u 片)\n", rxId, rxTotal);
+  } else if (timings == nullptr || id != rxId) {
+    // 已放弃或未开始的传输，后续分片直接丢弃
+    DEBUG_PRINTF("[分片] 忽略传输 %u 的分片 %u\n", id, index);
+    return;
+  }
+
+  if (index < rxNext) {
+    return; // 重发的分片
+  }
+  if (index != rxNext || index >= rxTotal) {
+    LOG_PRINTF(ERROR, "[分片] ❌ 分片乱序: 期望 %u，收到 %u\n", rxNext, index);
+    finish(false, "order", 0);
+    return;
+  }
+
+  rxCrcCalc = Checksum::crc32(data, strlen(data), rxCrcCalc);
+  const char *error = append(data);
+  if (error != nullptr) {
+    finish(false, error, 0);
+    return;
+  }
+  rxNext++;
+
+  if (rxNext < rxTotal) {
+    Scheduler::schedule(task, IR_CHUNK_TIMEOUT);
+    return;
+  }
+
+  // 最后一片：收尾数值并校验
+  if (pendingDigits) {
+    error = pending == 0 ? "format" : push(pending);
+    if (error != nullptr) {
+      finish(false, error, 0);
+      return;
+    }
+  }
+  if (rxCrcCalc != rxCrc) {
+    LOG_PRINTF(ERROR, "[分片] ❌ CRC不匹配: %08X != %08X\n", rxCrcCalc, rxCrc);
+    finish(false, "crc", 0);
+    return;
+  }
+
+  // 逐帧发送：暂存区保留到最后一帧发出
+  sending = true;
+  sendPos = 0;
+  framesSent = 0;
+  Scheduler::schedule(task, 0);
+}
+
+const char *IRTransfer::append(const char *data) {
+  for (const char *p = data; *p != '\0'; p++) {
+    char c = *p;
+    if (c >= '0' && c <= '9') {
+      pending = pending * 10 + (c - '0');
+      if (pending > 0xFFFF) {
+        return "format";
+      }
+      pendingDigits = true;
+    } else if (c == ',' || c == ';') {
+      if (pendingDigits) {
+        if (pending == 0) {
+          return "format"; // 时序值不能为0
+        }
+        const char *error = push(pending);
+        if (error != nullptr) {
+          return error;
+        }
+        pending = 0;
+        pendingDigits = false;
+      }
+      if (c == ';' && timingCount > 0 &&
+          timings[timingCount - 1] != FRAME_BREAK) {
+        const char *error = push(FRAME_BREAK);
+        if (error != nullptr) {
+          return error;
+        }
+      }
+    } else if (c != ' ') {
+      return "format";
+    }
+  }
+  return nullptr;
+}
+
+const char *IRTransfer::push(uint16_t value) {
+  if (timingCount >= IR_CHUNK_MAX_TIMINGS) {
+    return "overflow";
+  }
+  timings[timingCount++] = value;
+  return nullptr;
+}
+
+void IRTransfer::sendFrame() {
+  // sendPos 总是指向一帧的开头（暂存区不以帧分隔标记开头）
+  if (sendPos < timingCount) {
+    uint16_t end = sendPos;
+    while (end < timingCount && timings[end] != FRAME_BREAK) {
+      end++;
+    }
+    IRController::sendRaw(timings + sendPos, end - sendPos);
+    framesSent++;
+
+    // 跳过帧分隔标记
+    sendPos = end;
+    while (sendPos < timingCount && timings[sendPos] == FRAME_BREAK) {
+      sendPos++;
+    }
+  }
+
+  if (sendPos < timingCount) {
+    Scheduler::schedule(task, IR_FRAME_GAP);
+    return;
+  }
+  finish(framesSent > 0, framesSent > 0 ? nullptr : "empty", framesSent);
+}
+
+void IRTransfer::finish(bool ok, const char *error, uint8_t frames) {
+  uint16_t count = timingCount;
+
+  Scheduler::cancel(task);
+  sending = false;
+  free(timings);
+  timings = nullptr;
+  timingCount = 0;
+
+  if (ok) {
+    stats.completed++;
+    DEBUG_PRINTF("[分片] ✅ 传输 %u 完成: %u 个时序值，%u 帧\n", rxId, count,
+                 frames);
+  } else {
+    stats.failed++;
+    LOG_PRINTF(ERROR, "[分片] ❌ 传输 %u 失败: %s\n", rxId, error);
+  }
+
+  ArenaJsonDocument doc(128);
+  doc["id"] = rxId;
+  doc["ok"] = ok;
+  if (ok) {
+    doc["timings"] = count;
+    doc["frames"] = frames;
+  } else {
+    doc["error"] = error;
+  }
+
+  String topic = MQTTClient::getTopic("ir/chunk/result");
+  MQTTClient::publishJson(topic.c_str(), doc);
+}
+
+void IRTransfer::onTask() {
+  if (timings == nullptr)
+    return;
+  if (sending) {
+    sendFrame();
+    return;
+  }
+
+  LOG_PRINTF(ERROR, "[分片] ❌ 传输 %u 超时 (已收 %u/%u)\n", rxId, rxNext, rxTotal);
+  finish(false, "timeout", 0);
+}
+
+bool IRTransfer::publish(const char *suffix, const char *key,
+                         const char *data) {
+  size_t length = strlen(data);
+  uint16_t total = (length + IR_CHUNK_SIZE - 1) / IR_CHUNK_SIZE;
+  uint32_t crc = Checksum::crc32(data, length);
+  uint16_t id = ++txId;
+  String topic = MQTTClient::getTopic(suffix);
+
+  DEBUG_PRINTF("[分片] 发布传输 %u: %u 字节，%u 片\n", id, length, total);
+
+  char slice[IR_CHUNK_SIZE + 1];
+  for (uint16_t index = 0; index < total; index++) {
+    size_t offset = (size_t)index * IR_CHUNK_SIZE;
+    size_t n = min((size_t)IR_CHUNK_SIZE, length - offset);
+    memcpy(slice, data + offset, n);
+    slice[n] = '\0';
+
+    ArenaJsonDocument doc(192);
+    doc["id"] = id;
+    if (key != nullptr) {
+      doc["key"] = key;
+    }
+    doc["index"] = index;
+    doc["total"] = total;
+    if (index == 0) {
+      doc["crc"] = crc;
+    }
+    doc["data"] = (const char *)slice; // 只保存指针，不复制到文档
+
+    // 直接序列化到发送缓冲区，不拼接整条消息
+    if (!MQTTClient::publishJson(topic.c_str(), doc)) {
+      return false;
+    }
+    stats.chunksOut++;
+  }
+  return true;
+}
+
+const IRTransferStats &IRTransfer::getStats() { return stats; }
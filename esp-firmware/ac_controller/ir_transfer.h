@@ -0,0 +1,78 @@
+/*
+ * 红外数据分片传输模块
+ *
+ * 功能：
+ * - 超长原始码（空调长帧、多帧场景）拆成多条MQTT消息收发，
+ *   不需要扩大 MQTT_BUFFER_SIZE 和各处固定大小的JSON文档
+ * - 接收：按顺序重组到有上限的暂存区，CRC校验通过后调用
+ *   IRController::sendRaw 发送；多帧时由调度任务每次发送一帧，
+ *   帧间隔 IR_FRAME_GAP 期间主循环照常运行
+ * - 发送：学习结果超过 IR_CHUNK_SIZE 时分片发布
+ *
+ * 分片格式（两个方向相同）：
+ *   {"id":7,"index":0,"total":3,"crc":305419896,"data":"9000,4500,560,..."}
+ * - id：传输编号，index 从0开始，total 为分片总数
+ * - crc：完整数据（所有 data 拼接后）的CRC-32，index=0 时必须携带
+ * - data：逗号分隔的时序值；多帧场景用 ';' 分隔各帧
+ *
+ * 接收结果发布到 ir/chunk/result：
+ *   {"id":7,"ok":true,"timings":620,"frames":2}
+ *   {"id":7,"ok":false,"error":"crc"}
+ */
+
+#ifndef IR_TRANSFER_H
+#define IR_TRANSFER_H
+
+#include "config.h"
+#include "scheduler.h"
+#include <Arduino.h>
+
+// 分片传输统计
+struct IRTransferStats {
+  uint32_t chunksIn;  // 收到的分片
+  uint32_t chunksOut; // 发布的分片
+  uint32_t completed; // 重组并发送成功的传输
+  uint32_t failed;    // 校验失败、乱序、超长或超时放弃的传输
+};
+
+class IRTransfer {
+public:
+  // 处理 ir/chunk 消息（json 原地解析，内容会被修改）
+  static void handleChunk(char *json);
+
+  // 分片发布（key 可为 nullptr），返回是否全部发布成功
+  static bool publish(const char *suffix, const char *key, const char *data);
+
+  static const IRTransferStats &getStats();
+
+private:
+  // 接收中的传输（暂存区只在传输期间分配）
+  static uint16_t *timings;
+  static uint16_t timingCount;
+  static uint16_t rxId;
+  static uint16_t rxNext;  // 期望的下一个分片序号
+  static uint16_t rxTotal;
+  static uint32_t rxCrc;      // 发送方声明的CRC
+  static uint32_t rxCrcCalc;  // 已收数据的CRC（分段累加）
+  static uint32_t pending;    // 跨分片的未完成数值
+  static bool pendingDigits;
+  static bool sending;        // 正在逐帧发送（接收已完成）
+  static uint16_t sendPos;    // 下一帧在暂存区中的位置
+  static uint8_t framesSent;
+  static TaskId task;         // 接收时为分片超时，发送时为帧间隔
+
+  static uint16_t txId;
+  static IRTransferStats stats;
+
+  // 解析一段数据追加到暂存区，格式错误或超长返回错误原因
+  static const char *append(const char *data);
+  static const char *push(uint16_t value);
+
+  // 发送暂存区中的下一帧，还有帧时间隔 IR_FRAME_GAP 后继续，全部发送后结束传输
+  static void sendFrame();
+
+  static void finish(bool ok, const char *error, uint8_t frames);
+  static void onTask();
+};
+
+#endif // IR_TRANSFER_H
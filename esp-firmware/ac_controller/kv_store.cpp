@@ -0,0 +1,487 @@
+/*
+ * 日志式键值存储 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_SYS
+
+#include "kv_store.h"
+#include "checksum.h"
+#include <flash_hal.h>
+
+static const uint32_t KV_MAGIC = 0x314A564B; // "KVJ1"
+static const uint8_t KV_KEY_COMMIT = 0xFE;    // 事务提交标记
+static const uint8_t KV_FLAG_TXN = 0x01;      // 事务成员，见到提交标记才生效
+static const uint32_t KV_HEADER_SIZE = 8;     // 扇区头和记录头都是8字节
+
+// Flash读写中转缓冲区（地址和长度需4字节对齐）
+static uint32_t scratch[64];
+
+// 静态成员初始化
+uint32_t KVStore::baseAddress = 0;
+uint8_t KVStore::headSector = 0;
+uint32_t KVStore::headSeq = 0;
+uint32_t KVStore::writeOffset = 0;
+bool KVStore::mounted = false;
+bool KVStore::fresh = false;
+bool KVStore::readOnly = false;
+uint32_t KVStore::index[KV_KEY_COUNT] = {};
+uint16_t KVStore::lengths[KV_KEY_COUNT] = {};
+uint32_t KVStore::txnBuffer[KV_TXN_BUFFER_SIZE / 4];
+uint16_t KVStore::txnLength = 0;
+uint8_t KVStore::txnRecords = 0;
+bool KVStore::inTransaction = false;
+KVStats KVStore::stats = {0, 0, 0, 0, 0, 0};
+
+static_assert(KV_TXN_BUFFER_SIZE % 4 == 0, "事务缓冲区需4字节对齐");
+
+bool KVStore::init() {
+  DEBUG_PRINTLN("[存储] 挂载日志式键值存储");
+
+  uint32_t required = KV_SECTOR_COUNT * KV_SECTOR_SIZE;
+  if (FS_PHYS_SIZE < required) {
+    LOG_PRINTF(ERROR, "[存储] ❌ FS分区不足 %u 字节，请在编译选项中分配文件系统\n",
+               required);
+    return false;
+  }
+
+  // 日志占用FS分区末尾的扇区（固件未使用文件系统）
+  baseAddress = FS_PHYS_ADDR + FS_PHYS_SIZE - required;
+
+  mounted = false;
+  fresh = false;
+  readOnly = false;
+  inTransaction = false;
+
+  if (!replay()) {
+    DEBUG_PRINTLN("[存储] 未找到日志，创建新日志");
+    if (!formatSector(0, 1)) {
+      LOG_PRINTLN(ERROR, "[存储] ❌ 格式化失败");
+      return false;
+    }
+    headSector = 0;
+    headSeq = 1;
+    writeOffset = KV_HEADER_SIZE;
+    fresh = true;
+  }
+
+  mounted = true;
+
+  // 上次回收中途掉电时，当前扇区之后的扇区仍未擦除，补做回收；
+  // 仍然失败时没有可切换的空闲扇区，只读挂载，避免覆盖仍有效的记录
+  uint32_t seq;
+  uint8_t after = (headSector + 1) % KV_SECTOR_COUNT;
+  if (readSectorHeader(after, seq) && !reclaim(after)) {
+    readOnly = true;
+    LOG_PRINTLN(ERROR, "[存储] ❌ 恢复回收失败，以只读方式挂载");
+  }
+
+  DEBUG_PRINTF("[存储] ✅ 挂载完成 (扇区:%d, 序号:%u, 偏移:%u)\n", headSector,
+               headSeq, writeOffset);
+  return true;
+}
+
+bool KVStore::replay() {
+  memset(index, 0, sizeof(index));
+  memset(lengths, 0, sizeof(lengths));
+
+  // 按序号从旧到新重放所有有效扇区
+  uint32_t lastSeq = 0;
+  bool found = false;
+  while (true) {
+    int8_t next = -1;
+    uint32_t nextSeq = 0;
+    for (uint8_t i = 0; i < KV_SECTOR_COUNT; i++) {
+      uint32_t seq;
+      if (readSectorHeader(i, seq) && seq > lastSeq &&
+          (next < 0 || seq < nextSeq)) {
+        next = i;
+        nextSeq = seq;
+      }
+    }
+    if (next < 0)
+      break;
+
+    // 先把上一个扇区当作非当前扇区处理，最后一个才是写入扇区
+    if (found)
+      replaySector(headSector, false);
+    headSector = next;
+    headSeq = nextSeq;
+    lastSeq = nextSeq;
+    found = true;
+  }
+
+  if (found)
+    replaySector(headSector, true);
+  return found;
+}
+
+bool KVStore::isFresh() { return fresh; }
+
+bool KVStore::isReadOnly() { return readOnly; }
+
+int KVStore::get(uint8_t key, void *data, size_t maxLen) {
+  if (!mounted || key >= KV_KEY_COUNT || index[key] == 0)
+    return -1;
+
+  size_t n = min((size_t)lengths[key], maxLen);
+  if (!readBytes(index[key] + KV_HEADER_SIZE, data, n))
+    return -1;
+  return lengths[key];
+}
+
+bool KVStore::put(uint8_t key, const void *data, size_t length) {
+  if (!mounted || readOnly || key >= KV_KEY_COUNT || length > 0xFFFF)
+    return false;
+
+  if (equals(key, data, length)) {
+    stats.skipped++;
+    return true;
+  }
+
+  if (inTransaction)
+    return stage(key, data, length);
+
+  beginTransaction();
+  if (!stage(key, data, length)) {
+    inTransaction = false;
+    return false;
+  }
+  return commit();
+}
+
+void KVStore::beginTransaction() {
+  inTransaction = true;
+  txnLength = 0;
+  txnRecords = 0;
+}
+
+bool KVStore::commit() {
+  if (!inTransaction)
+    return true;
+  inTransaction = false;
+
+  if (txnRecords == 0)
+    return true; // 所有值都没变化
+
+  uint8_t *buf = (uint8_t *)txnBuffer;
+
+  // 多条记录：标记为事务成员并追加提交标记，重放时缺少标记则整体丢弃
+  if (txnRecords > 1) {
+    RecordHeader marker = {KV_KEY_COMMIT, 0, 0, 0};
+    marker.crc = recordCrc(marker, nullptr);
+    memcpy(buf + txnLength, &marker, KV_HEADER_SIZE);
+  }
+
+  for (uint16_t off = 0; off < txnLength;) {
+    RecordHeader *h = (RecordHeader *)(buf + off);
+    if (txnRecords > 1)
+      h->flags |= KV_FLAG_TXN;
+    h->crc = recordCrc(*h, buf + off + KV_HEADER_SIZE);
+    off += KV_HEADER_SIZE + align4(h->length);
+  }
+
+  uint32_t total = txnLength + (txnRecords > 1 ? KV_HEADER_SIZE : 0);
+
+  // 写入扇区（空间不足时切换扇区并回收）；回收搬入的记录占用新扇区，
+  // 切换后需要重新检查
+  if (writeOffset + total > KV_SECTOR_SIZE &&
+      (!advance() || writeOffset + total > KV_SECTOR_SIZE)) {
+    LOG_PRINTLN(ERROR, "[存储] ❌ 无法分配空间");
+    return false;
+  }
+
+  uint32_t start = sectorAddress(headSector) + writeOffset;
+  if (!ESP.flashWrite(start, txnBuffer, total)) {
+    LOG_PRINTLN(ERROR, "[存储] ❌ Flash写入失败");
+    // 这段空间可能已被部分写入，放弃当前扇区剩余空间
+    writeOffset = KV_SECTOR_SIZE;
+    return false;
+  }
+  writeOffset += total;
+
+  // 更新内存索引
+  for (uint16_t off = 0; off < txnLength;) {
+    RecordHeader *h = (RecordHeader *)(buf + off);
+    index[h->key] = start + off;
+    lengths[h->key] = h->length;
+    off += KV_HEADER_SIZE + align4(h->length);
+  }
+
+  stats.writes++;
+  stats.bytes += total;
+  DEBUG_PRINTF("[存储] ✅ 已提交 %d 条记录 (%u 字节)\n", txnRecords, total);
+  return true;
+}
+
+const KVStats &KVStore::getStats() { return stats; }
+
+void KVStore::printStats() {
+  DEBUG_PRINTF("[存储] 写入:%u 次/%u 字节, 跳过:%u, 擦除:%u, 回收搬移:%u, "
+               "损坏:%u\n",
+               stats.writes, stats.bytes, stats.skipped, stats.erases,
+               stats.gcMoves, stats.crcFails);
+}
+
+// ===== 内部实现 =====
+
+uint32_t KVStore::sectorAddress(uint8_t sector) {
+  return baseAddress + sector * KV_SECTOR_SIZE;
+}
+
+bool KVStore::readSectorHeader(uint8_t sector, uint32_t &seq) {
+  uint32_t header[2];
+  if (!ESP.flashRead(sectorAddress(sector), header, sizeof(header)))
+    return false;
+  if (header[0] != KV_MAGIC || header[1] == 0xFFFFFFFF)
+    return false;
+  seq = header[1];
+  return true;
+}
+
+bool KVStore::formatSector(uint8_t sector, uint32_t seq) {
+  uint32_t address = sectorAddress(sector);
+  if (!ESP.flashEraseSector(address / KV_SECTOR_SIZE))
+    return false;
+  stats.erases++;
+
+  uint32_t header[2] = {KV_MAGIC, seq};
+  return ESP.flashWrite(address, header, sizeof(header));
+}
+
+void KVStore::replaySector(uint8_t sector, bool isHead) {
+  uint32_t start = sectorAddress(sector);
+  uint32_t end = start + KV_SECTOR_SIZE;
+  uint32_t addr = start + KV_HEADER_SIZE;
+
+  // 事务成员先暂存，见到提交标记才写入索引
+  uint8_t stagedKeys[KV_KEY_COUNT];
+  uint32_t stagedAddr[KV_KEY_COUNT];
+  uint8_t stagedCount = 0;
+
+  while (addr + KV_HEADER_SIZE <= end) {
+    RecordHeader h;
+    readBytes(addr, &h, KV_HEADER_SIZE);
+
+    // 全0xFF：未写区域
+    if (h.key == 0xFF && h.flags == 0xFF && h.length == 0xFFFF &&
+        h.crc == 0xFFFFFFFF)
+      break;
+
+    if (!validateRecord(addr, h, end)) {
+      // 掉电写坏的尾部：其后空间不再可用
+      stats.crcFails++;
+      LOG_PRINTF(WARN, "[存储] ⚠️ 扇区%d 偏移%u 记录损坏，已丢弃\n", sector,
+                 addr - start);
+      addr = end;
+      break;
+    }
+
+    if (h.key == KV_KEY_COMMIT) {
+      for (uint8_t i = 0; i < stagedCount; i++) {
+        index[stagedKeys[i]] = stagedAddr[i];
+        readBytes(stagedAddr[i], &h, KV_HEADER_SIZE);
+        lengths[stagedKeys[i]] = h.length;
+      }
+      stagedCount = 0;
+      addr += KV_HEADER_SIZE;
+      continue;
+    }
+
+    if (h.key < KV_KEY_COUNT) {
+      if (h.flags & KV_FLAG_TXN) {
+        if (stagedCount < KV_KEY_COUNT) {
+          stagedKeys[stagedCount] = h.key;
+          stagedAddr[stagedCount] = addr;
+          stagedCount++;
+        }
+      } else {
+        index[h.key] = addr;
+        lengths[h.key] = h.length;
+      }
+    }
+    // 未知的键（新版本写入）忽略
+
+    addr += KV_HEADER_SIZE + align4(h.length);
+  }
+
+  if (isHead) {
+    writeOffset = addr - start;
+  }
+}
+
+bool KVStore::validateRecord(uint32_t address, const RecordHeader &header,
+                             uint32_t limit) {
+  if (address + KV_HEADER_SIZE + align4(header.length) > limit)
+    return false;
+
+  // 分段读取计算CRC
+  uint32_t crc = Checksum::crc32(&header, 4);
+  uint32_t remaining = header.length;
+  uint32_t pos = address + KV_HEADER_SIZE;
+  while (remaining > 0) {
+    uint32_t n = min(remaining, (uint32_t)sizeof(scratch));
+    if (!ESP.flashRead(pos, scratch, align4(n)))
+      return false;
+    crc = Checksum::crc32(scratch, n, crc);
+    pos += align4(n);
+    remaining -= n;
+  }
+  return crc == header.crc;
+}
+
+bool KVStore::advance() {
+  uint8_t next = (headSector + 1) % KV_SECTOR_COUNT;
+
+  // 正常情况下下一个扇区已被回收；否则先把其中的有效记录搬到当前扇区
+  uint32_t seq;
+  if (readSectorHeader(next, seq) && !reclaim(next))
+    return false;
+
+  if (!formatSector(next, headSeq + 1))
+    return false;
+
+  headSector = next;
+  headSeq++;
+  writeOffset = KV_HEADER_SIZE;
+  DEBUG_PRINTF("[存储] 切换到扇区%d (序号:%u)\n", headSector, headSeq);
+
+  // 保持当前扇区之后始终有一个空闲扇区：回收最旧的扇区。
+  // 回收完成前不能在当前扇区提交新记录（见 reclaim），失败时放弃剩余空间，
+  // 下次写入时重试
+  uint8_t oldest = (headSector + 1) % KV_SECTOR_COUNT;
+  if (readSectorHeader(oldest, seq) && !reclaim(oldest)) {
+    writeOffset = KV_SECTOR_SIZE;
+    return false;
+  }
+  return true;
+}
+
+bool KVStore::reclaim(uint8_t sector) {
+  if (collectGarbage(sector))
+    return true;
+
+  // 当前扇区只有本次回收（或掉电中断的上次回收）搬入的副本，原件仍在
+  // sector 中：以相同序号重新格式化，重建索引后重做一次
+  LOG_PRINTF(WARN, "[存储] ⚠️ 重新格式化扇区%d 后重做回收\n", headSector);
+  if (!formatSector(headSector, headSeq))
+    return false;
+  replay();
+  return collectGarbage(sector);
+}
+
+bool KVStore::collectGarbage(uint8_t sector) {
+  uint32_t start = sectorAddress(sector);
+  uint32_t end = start + KV_SECTOR_SIZE;
+
+  DEBUG_PRINTF("[存储] 回收扇区%d\n", sector);
+
+  for (uint8_t key = 0; key < KV_KEY_COUNT; key++) {
+    if (index[key] < start || index[key] >= end)
+      continue;
+
+    // 仍是最新值的记录搬到当前扇区（作为独立记录重新计算CRC）
+    uint32_t src = index[key];
+    RecordHeader h;
+    if (!readBytes(src, &h, KV_HEADER_SIZE)) {
+      LOG_PRINTLN(ERROR, "[存储] ❌ 回收读取失败");
+      return false;
+    }
+    h.flags = 0;
+
+    uint32_t recordSize = KV_HEADER_SIZE + align4(h.length);
+    if (writeOffset + recordSize > KV_SECTOR_SIZE) {
+      LOG_PRINTLN(ERROR, "[存储] ❌ 回收空间不足");
+      return false;
+    }
+
+    h.crc = Checksum::crc32(&h, 4);
+    for (uint32_t off = 0; off < h.length; off += sizeof(scratch)) {
+      uint32_t n = min((uint32_t)h.length - off, (uint32_t)sizeof(scratch));
+      if (!ESP.flashRead(src + KV_HEADER_SIZE + off, scratch, align4(n))) {
+        LOG_PRINTLN(ERROR, "[存储] ❌ 回收读取失败");
+        return false;
+      }
+      h.crc = Checksum::crc32(scratch, n, h.crc);
+    }
+
+    // 先写头再写内容；中途掉电时CRC不匹配，旧扇区中的副本仍然有效。
+    // 失败时索引和源扇区保持不变，已部分写入的空间不再使用
+    uint32_t dst = sectorAddress(headSector) + writeOffset;
+    bool ok = ESP.flashWrite(dst, (const uint32_t *)&h, KV_HEADER_SIZE);
+    for (uint32_t off = 0; ok && off < h.length; off += sizeof(scratch)) {
+      uint32_t n = align4(min((uint32_t)h.length - off, (uint32_t)sizeof(scratch)));
+      ok = ESP.flashRead(src + KV_HEADER_SIZE + off, scratch, n) &&
+           ESP.flashWrite(dst + KV_HEADER_SIZE + off, scratch, n);
+    }
+    if (!ok) {
+      LOG_PRINTLN(ERROR, "[存储] ❌ 回收写入失败");
+      writeOffset = KV_SECTOR_SIZE;
+      return false;
+    }
+
+    writeOffset += recordSize;
+    index[key] = dst;
+    stats.gcMoves++;
+  }
+
+  if (!ESP.flashEraseSector(start / KV_SECTOR_SIZE))
+    return false;
+  stats.erases++;
+  return true;
+}
+
+bool KVStore::stage(uint8_t key, const void *data, size_t length) {
+  uint32_t recordSize = KV_HEADER_SIZE + align4(length);
+
+  // 预留提交标记的空间，且整个事务必须能放进一个扇区
+  if (txnLength + recordSize + KV_HEADER_SIZE > KV_TXN_BUFFER_SIZE ||
+      txnLength + recordSize + KV_HEADER_SIZE >
+          KV_SECTOR_SIZE - KV_HEADER_SIZE) {
+    LOG_PRINTF(ERROR, "[存储] ❌ 事务过大 (键:%d, %u 字节)\n", key, length);
+    return false;
+  }
+
+  uint8_t *buf = (uint8_t *)txnBuffer + txnLength;
+  RecordHeader h = {key, 0, (uint16_t)length, 0};
+  memcpy(buf, &h, KV_HEADER_SIZE);
+  memcpy(buf + KV_HEADER_SIZE, data, length);
+  memset(buf + KV_HEADER_SIZE + length, 0, align4(length) - length);
+
+  txnLength += recordSize;
+  txnRecords++;
+  return true;
+}
+
+bool KVStore::equals(uint8_t key, const void *data, size_t length) {
+  if (index[key] == 0 || lengths[key] != length)
+    return false;
+
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (uint32_t off = 0; off < length; off += sizeof(scratch)) {
+    uint32_t n = min((uint32_t)length - off, (uint32_t)sizeof(scratch));
+    if (!ESP.flashRead(index[key] + KV_HEADER_SIZE + off, scratch, align4(n)))
+      return false;
+    if (memcmp(scratch, bytes + off, n) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool KVStore::readBytes(uint32_t address, void *data, size_t length) {
+  uint8_t *out = (uint8_t *)data;
+  for (uint32_t off = 0; off < length; off += sizeof(scratch)) {
+    uint32_t n = min((uint32_t)length - off, (uint32_t)sizeof(scratch));
+    if (!ESP.flashRead(address + off, scratch, align4(n)))
+      return false;
+    memcpy(out + off, scratch, n);
+  }
+  return true;
+}
+
+uint32_t KVStore::recordCrc(const RecordHeader &header, const void *payload) {
+  // CRC覆盖 key/flags/length 和内容
+  uint32_t crc = Checksum::crc32(&header, 4);
+  if (header.length > 0)
+    crc = Checksum::crc32(payload, header.length, crc);
+  return crc;
+}
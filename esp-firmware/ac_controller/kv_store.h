@@ -0,0 +1,115 @@
+/*
+ * 日志式键值存储
+ *
+ * 功能：
+ * - 替代 EEPROM 模拟：记录只追加写入，不再整扇区擦写
+ * - 多个Flash扇区轮转（磨损均衡），满时垃圾回收最旧扇区
+ * - 每条记录带CRC-32，掉电写坏的记录在启动重放时丢弃
+ * - 多键原子事务（一次Flash写入 + 提交标记）
+ * - 值未变化时跳过写入
+ *
+ * Flash布局（每个扇区）：
+ *   [扇区头 8B: magic, seq] [记录...] [0xFF 未写区域]
+ * 记录：
+ *   [key 1B][flags 1B][len 2B][crc32 4B][payload, 4字节对齐]
+ */
+
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include "config.h"
+#include <Arduino.h>
+
+// 记录键（新增键只能追加，不能改变已有数值）
+enum KVKey : uint8_t {
+  KV_KEY_WIFI_CREDENTIALS = 0x01, // WiFiCredentials
+  KV_KEY_DEVICE_CONFIG = 0x02,    // DeviceConfig
+  KV_KEY_DEVICE_ID = 0x03,        // uint32_t
+  KV_KEY_AC_STATE = 0x04,         // ACState（来源不保存）
+  KV_KEY_NET_CACHE = 0x05,        // NetCacheData
+  KV_KEY_GROUPS = 0x06,           // GroupList
+  KV_KEY_COUNT                    // 索引表大小
+};
+
+// 存储统计
+struct KVStats {
+  uint32_t writes;   // Flash写入次数（每次提交一次）
+  uint32_t bytes;    // 写入字节数
+  uint32_t skipped;  // 值未变化跳过的写入
+  uint32_t erases;   // 扇区擦除次数
+  uint32_t gcMoves;  // 垃圾回收搬移的记录数
+  uint32_t crcFails; // 启动重放时丢弃的损坏记录
+};
+
+class KVStore {
+public:
+  // 挂载存储并重放日志，建立内存索引
+  static bool init();
+
+  // 本次启动新建了空日志（可用于从旧EEPROM迁移）
+  static bool isFresh();
+
+  // 启动时补做的回收失败：已有的值仍可读取，写入一律失败
+  static bool isReadOnly();
+
+  // 读取值，返回存储的长度（不存在返回-1）；maxLen 小于存储长度时只读取前
+  // maxLen 字节
+  static int get(uint8_t key, void *data, size_t maxLen);
+
+  // 写入值（事务外立即提交），值未变化时跳过
+  static bool put(uint8_t key, const void *data, size_t length);
+
+  // 事务：begin 之后的 put 在 commit 时一次性原子写入
+  static void beginTransaction();
+  static bool commit();
+
+  static const KVStats &getStats();
+  static void printStats();
+
+private:
+  struct RecordHeader {
+    uint8_t key;
+    uint8_t flags;
+    uint16_t length;
+    uint32_t crc;
+  };
+  static_assert(sizeof(RecordHeader) == 8, "记录头必须是8字节");
+
+  static uint32_t baseAddress;
+  static uint8_t headSector;  // 当前追加写入的扇区
+  static uint32_t headSeq;    // 当前扇区序号
+  static uint32_t writeOffset; // 当前扇区内的写入偏移
+  static bool mounted;
+  static bool fresh;
+  static bool readOnly;
+
+  static uint32_t index[KV_KEY_COUNT]; // 每个键最新记录的Flash地址（0=无）
+  static uint16_t lengths[KV_KEY_COUNT];
+
+  // 待提交的事务缓冲区
+  static uint32_t txnBuffer[KV_TXN_BUFFER_SIZE / 4];
+  static uint16_t txnLength;
+  static uint8_t txnRecords;
+  static bool inTransaction;
+
+  static KVStats stats;
+
+  static uint32_t sectorAddress(uint8_t sector);
+  static bool replay(); // 重建索引，返回是否找到日志
+  static bool readSectorHeader(uint8_t sector, uint32_t &seq);
+  static bool formatSector(uint8_t sector, uint32_t seq);
+  static void replaySector(uint8_t sector, bool isHead);
+  static bool validateRecord(uint32_t address, const RecordHeader &header,
+                             uint32_t limit);
+  static bool advance();
+  static bool collectGarbage(uint8_t sector);
+  static bool reclaim(uint8_t sector); // 回收失败时重建当前扇区后重试
+  static bool stage(uint8_t key, const void *data, size_t length);
+  static bool equals(uint8_t key, const void *data, size_t length);
+  static bool readBytes(uint32_t address, void *data, size_t length);
+  static uint32_t recordCrc(const RecordHeader &header, const void *payload);
+
+  static uint32_t align4(uint32_t n) { return (n + 3) & ~3UL; }
+};
+
+#endif // KV_STORE_H
@@ -6,9 +6,9 @@
 
 // 静态成员初始化
 SystemStatus LEDIndicator::currentStatus = STATUS_UNCONFIGURED;
-unsigned long LEDIndicator::lastBlinkTime = 0;
 bool LEDIndicator::ledState = false;
-unsigned long LEDIndicator::irBlinkStart = 0;
+TaskId LEDIndicator::blinkTask = SCHED_INVALID_TASK;
+TaskId LEDIndicator::irOffTask = SCHED_INVALID_TASK;
 
 void LEDIndicator::init() {
   pinMode(PIN_LED_SYS, OUTPUT);
@@ -18,60 +18,54 @@ void LEDIndicator::init() {
   setSystemLED(false);
   setIRLED(false);
 
+  // 闪烁只在截止时间到达时执行，常亮状态下不占用主循环
+  blinkTask =
+      Scheduler::addPeriodic("led", blinkPeriod(currentStatus), update);
+  irOffTask = Scheduler::addOneShot("led_ir", irOff);
+
   DEBUG_PRINTLN("[LED] 初始化完成");
 }
 
 void LEDIndicator::update() {
-  unsigned long now = millis();
-
   // ===== 系统LED状态控制 =====
-  switch (currentStatus) {
-  case STATUS_UNCONFIGURED:
-    // 快闪200ms
-    if (now - lastBlinkTime > 200) {
-      ledState = !ledState;
-      setSystemLED(ledState);
-      lastBlinkTime = now;
-    }
-    break;
-
-  case STATUS_WIFI_CONNECTING:
-    // 慢闪1000ms
-    if (now - lastBlinkTime > 1000) {
-      ledState = !ledState;
-      setSystemLED(ledState);
-      lastBlinkTime = now;
-    }
-    break;
-
-  case STATUS_MQTT_CONNECTING:
-    // 快闪500ms
-    if (now - lastBlinkTime > 500) {
-      ledState = !ledState;
-      setSystemLED(ledState);
-      lastBlinkTime = now;
-    }
-    break;
-
-  case STATUS_READY:
+  if (currentStatus == STATUS_READY) {
     // 常亮
     setSystemLED(true);
-    break;
+    return;
   }
 
-  // ===== 红外LED控制（100ms后自动熄灭）=====
-  if (irBlinkStart > 0 && now - irBlinkStart > 100) {
-    setIRLED(false);
-    irBlinkStart = 0;
+  ledState = !ledState;
+  setSystemLED(ledState);
+}
+
+uint32_t LEDIndicator::blinkPeriod(SystemStatus status) {
+  switch (status) {
+  case STATUS_UNCONFIGURED:
+    return 200; // 快闪200ms
+  case STATUS_WIFI_CONNECTING:
+    return 1000; // 慢闪1000ms
+  case STATUS_MQTT_CONNECTING:
+    return 500; // 快闪500ms
+  case STATUS_READY:
+  default:
+    return 0; // 常亮
   }
 }
 
 void LEDIndicator::setStatus(SystemStatus status) {
   if (currentStatus != status) {
     currentStatus = status;
-    lastBlinkTime = millis();
     ledState = false;
 
+    uint32_t period = blinkPeriod(status);
+    if (period > 0) {
+      Scheduler::setInterval(blinkTask, period);
+      Scheduler::schedule(blinkTask, period);
+    } else {
+      Scheduler::cancel(blinkTask);
+      setSystemLED(true);
+    }
+
     DEBUG_PRINT("[LED] 状态切换: ");
     switch (status) {
     case STATUS_UNCONFIGURED:
@@ -92,9 +86,12 @@ void LEDIndicator::setStatus(SystemStatus status) {
 
 void LEDIndicator::blinkIR() {
   setIRLED(true);
-  irBlinkStart = millis();
+  // 100ms后自动熄灭
+  Scheduler::schedule(irOffTask, 100);
 }
 
+void LEDIndicator::irOff() { setIRLED(false); }
+
 void LEDIndicator::setSystemLED(bool state) {
   digitalWrite(PIN_LED_SYS, state ? HIGH : LOW);
 }
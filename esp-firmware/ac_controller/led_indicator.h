@@ -10,6 +10,7 @@
 #define LED_INDICATOR_H
 
 #include "config.h"
+#include "scheduler.h"
 #include <Arduino.h>
 
 
@@ -23,10 +24,10 @@ enum SystemStatus {
 
 class LEDIndicator {
 public:
-  // 初始化LED引脚
+  // 初始化LED引脚并注册闪烁任务
   static void init();
 
-  // 更新LED状态（在loop中调用）
+  // 系统LED闪烁（调度器周期任务）
   static void update();
 
   // 设置系统状态
@@ -37,9 +38,15 @@ public:
 
 private:
   static SystemStatus currentStatus;
-  static unsigned long lastBlinkTime;
   static bool ledState;
-  static unsigned long irBlinkStart;
+  static TaskId blinkTask; // 系统LED翻转任务
+  static TaskId irOffTask; // 红外LED熄灭任务
+
+  // 当前状态对应的闪烁周期（0表示常亮）
+  static uint32_t blinkPeriod(SystemStatus status);
+
+  // 红外LED熄灭（单次任务）
+  static void irOff();
 
   // 辅助函数
   static void setSystemLED(bool state);
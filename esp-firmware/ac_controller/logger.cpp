@@ -0,0 +1,299 @@
+/*
+ * 日志模块 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_SYS
+
+#include "logger.h"
+#include "scheduler.h"
+#include <stdarg.h>
+
+static const char *const MODULE_NAMES[LOG_MOD_COUNT] = {
+    "main", "mqtt", "wifi", "ir", "state", "sys"};
+static const char *const LEVEL_NAMES[] = {"none", "error", "warn", "info",
+                                          "debug"};
+static const char LEVEL_TAGS[] = "-EWID"; // 行首级别标记
+
+static LogWriter writer;
+
+// 静态成员初始化
+char Logger::buffer[LOG_BUFFER_SIZE];
+uint16_t Logger::head = 0;
+uint16_t Logger::serialTail = 0;
+uint16_t Logger::shipTail = 0;
+bool Logger::lineStart = true;
+uint8_t Logger::lineLevel = LOG_LEVEL_INFO;
+bool Logger::started = false;
+bool Logger::suppressed = false;
+uint8_t Logger::levels[LOG_MOD_COUNT] = {
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+    LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL};
+int8_t Logger::task = SCHED_INVALID_TASK;
+LogShipper Logger::shipper = nullptr;
+bool Logger::shipping = false;
+bool Logger::shipBackoff = false;
+uint32_t Logger::lastShip = 0;
+LogStats Logger::stats = {0, 0, 0, 0, 0};
+
+static_assert(LOG_MOD_COUNT == 6, "MODULE_NAMES/levels 需与 LogModule 同步");
+static_assert(LOG_BUFFER_SIZE <= 32768, "环形缓冲区下标为 uint16_t");
+
+size_t LogWriter::write(uint8_t c) {
+  Logger::append(&c, 1);
+  return 1;
+}
+
+size_t LogWriter::write(const uint8_t *data, size_t length) {
+  Logger::append(data, length);
+  return length;
+}
+
+void Logger::begin() {
+  task = Scheduler::addOneShot("log", drain);
+  // init 阶段积累的日志由主循环第一次调度写出
+  Scheduler::trigger(task);
+}
+
+Print &Logger::at(uint8_t module, uint8_t level) {
+  (void)module; // 模块已由调用方的 enabled() 过滤，日志内容自带 [模块] 前缀
+  lineLevel = level;
+  return writer;
+}
+
+void Logger::printf(uint8_t module, uint8_t level, const char *format, ...) {
+  char line[LOG_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (n <= 0) {
+    return;
+  }
+
+  // 超长时截断，保留行尾换行
+  if ((size_t)n >= sizeof(line)) {
+    n = sizeof(line) - 1;
+    size_t fl = strlen(format);
+    if (format[fl - 1] == '\n') {
+      line[n - 1] = '\n';
+    }
+  }
+
+  at(module, level);
+  append((const uint8_t *)line, n);
+}
+
+void Logger::append(const uint8_t *data, size_t length) {
+  if (length == 0) {
+    return;
+  }
+
+  // 行首加时间戳和级别：“123.456 W ”
+  char header[20];
+  size_t headerLength = 0;
+  if (lineStart) {
+    uint32_t now = millis();
+    headerLength = snprintf(header, sizeof(header), "%lu.%03lu %c ",
+                            (unsigned long)(now / 1000),
+                            (unsigned long)(now % 1000), LEVEL_TAGS[lineLevel]);
+  }
+  lineStart = data[length - 1] == '\n';
+
+  if (!reserve(headerLength + length)) {
+    stats.dropped += length;
+    return;
+  }
+
+  bool idle = serialTail == head;
+  put(header, headerLength);
+  put((const char *)data, length);
+
+  uint16_t inUse = used(serialTail);
+  if (shipping && used(shipTail) > inUse) {
+    inUse = used(shipTail);
+  }
+  if (inUse > stats.peak) {
+    stats.peak = inUse;
+  }
+
+  // 串口积压从无到有时唤醒 log 任务（有积压时任务已按间隔排期）
+  if (idle) {
+    Scheduler::trigger(task);
+  }
+}
+
+bool Logger::reserve(size_t length) {
+  if (length >= LOG_BUFFER_SIZE) {
+    return false;
+  }
+
+  // MQTT上报落后于串口：放弃未上报部分，从下一个完整行继续
+  if (shipping && used(shipTail) > used(serialTail) &&
+      (size_t)(LOG_BUFFER_SIZE - 1 - used(shipTail)) < length) {
+    uint16_t next = serialTail;
+    while (next != head && buffer[next] != '\n') {
+      next = (next + 1) % LOG_BUFFER_SIZE;
+    }
+    if (next != head) {
+      next = (next + 1) % LOG_BUFFER_SIZE;
+    }
+    stats.shipDropped += used(shipTail) - used(next);
+    shipTail = next;
+  }
+
+  if ((size_t)(LOG_BUFFER_SIZE - 1 - used(serialTail)) < length) {
+    if (started) {
+      return false; // 主循环中不等待串口，丢弃
+    }
+    // 启动阶段（主循环开始前）没有其他工作，同步写出
+    writeSerial(LOG_BUFFER_SIZE);
+  }
+  return true;
+}
+
+void Logger::put(const char *data, size_t length) {
+  size_t first = min(length, (size_t)(LOG_BUFFER_SIZE - head));
+  memcpy(buffer + head, data, first);
+  memcpy(buffer, data + first, length - first);
+  head = (head + length) % LOG_BUFFER_SIZE;
+}
+
+void Logger::writeSerial(size_t max) {
+  // 环形缓冲区末尾处分两次写出
+  while (max > 0 && serialTail != head) {
+    size_t n = head >= serialTail ? head - serialTail
+                                  : LOG_BUFFER_SIZE - serialTail;
+    n = min(n, max);
+    Serial.write((const uint8_t *)buffer + serialTail, n);
+    serialTail = (serialTail + n) % LOG_BUFFER_SIZE;
+    max -= n;
+  }
+}
+
+uint16_t Logger::used(uint16_t tail) {
+  return (head + LOG_BUFFER_SIZE - tail) % LOG_BUFFER_SIZE;
+}
+
+void Logger::drain() {
+  started = true;
+
+  // 只写入 FIFO 的剩余空间，Serial.write 不会等待
+  writeSerial(Serial.availableForWrite());
+
+  if (shipping) {
+    ship();
+  }
+
+  if (serialTail != head) {
+    Scheduler::schedule(task, LOG_DRAIN_INTERVAL);
+  } else if (shipping && shipTail != head) {
+    uint32_t elapsed = millis() - lastShip;
+    bool full = !shipBackoff && used(shipTail) >= LOG_SHIP_BATCH;
+    Scheduler::schedule(task, full || elapsed >= LOG_SHIP_INTERVAL
+                                  ? 0
+                                  : LOG_SHIP_INTERVAL - elapsed);
+  }
+}
+
+void Logger::ship() {
+  uint16_t pending = used(shipTail);
+  if (pending == 0 || shipper == nullptr) {
+    return;
+  }
+
+  // 积满一批（上次上报成功时）或到达上报间隔
+  bool full = !shipBackoff && pending >= LOG_SHIP_BATCH;
+  if (!full && millis() - lastShip < LOG_SHIP_INTERVAL) {
+    return;
+  }
+
+  // 只上报完整的行；单行超过一批时整批发出
+  uint16_t window = min(pending, (uint16_t)LOG_SHIP_BATCH);
+  uint16_t length = window;
+  while (length > 0 &&
+         buffer[(shipTail + length - 1) % LOG_BUFFER_SIZE] != '\n') {
+    length--;
+  }
+  if (length == 0) {
+    if (window < LOG_SHIP_BATCH) {
+      return; // 行尚未写完
+    }
+    length = window;
+  }
+
+  size_t first = min((size_t)length, (size_t)(LOG_BUFFER_SIZE - shipTail));
+  // 发布过程中 MQTT 模块自身的日志不记录，避免循环上报
+  suppressed = true;
+  bool ok = shipper(buffer + shipTail, first, buffer, length - first);
+  suppressed = false;
+
+  lastShip = millis();
+  shipBackoff = !ok;
+  if (ok) {
+    shipTail = (shipTail + length) % LOG_BUFFER_SIZE;
+    stats.batches++;
+  }
+}
+
+void Logger::flush() {
+  writeSerial(LOG_BUFFER_SIZE);
+  Serial.flush();
+}
+
+bool Logger::setLevel(const char *module, const char *level) {
+  int8_t value = -1;
+  for (uint8_t i = 0; i < sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]); i++) {
+    if (strcmp(level, LEVEL_NAMES[i]) == 0) {
+      value = i;
+      break;
+    }
+  }
+  if (value < 0) {
+    return false;
+  }
+
+  if (strcmp(module, "*") == 0) {
+    for (uint8_t i = 0; i < LOG_MOD_COUNT; i++) {
+      levels[i] = value;
+    }
+    return true;
+  }
+  for (uint8_t i = 0; i < LOG_MOD_COUNT; i++) {
+    if (strcmp(module, MODULE_NAMES[i]) == 0) {
+      levels[i] = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint8_t Logger::getLevel(uint8_t module) {
+  return module < LOG_MOD_COUNT ? levels[module] : LOG_LEVEL_NONE;
+}
+
+const char *Logger::moduleName(uint8_t module) {
+  return module < LOG_MOD_COUNT ? MODULE_NAMES[module] : "?";
+}
+
+const char *Logger::levelName(uint8_t level) {
+  return level <= LOG_LEVEL_DEBUG ? LEVEL_NAMES[level] : "?";
+}
+
+void Logger::setShipper(LogShipper fn) { shipper = fn; }
+
+void Logger::setShipping(bool enable) {
+  if (enable && !shipping) {
+    // 从当前位置开始上报，之前的日志只输出到串口
+    shipTail = head;
+    lastShip = millis();
+    shipBackoff = false;
+  }
+  shipping = enable;
+}
+
+bool Logger::isShipping() { return shipping; }
+
+const LogStats &Logger::getStats() {
+  stats.pending = used(serialTail);
+  return stats;
+}
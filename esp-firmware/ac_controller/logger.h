@@ -0,0 +1,194 @@
+/*
+ * 日志模块
+ *
+ * 功能：
+ * - 日志先写入环形缓冲区，由 log 任务按串口 FIFO 剩余空间写出，
+ *   调用方不等待 UART（115200 波特率下 2KB 消息约阻塞 180ms）
+ * - 编译期级别 LOG_LEVEL：更低级别的日志调用连同格式字符串一起去除
+ * - 运行时按模块设置级别（/config 的 "log" 字段），重启后恢复默认
+ * - 可选：日志按批通过 MQTT 上报到 log 主题（/config 的 "logShip" 字段）
+ *
+ * 用法：
+ *   LOG_PRINTF(WARN, "[MQTT] ⚠️ 连接断开 (错误 %d)\n", err);
+ *   DEBUG_PRINTF(...) 等旧宏为 INFO 级别
+ *
+ * 每个 .cpp 在包含头文件前定义所属模块（默认 LOG_MOD_MAIN）：
+ *   #define LOG_MODULE LOG_MOD_MQTT
+ *
+ * 缓冲区满时丢弃新日志（启动阶段主循环开始前除外：同步写出）；
+ * MQTT上报积压时先丢弃未上报的部分，串口输出优先
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "config.h"
+#include <Arduino.h>
+
+// 日志模块（运行时级别按模块设置）
+enum LogModule {
+  LOG_MOD_MAIN,  // 主程序、启动、LED
+  LOG_MOD_MQTT,  // MQTT连接、传输、订阅
+  LOG_MOD_WIFI,  // WiFi、网络缓存、配网门户
+  LOG_MOD_IR,    // 红外收发、学习、分片、自动检测、Ghost
+  LOG_MOD_STATE, // 状态、影子、分组命令、传感器
+  LOG_MOD_SYS,   // 配置、存储、调度、事件、缓冲区
+  LOG_MOD_COUNT
+};
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MOD_MAIN
+#endif
+
+// 日志统计
+struct LogStats {
+  uint16_t pending;     // 待写出到串口的字节
+  uint16_t peak;        // 缓冲区占用峰值
+  uint32_t dropped;     // 缓冲区满丢弃的字节
+  uint32_t batches;     // MQTT上报批次
+  uint32_t shipDropped; // 未上报即被覆盖的字节
+};
+
+// MQTT上报回调：数据在环形缓冲区中可能分为两段，返回 false 表示稍后重试
+typedef bool (*LogShipper)(const char *data, size_t length, const char *more,
+                           size_t moreLength);
+
+// 写入环形缓冲区的 Print（print/println 的各种重载）
+class LogWriter : public Print {
+public:
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t length) override;
+};
+
+class Logger {
+public:
+  // 注册 log 任务（Serial.begin 之后调用）
+  static void begin();
+
+  // 日志是否需要记录（运行时级别）
+  static inline bool enabled(uint8_t module, uint8_t level) {
+    return level <= levels[module] && !suppressed;
+  }
+
+  // 开始一段日志，返回写入缓冲区的 Print
+  static Print &at(uint8_t module, uint8_t level);
+  static void printf(uint8_t module, uint8_t level, const char *format, ...)
+      __attribute__((format(printf, 3, 4)));
+
+  // 运行时级别：模块名 "main"/"mqtt"/.../"*"，级别名 "none"/"error"/
+  // "warn"/"info"/"debug"，无法识别时返回 false
+  static bool setLevel(const char *module, const char *level);
+  static uint8_t getLevel(uint8_t module);
+  static const char *moduleName(uint8_t module);
+  static const char *levelName(uint8_t level);
+
+  // MQTT上报
+  static void setShipper(LogShipper shipper);
+  static void setShipping(bool enable);
+  static bool isShipping();
+
+  // 同步写出串口积压（重启前等场合）
+  static void flush();
+
+  static const LogStats &getStats();
+
+private:
+  friend class LogWriter;
+
+  static char buffer[LOG_BUFFER_SIZE];
+  static uint16_t head;       // 写入位置
+  static uint16_t serialTail; // 串口已写出位置
+  static uint16_t shipTail;   // MQTT已上报位置
+  static bool lineStart;      // 下一个字节是否为行首
+  static uint8_t lineLevel;   // 当前行的级别（行首标记）
+  static bool started;        // 主循环已开始（之后缓冲区满时丢弃）
+  static bool suppressed;     // 上报过程中不记录（避免自身发布日志循环）
+  static uint8_t levels[LOG_MOD_COUNT];
+  static int8_t task; // TaskId（scheduler.h 依赖本头文件，这里不能包含它）
+  static LogShipper shipper;
+  static bool shipping;
+  static bool shipBackoff; // 上次上报失败，等到下一个间隔再试
+  static uint32_t lastShip;
+  static LogStats stats;
+
+  static void append(const uint8_t *data, size_t length);
+  static bool reserve(size_t length);
+  static void put(const char *data, size_t length);
+  static void writeSerial(size_t max);
+  static void drain();
+  static void ship();
+  static uint16_t used(uint16_t tail);
+};
+
+// ===== 日志宏 =====
+// LOG_PRINT/LOG_PRINTLN/LOG_PRINTF(级别, ...)，级别为 ERROR/WARN/INFO/DEBUG
+
+#define LOG_PRINT(level, x) LOG_PRINT_##level(x)
+#define LOG_PRINTLN(level, ...) LOG_PRINTLN_##level(__VA_ARGS__)
+#define LOG_PRINTF(level, ...) LOG_PRINTF_##level(__VA_ARGS__)
+
+#define LOG_EMIT_PRINT(level, x)                                               \
+  do {                                                                         \
+    if (Logger::enabled(LOG_MODULE, level))                                    \
+      Logger::at(LOG_MODULE, level).print(x);                                  \
+  } while (0)
+#define LOG_EMIT_PRINTLN(level, ...)                                           \
+  do {                                                                         \
+    if (Logger::enabled(LOG_MODULE, level))                                    \
+      Logger::at(LOG_MODULE, level).println(__VA_ARGS__);                      \
+  } while (0)
+#define LOG_EMIT_PRINTF(level, ...)                                            \
+  do {                                                                         \
+    if (Logger::enabled(LOG_MODULE, level))                                    \
+      Logger::printf(LOG_MODULE, level, __VA_ARGS__);                          \
+  } while (0)
+#define LOG_STRIPPED                                                           \
+  do {                                                                         \
+  } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_PRINT_ERROR(x) LOG_EMIT_PRINT(LOG_LEVEL_ERROR, x)
+#define LOG_PRINTLN_ERROR(...) LOG_EMIT_PRINTLN(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_PRINTF_ERROR(...) LOG_EMIT_PRINTF(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_PRINT_ERROR(x) LOG_STRIPPED
+#define LOG_PRINTLN_ERROR(...) LOG_STRIPPED
+#define LOG_PRINTF_ERROR(...) LOG_STRIPPED
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_PRINT_WARN(x) LOG_EMIT_PRINT(LOG_LEVEL_WARN, x)
+#define LOG_PRINTLN_WARN(...) LOG_EMIT_PRINTLN(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_PRINTF_WARN(...) LOG_EMIT_PRINTF(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_PRINT_WARN(x) LOG_STRIPPED
+#define LOG_PRINTLN_WARN(...) LOG_STRIPPED
+#define LOG_PRINTF_WARN(...) LOG_STRIPPED
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_PRINT_INFO(x) LOG_EMIT_PRINT(LOG_LEVEL_INFO, x)
+#define LOG_PRINTLN_INFO(...) LOG_EMIT_PRINTLN(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_PRINTF_INFO(...) LOG_EMIT_PRINTF(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_PRINT_INFO(x) LOG_STRIPPED
+#define LOG_PRINTLN_INFO(...) LOG_STRIPPED
+#define LOG_PRINTF_INFO(...) LOG_STRIPPED
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_PRINT_DEBUG(x) LOG_EMIT_PRINT(LOG_LEVEL_DEBUG, x)
+#define LOG_PRINTLN_DEBUG(...) LOG_EMIT_PRINTLN(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_PRINTF_DEBUG(...) LOG_EMIT_PRINTF(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_PRINT_DEBUG(x) LOG_STRIPPED
+#define LOG_PRINTLN_DEBUG(...) LOG_STRIPPED
+#define LOG_PRINTF_DEBUG(...) LOG_STRIPPED
+#endif
+
+// 旧调试宏：INFO 级别
+#define DEBUG_PRINT(x) LOG_PRINT(INFO, x)
+#define DEBUG_PRINTLN(...) LOG_PRINTLN(INFO, __VA_ARGS__)
+#define DEBUG_PRINTF(...) LOG_PRINTF(INFO, __VA_ARGS__)
+
+#endif // LOGGER_H
@@ -0,0 +1,72 @@
+/*
+ * 消息缓冲区模块 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_SYS
+
+#include "message_arena.h"
+
+// 静态成员初始化
+uint8_t MessageArena::buffer[MSG_ARENA_SIZE] __attribute__((aligned(4)));
+uint16_t MessageArena::offsets[MSG_ARENA_DEPTH];
+bool MessageArena::released[MSG_ARENA_DEPTH];
+uint8_t MessageArena::depth = 0;
+uintptr_t MessageArena::stackBase = 0;
+MessageArenaStats MessageArena::stats = {0, 0, 0, 0, 0};
+
+void *MessageArena::acquire(size_t size) {
+  size = (size + 3) & ~(size_t)3;
+  if (depth >= MSG_ARENA_DEPTH || size > (size_t)(MSG_ARENA_SIZE - stats.used)) {
+    stats.failures++;
+    LOG_PRINTF(ERROR, "[缓冲区] ❌ 租用 %u 字节失败 (已用 %u/%u，深度 %u)\n", size,
+               stats.used, MSG_ARENA_SIZE, depth);
+    return nullptr;
+  }
+
+  offsets[depth] = stats.used;
+  released[depth] = false;
+  depth++;
+  stats.used += size;
+  stats.leases++;
+  if (stats.used > stats.peak) {
+    stats.peak = stats.used;
+  }
+  return buffer + offsets[depth - 1];
+}
+
+void MessageArena::release(void *ptr) {
+  if (ptr == nullptr) {
+    return; // 租用失败的文档析构时也会归还
+  }
+
+  for (uint8_t i = depth; i > 0; i--) {
+    if (buffer + offsets[i - 1] == ptr) {
+      released[i - 1] = true;
+      break;
+    }
+  }
+
+  // 从栈顶回收所有已归还的块
+  while (depth > 0 && released[depth - 1]) {
+    depth--;
+    stats.used = offsets[depth];
+  }
+}
+
+void MessageArena::markStackBase() {
+  uint8_t marker;
+  stackBase = (uintptr_t)&marker;
+}
+
+void MessageArena::sampleStack() {
+  uint8_t marker;
+  if (stackBase == 0 || (uintptr_t)&marker > stackBase) {
+    return;
+  }
+  uint16_t used = stackBase - (uintptr_t)&marker;
+  if (used > stats.stackPeak) {
+    stats.stackPeak = used;
+  }
+}
+
+const MessageArenaStats &MessageArena::getStats() { return stats; }
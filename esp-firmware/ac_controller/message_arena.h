@@ -0,0 +1,66 @@
+/*
+ * 消息缓冲区模块
+ *
+ * 功能：
+ * - 发布用JSON文档共用一块静态缓冲区（MSG_ARENA_SIZE），按作用域租用：
+ *   文档析构时自动归还，嵌套发布按栈顺序分配
+ * - 配合 MQTTClient::publishJson 直接序列化到发送缓冲区，
+ *   不再需要栈上的 StaticJsonDocument 和 char payload[] 副本
+ * - 统计缓冲区峰值、租用失败次数，以及发布时的栈深度峰值
+ *
+ * 用法：
+ *   ArenaJsonDocument doc(512); // 容量为0表示缓冲区不足
+ *   doc["power"] = true;
+ *   MQTTClient::publishJson(topic.c_str(), doc);
+ */
+
+#ifndef MESSAGE_ARENA_H
+#define MESSAGE_ARENA_H
+
+#include "config.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// 缓冲区统计
+struct MessageArenaStats {
+  uint16_t used;       // 当前占用
+  uint16_t peak;       // 占用峰值
+  uint32_t leases;     // 租用次数
+  uint32_t failures;   // 空间或深度不足的租用
+  uint16_t stackPeak;  // 发布时距 loop() 入口的栈深度峰值（字节）
+};
+
+class MessageArena {
+public:
+  // 租用 size 字节（4字节对齐），不足时返回 nullptr
+  static void *acquire(size_t size);
+
+  // 归还（按租用的相反顺序；乱序归还的块在上层归还后一并释放）
+  static void release(void *ptr);
+
+  // 在 loop() 入口记录栈基准；发布路径调用 sampleStack() 更新峰值
+  static void markStackBase();
+  static void sampleStack();
+
+  static const MessageArenaStats &getStats();
+
+private:
+  static uint8_t buffer[MSG_ARENA_SIZE] __attribute__((aligned(4)));
+  static uint16_t offsets[MSG_ARENA_DEPTH]; // 每个租用的起始偏移
+  static bool released[MSG_ARENA_DEPTH];
+  static uint8_t depth;
+  static uintptr_t stackBase;
+  static MessageArenaStats stats;
+};
+
+// ArduinoJson 分配器：文档的内存池从 MessageArena 租用
+struct ArenaAllocator {
+  void *allocate(size_t size) { return MessageArena::acquire(size); }
+  void deallocate(void *ptr) { MessageArena::release(ptr); }
+  // ArduinoJson 只在 shrinkToFit 时调用（只会缩小），原地保留即可
+  void *reallocate(void *ptr, size_t size) { return ptr; }
+};
+
+typedef BasicJsonDocument<ArenaAllocator> ArenaJsonDocument;
+
+#endif // MESSAGE_ARENA_H
@@ -2,15 +2,55 @@
  * MQTT客户端模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_MQTT
+
 #include "mqtt_client.h"
 #include "config_manager.h"
+#include "heap_monitor.h"
+#include "message_arena.h"
+#include "net_cache.h"
+#include "subscription_manager.h"
+#include <ArduinoJson.h>
+#include <lwip/dns.h>
+
+// DNS解析结果（lwIP 回调写入，loop() 中读取）
+static volatile bool dnsDone = false;
+static volatile uint32_t dnsResult = 0; // 0=解析失败
+static uint8_t dnsGeneration = 0;       // 丢弃已放弃的解析结果
+static TaskId wakeTask = SCHED_INVALID_TASK;
+
+static void onDnsFound(const char *name, const ip_addr_t *ipaddr, void *arg) {
+  if ((uint8_t)(uintptr_t)arg != dnsGeneration) {
+    return;
+  }
+  dnsResult = ipaddr != nullptr ? ip4_addr_get_u32(ip_2_ip4(ipaddr)) : 0;
+  dnsDone = true;
+  if (wakeTask != SCHED_INVALID_TASK) {
+    Scheduler::triggerFromISR(wakeTask);
+  }
+}
 
 // 静态成员初始化
-WiFiClient MQTTClient::wifiClient;
-PubSubClient MQTTClient::mqttClient(wifiClient);
+#if MQTT_TLS_ENABLED
+BearSSL::Session MQTTClient::tlsSessions[MQTT_MAX_BROKERS];
+#endif
 bool MQTTClient::connected = false;
+bool MQTTClient::attempting = false;
+bool MQTTClient::resolving = false;
+bool MQTTClient::usedCachedIp = false;
+unsigned long MQTTClient::attemptStart = 0;
 unsigned long MQTTClient::lastReconnectAttempt = 0;
+uint32_t MQTTClient::reconnectDelay = MQTT_RECONNECT_DELAY;
+unsigned long MQTTClient::onlineAt = 0;
+BrokerSlot MQTTClient::brokers[MQTT_MAX_BROKERS];
+uint8_t MQTTClient::brokerCount = 0;
+uint8_t MQTTClient::currentBroker = 0;
+bool MQTTClient::switchPending = false;
+String MQTTClient::clientId;
+String MQTTClient::willTopic;
+bool MQTTClient::usingConfigCredentials = false;
 void (*MQTTClient::externalCallback)(char *, uint8_t *, unsigned int) = nullptr;
+const MQTTMessage *MQTTClient::currentRequest = nullptr;
 
 // 故障回退机制变量
 uint8_t MQTTClient::eepromFailCount = 0;
@@ -19,33 +59,99 @@ bool MQTTClient::useDefaultCredentials = false;
 void MQTTClient::connect() {
   DEBUG_PRINTLN("[MQTT] 初始化MQTT客户端");
 
-  mqttClient.setServer(MQTT_SERVER, MQTT_PORT);
-  mqttClient.setCallback(messageCallback);
-  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
-  mqttClient.setKeepAlive(MQTT_KEEPALIVE);
+  MQTTTransport::setMessageHandler(messageCallback);
 
-  // 首次连接
-  reconnect();
+#if MQTT_TLS_ENABLED
+#ifdef MQTT_TLS_FINGERPRINT
+  MQTTTransport::tlsClient().setFingerprint(MQTT_TLS_FINGERPRINT);
+#else
+  LOG_PRINTLN(WARN, "[MQTT] ⚠️ TLS未配置证书指纹，不校验服务器证书");
+  MQTTTransport::tlsClient().setInsecure();
+#endif
+#endif
+
+  loadBrokers();
+  DEBUG_PRINTF("[MQTT] 服务器列表: %d 个\n", brokerCount);
+
+  // 首次连接由 loop() 在WiFi就绪后发起
 }
 
-void MQTTClient::loop() {
-  if (!mqttClient.connected()) {
-    unsigned long now = millis();
+void MQTTClient::setTask(TaskId task) {
+  wakeTask = task;
+  MQTTTransport::setWakeTask(task);
+}
 
-    // 避免频繁重连
-    if (now - lastReconnectAttempt > MQTT_RECONNECT_DELAY) {
-      lastReconnectAttempt = now;
+void MQTTClient::loop() {
+  // 服务器列表已变化：断开后立即按新列表重连
+  if (switchPending) {
+    switchPending = false;
+    if (connected || attempting) {
+      DEBUG_PRINTLN("[MQTT] 服务器列表已变化，断开当前连接");
+      MQTTTransport::close();
+    }
+    connected = false;
+    attempting = false;
+    resolving = false;
+    lastReconnectAttempt = 0;
+  }
 
-      if (reconnect()) {
-        lastReconnectAttempt = 0;
+  // 收包、心跳、连接进度
+  MQTTTransport::loop();
+
+  if (attempting) {
+    if (resolving) {
+      if (dnsDone) {
+        resolving = false;
+        if (dnsResult == 0) {
+          LOG_PRINTF(ERROR, "[MQTT] ❌ 无法解析服务器: %s\n",
+                     brokers[currentBroker].host);
+          onAttemptFailed(MQTT_ERR_TCP);
+        } else {
+          NetCache::saveBrokerIp(brokers[currentBroker].host, dnsResult);
+          startTransport(IPAddress(dnsResult));
+        }
+      } else if (millis() - attemptStart > MQTT_CONNECT_TIMEOUT) {
+        dnsGeneration++;
+        resolving = false;
+        LOG_PRINTLN(ERROR, "[MQTT] ❌ DNS解析超时");
+        onAttemptFailed(MQTT_ERR_TIMEOUT);
       }
+      return;
     }
-  } else {
-    mqttClient.loop();
+
+    MQTTTransportState state = MQTTTransport::getState();
+    if (state == MQTT_TRANSPORT_CONNECTED) {
+      onConnected();
+    } else if (state == MQTT_TRANSPORT_FAILED ||
+               state == MQTT_TRANSPORT_IDLE) {
+      onAttemptFailed(MQTTTransport::getLastError());
+    }
+    return;
+  }
+
+  if (connected) {
+    if (MQTTTransport::isConnected()) {
+      return;
+    }
+    LOG_PRINTF(WARN, "[MQTT] ⚠️ 连接断开 (错误 %d)\n",
+               MQTTTransport::getLastError());
+    connected = false;
+    MQTTTransport::close();
+    LEDIndicator::setStatus(STATUS_MQTT_CONNECTING);
+  }
+
+  // 避免频繁重连（首次尝试和掉线后第一次不等待）
+  unsigned long now = millis();
+  if (lastReconnectAttempt == 0 ||
+      now - lastReconnectAttempt > reconnectDelay) {
+    lastReconnectAttempt = now;
+    startAttempt();
   }
 }
 
-bool MQTTClient::isConnected() { return mqttClient.connected(); }
+bool MQTTClient::isConnected() { return connected; }
+
+unsigned long MQTTClient::getOnlineTime() { return onlineAt; }
 
 bool MQTTClient::publish(const char *topic, const char *payload) {
   return publish(topic, payload, false);
@@ -53,25 +159,100 @@ bool MQTTClient::publish(const char *topic, const char *payload) {
 
 bool MQTTClient::publish(const char *topic, const char *payload,
                          bool retained) {
-  if (!mqttClient.connected()) {
-    DEBUG_PRINTLN("[MQTT] ❌ 未连接，无法发布消息");
+  if (!MQTTTransport::isConnected()) {
+    LOG_PRINTLN(ERROR, "[MQTT] ❌ 未连接，无法发布消息");
+    return false;
+  }
+
+  LOG_PRINTF(DEBUG, "[MQTT] 发布: %s\n", topic);
+  LOG_PRINTF(DEBUG, "[MQTT] 内容: %s\n", payload);
+  MessageArena::sampleStack();
+
+  // 设备发布的都是JSON/文本，常用topic走别名（仅MQTT 5生效）
+  MQTTPublishProperties props = {true, true, nullptr, nullptr, 0};
+  return MQTTTransport::publish(topic, (const uint8_t *)payload,
+                                strlen(payload), retained, &props);
+}
+
+uint32_t MQTTClient::getReceivedTime() {
+  return currentRequest != nullptr ? currentRequest->receivedUs : micros();
+}
+
+bool MQTTClient::reply(const char *payload) {
+  if (currentRequest == nullptr || currentRequest->responseTopic == nullptr) {
+    return false;
+  }
+
+  char topic[128];
+  if (currentRequest->responseTopicLength >= sizeof(topic)) {
+    return false;
+  }
+  memcpy(topic, currentRequest->responseTopic,
+         currentRequest->responseTopicLength);
+  topic[currentRequest->responseTopicLength] = '\0';
+
+  LOG_PRINTF(DEBUG, "[MQTT] 应答: %s\n", topic);
+
+  // 应答topic由请求方临时指定，不占用别名
+  MQTTPublishProperties props = {false, true, nullptr,
+                                 currentRequest->correlation,
+                                 currentRequest->correlationLength};
+  return MQTTTransport::publish(topic, (const uint8_t *)payload,
+                                strlen(payload), false, &props);
+}
+
+bool MQTTClient::beginPublish(const char *topic, size_t length,
+                              bool retained) {
+  if (!MQTTTransport::isConnected()) {
+    LOG_PRINTLN(ERROR, "[MQTT] ❌ 未连接，无法发布消息");
     return false;
   }
 
-  DEBUG_PRINTF("[MQTT] 发布: %s\n", topic);
-  DEBUG_PRINTF("[MQTT] 内容: %s\n", payload);
+  LOG_PRINTF(DEBUG, "[MQTT] 发布: %s (%u 字节)\n", topic, length);
+  MessageArena::sampleStack();
+  MQTTPublishProperties props = {true, true, nullptr, nullptr, 0};
+  return MQTTTransport::beginPublish(topic, length, retained, &props);
+}
+
+Print &MQTTClient::getWriter() { return MQTTTransport::writer(); }
+
+bool MQTTClient::endPublish() { return MQTTTransport::endPublish(); }
+
+bool MQTTClient::publishJson(const char *topic, const JsonDocument &doc,
+                             bool retained) {
+  if (doc.capacity() == 0) {
+    LOG_PRINTF(ERROR, "[MQTT] ❌ 文档缓冲区不足，放弃发布: %s\n", topic);
+    return false;
+  }
+  if (doc.overflowed()) {
+    LOG_PRINTF(WARN, "[MQTT] ⚠️ 文档容量不足，部分字段缺失: %s\n", topic);
+  }
 
-  return mqttClient.publish(topic, payload, retained);
+  if (!beginPublish(topic, measureJson(doc), retained)) {
+    return false;
+  }
+  serializeJson(doc, getWriter());
+  return endPublish();
 }
 
-bool MQTTClient::subscribe(const char *topic) {
-  if (!mqttClient.connected()) {
-    DEBUG_PRINTLN("[MQTT] ❌ 未连接，无法订阅");
+bool MQTTClient::subscribe(const char *topic, uint8_t qos) {
+  if (!MQTTTransport::isConnected()) {
+    LOG_PRINTLN(ERROR, "[MQTT] ❌ 未连接，无法订阅");
     return false;
   }
 
-  DEBUG_PRINTF("[MQTT] 订阅: %s\n", topic);
-  return mqttClient.subscribe(topic);
+  DEBUG_PRINTF("[MQTT] 订阅: %s (QoS%d)\n", topic, qos);
+  return MQTTTransport::subscribe(topic, qos);
+}
+
+bool MQTTClient::unsubscribe(const char *topic) {
+  if (!MQTTTransport::isConnected()) {
+    LOG_PRINTLN(ERROR, "[MQTT] ❌ 未连接，无法退订");
+    return false;
+  }
+
+  DEBUG_PRINTF("[MQTT] 退订: %s\n", topic);
+  return MQTTTransport::unsubscribe(topic);
 }
 
 void MQTTClient::setCallback(void (*callback)(char *, uint8_t *,
@@ -92,31 +273,52 @@ String MQTTClient::getTopic(const char *suffix) {
   return String(topic);
 }
 
-void MQTTClient::messageCallback(char *topic, uint8_t *payload,
-                                 unsigned int length) {
-  DEBUG_PRINTF("[MQTT] 收到消息: %s\n", topic);
-  DEBUG_PRINT("[MQTT] 内容: ");
-  for (unsigned int i = 0; i < length; i++) {
-    DEBUG_PRINT((char)payload[i]);
+String MQTTClient::getGroupTopic(const char *group) {
+  // 分组属于用户：同一用户下的设备共享，服务器只需发布一次
+  DeviceConfig &cfg = ConfigManager::getConfig();
+
+  char topic[128];
+  snprintf(topic, sizeof(topic), "ac/user_%u/group/%s/cmd", cfg.userId, group);
+  return String(topic);
+}
+
+void MQTTClient::messageCallback(const MQTTMessage &msg) {
+  // 通配符订阅会收到自己发布的消息，在这里直接丢弃
+  const char *type = nullptr;
+  if (!SubscriptionManager::accept(msg.topic, &type)) {
+    return;
   }
-  DEBUG_PRINTLN();
+
+  // QoS1消息在回调返回后才确认，掉线时服务器会重发同一消息
+  if (msg.qos > 0 &&
+      SubscriptionManager::isDuplicate(msg.msgId, msg.payload, msg.length)) {
+    DEBUG_PRINTF("[MQTT] 忽略重发消息: %s (ID %u)\n", msg.topic, msg.msgId);
+    return;
+  }
+
+  LOG_PRINTF(DEBUG, "[MQTT] 收到消息: %s\n", msg.topic);
+  LOG_PRINT(DEBUG, "[MQTT] 内容: ");
+  LOG_PRINTLN(DEBUG, (const char *)msg.payload);
 
   // 调用外部回调函数
   if (externalCallback != nullptr) {
-    externalCallback(topic, payload, length);
+    currentRequest = &msg;
+    HeapMonitor::beginMessage(type);
+    externalCallback(msg.topic, msg.payload, msg.length);
+    HeapMonitor::endMessage();
+    currentRequest = nullptr;
   }
 }
 
-bool MQTTClient::reconnect() {
-  if (mqttClient.connected()) {
-    return true;
-  }
-
+void MQTTClient::startAttempt() {
   DEBUG_PRINTLN("[MQTT] 尝试连接MQTT服务器...");
   LEDIndicator::setStatus(STATUS_MQTT_CONNECTING);
 
+  attempting = true;
+  attemptStart = millis();
+
   // 生成客户端ID（使用MAC地址）
-  String clientId = "ESP_AC_";
+  clientId = "ESP_AC_";
   clientId += WiFi.macAddress();
   clientId.replace(":", "");
 
@@ -143,119 +345,364 @@ bool MQTTClient::reconnect() {
 
   // 如果 EEPROM 配置已失败超过阈值，强制使用默认值
   if (eepromConfigAvailable && eepromFailCount >= MAX_EEPROM_FAIL) {
-    DEBUG_PRINTF("[MQTT] ⚠️ EEPROM配置已失败%d次，强制回退到默认值\n",
-                 eepromFailCount);
+    LOG_PRINTF(WARN, "[MQTT] ⚠️ EEPROM配置已失败%d次，强制回退到默认值\n",
+               eepromFailCount);
     useDefaultCredentials = true;
     eepromConfigAvailable = false;
   }
+  usingConfigCredentials = eepromConfigAvailable && !useDefaultCredentials;
 
-  const char *mqttUser = (eepromConfigAvailable && !useDefaultCredentials)
-                             ? cfg.mqttUser
-                             : MQTT_USER;
-  const char *mqttPassword = (eepromConfigAvailable && !useDefaultCredentials)
-                                 ? cfg.mqttPassword
-                                 : MQTT_PASSWORD;
+  // 选择服务器（当前服务器可用时保持不变）
+  currentBroker = selectBroker();
+  BrokerSlot &broker = brokers[currentBroker];
 
   // 调试：输出 MQTT 连接信息
-  DEBUG_PRINTF("[MQTT] 服务器: %s:%d\n", MQTT_SERVER, MQTT_PORT);
+  DEBUG_PRINTF("[MQTT] 服务器[%d]: %s:%d\n", currentBroker, broker.host,
+               broker.port);
   DEBUG_PRINTF("[MQTT] 客户端ID: %s\n", clientId.c_str());
-  DEBUG_PRINTF("[MQTT] 用户名: %s %s\n", mqttUser,
-               (eepromConfigAvailable && !useDefaultCredentials)
-                   ? "(来自EEPROM)"
-                   : "(使用默认值)");
-  DEBUG_PRINTF("[MQTT] 密码长度: %d %s\n", strlen(mqttPassword),
-               (eepromConfigAvailable && !useDefaultCredentials)
-                   ? "(来自EEPROM)"
-                   : "(使用默认值)");
+  DEBUG_PRINTF("[MQTT] 用户名: %s %s\n",
+               usingConfigCredentials ? cfg.mqttUser : MQTT_USER,
+               usingConfigCredentials ? "(来自EEPROM)" : "(使用默认值)");
   if (useDefaultCredentials) {
-    DEBUG_PRINTF("[MQTT] ⚠️ 已回退到默认值 (失败次数: %d/%d)\n", eepromFailCount,
-                 MAX_EEPROM_FAIL);
+    LOG_PRINTF(WARN, "[MQTT] ⚠️ 已回退到默认值 (失败次数: %d/%d)\n", eepromFailCount,
+               MAX_EEPROM_FAIL);
   }
 
-  // LWT 配置
-  String availTopic = getTopic("availability");
-  const char *willTopic = availTopic.c_str(); // ac/user_x/dev_uuid/availability
-  const char *willMsg = "offline";
-  int willQoS = 1;
-  bool willRetain = true;
-
-  DEBUG_PRINTF("[MQTT] LWT Topic: %s\n", willTopic);
-
-  // 尝试连接（使用回退后的配置）
-  // connect(clientId, username, password, willTopic, willQoS, willRetain,
-  // willMessage)
-  if (mqttClient.connect(clientId.c_str(), mqttUser, mqttPassword, willTopic,
-                         willQoS, willRetain, willMsg)) {
-    DEBUG_PRINTLN("[MQTT] ✅ 连接成功");
-    connected = true;
-    LEDIndicator::setStatus(STATUS_READY);
-
-    // 连接成功后重置失败计数
-    eepromFailCount = 0;
-    useDefaultCredentials = false;
-
-    // 订阅控制命令topic
-    String cmdTopic = getTopic("cmd");
-    String learnTopic = getTopic("learn/start");
-    String configTopic = getTopic("config");
-    String configUpdateTopic = getTopic("config/update");
-    String autoDetectTopic = getTopic("auto_detect"); // ✅ 新增
-    String brandsGetTopic = getTopic("brands/get");   // ✅ 新增
-    String sceneSaveTopic = getTopic("scene/save");   // ✅ 新增
-
-    subscribe(cmdTopic.c_str());
-    subscribe(learnTopic.c_str());
-    subscribe(configTopic.c_str());
-    subscribe(configUpdateTopic.c_str());
-    subscribe(autoDetectTopic.c_str()); // ✅
-    subscribe(brandsGetTopic.c_str());  // ✅
-    subscribe(sceneSaveTopic.c_str());  // ✅
-
-    // 发布上线消息 (至 availability topic)
-    publish(willTopic, "online", true); // Retained = true
+  // 使用缓存的服务器地址，跳过DNS解析
+  uint32_t cachedIp = NetCache::getBrokerIp(broker.host);
+  usedCachedIp = cachedIp != 0;
+  if (usedCachedIp) {
+    startTransport(IPAddress(cachedIp));
+    return;
+  }
 
-    return true;
+  // 异步解析（IP地址字符串或lwIP缓存命中时立即返回）
+  ip_addr_t addr;
+  dnsDone = false;
+  dnsGeneration++;
+  err_t err = dns_gethostbyname(broker.host, &addr, onDnsFound,
+                                (void *)(uintptr_t)dnsGeneration);
+  if (err == ERR_OK) {
+    uint32_t ip = ip4_addr_get_u32(ip_2_ip4(&addr));
+    NetCache::saveBrokerIp(broker.host, ip);
+    startTransport(IPAddress(ip));
+  } else if (err == ERR_INPROGRESS) {
+    resolving = true;
   } else {
-    DEBUG_PRINT("[MQTT] ❌ 连接失败，错误码: ");
-    DEBUG_PRINTLN(mqttClient.state());
-    connected = false;
+    LOG_PRINTF(ERROR, "[MQTT] ❌ 无法解析服务器: %s\n", broker.host);
+    onAttemptFailed(MQTT_ERR_TCP);
+  }
+}
 
-    // 如果使用的是 EEPROM 配置而非默认值，增加失败计数
-    if (eepromConfigAvailable && !useDefaultCredentials) {
-      eepromFailCount++;
-      DEBUG_PRINTF("[MQTT] EEPROM配置失败计数: %d/%d\n", eepromFailCount,
-                   MAX_EEPROM_FAIL);
-    }
+void MQTTClient::startTransport(IPAddress addr) {
+  BrokerSlot &broker = brokers[currentBroker];
+  DEBUG_PRINTF("[MQTT] 服务器地址: %s %s\n", addr.toString().c_str(),
+               usedCachedIp ? "(缓存)" : "(DNS)");
 
-    return false;
+  // LWT 配置：ac/user_x/dev_uuid/availability
+  willTopic = getTopic("availability");
+  DEBUG_PRINTF("[MQTT] LWT Topic: %s\n", willTopic.c_str());
+
+  DeviceConfig &cfg = ConfigManager::getConfig();
+  MQTTConnectOptions options;
+  options.clientId = clientId.c_str();
+  options.user = usingConfigCredentials ? cfg.mqttUser : MQTT_USER;
+  options.password = usingConfigCredentials ? cfg.mqttPassword : MQTT_PASSWORD;
+  options.willTopic = willTopic.c_str();
+  options.willMessage = "offline";
+  options.willQos = 1;
+  options.willRetain = true;
+  options.cleanSession = MQTT_CLEAN_SESSION;
+  options.keepAlive = MQTT_KEEPALIVE;
+
+#if MQTT_TLS_ENABLED
+  prepareTls(currentBroker, addr);
+  unsigned long start = millis();
+#endif
+
+  // 明文连接立即返回，结果在 loop() 中处理
+  MQTTTransport::open(addr, broker.port, options);
+
+#if MQTT_TLS_ENABLED
+  if (MQTTTransport::getState() == MQTT_TRANSPORT_FAILED) {
+    char err[64];
+    int code = MQTTTransport::tlsClient().getLastSSLError(err, sizeof(err));
+    LOG_PRINTF(ERROR, "[MQTT] ❌ TLS握手失败 (%d): %s\n", code, err);
+    return;
   }
+
+  unsigned long ms = millis() - start;
+  uint16_t t = ms > 0xFFFF ? 0xFFFF : ms;
+  if (broker.handshakes == 0) {
+    broker.tlsFullMs = t;
+  }
+  broker.tlsLastMs = t;
+  broker.handshakes++;
+  DEBUG_PRINTF("[MQTT] TLS握手: %u ms (第%u次)\n", t, broker.handshakes);
+#endif
+}
+
+void MQTTClient::onConnected() {
+  attempting = false;
+  connected = true;
+  lastReconnectAttempt = 0;
+  reconnectDelay = MQTT_RECONNECT_DELAY;
+
+  BrokerSlot &broker = brokers[currentBroker];
+  recordAttempt(broker, true, millis() - attemptStart);
+  DEBUG_PRINTF("[MQTT] ✅ 连接成功 (%u ms, %s)\n", broker.lastMs,
+               MQTTTransport::sessionPresent() ? "恢复会话" : "新会话");
+  LEDIndicator::setStatus(STATUS_READY);
+
+  // 连接成功后重置失败计数
+  eepromFailCount = 0;
+  useDefaultCredentials = false;
+
+  // 服务器保留了会话时订阅仍有效，只补发差异；会话过期或切换服务器时
+  // 从空集合重新订阅。暂存的命令紧跟CONNACK送达，不等订阅完成
+  if (!MQTTTransport::sessionPresent()) {
+    SubscriptionManager::reset();
+  }
+  SubscriptionManager::sync();
+
+  // 发布上线消息 (至 availability topic)
+  publish(willTopic.c_str(), "online", true); // Retained = true
+
+  // 记录本次启动到首次上线的时间
+  if (onlineAt == 0) {
+    onlineAt = millis();
+    DEBUG_PRINTF("[MQTT] 启动到上线耗时: %lu ms\n", onlineAt);
+  }
+}
+
+void MQTTClient::onAttemptFailed(int8_t error) {
+  attempting = false;
+  resolving = false;
+  MQTTTransport::close();
+
+  LOG_PRINTF(ERROR, "[MQTT] ❌ 连接失败，错误码: %d\n", error);
+  recordAttempt(brokers[currentBroker], false, 0);
+
+  // 缓存的地址可能已失效，下次重新解析
+  if (usedCachedIp) {
+    NetCache::invalidateBroker();
+  }
+
+  // 服务器拒绝了配置中的凭证（CONNACK返回码），累计失败次数
+  if (error > 0 && usingConfigCredentials) {
+    eepromFailCount++;
+    DEBUG_PRINTF("[MQTT] EEPROM配置失败计数: %d/%d\n", eepromFailCount,
+                 MAX_EEPROM_FAIL);
+  }
+
+  backoff();
 }
 
 // ✅ 新增：重新订阅topic（设备绑定后调用）
 void MQTTClient::resubscribe() {
-  if (!mqttClient.connected()) {
-    DEBUG_PRINTLN("[MQTT] ❌ 未连接，无法重新订阅");
+  if (!MQTTTransport::isConnected()) {
+    LOG_PRINTLN(ERROR, "[MQTT] ❌ 未连接，无法重新订阅");
+    return;
+  }
+
+  // 只发出差异：退订旧的 user_X topic，订阅新的
+  DEBUG_PRINTLN("[MQTT] 🔄 更新订阅（设备绑定后）");
+  SubscriptionManager::sync();
+}
+
+bool MQTTClient::loadBrokers() {
+  DeviceConfig &cfg = ConfigManager::getConfig();
+
+  // 主服务器在前，备用服务器按配置顺序排列
+  BrokerSlot list[MQTT_MAX_BROKERS];
+  memset(list, 0, sizeof(list));
+  uint8_t count = 0;
+
+  strncpy(list[count].host, cfg.mqttServer, sizeof(list[count].host) - 1);
+  list[count].port = cfg.mqttPort;
+  count++;
+
+  for (uint8_t i = 0; i < MQTT_MAX_BROKERS - 1; i++) {
+    const BrokerEntry &e = cfg.backupBrokers[i];
+    if (e.host[0] == '\0' || e.port == 0)
+      continue;
+    strncpy(list[count].host, e.host, sizeof(list[count].host) - 1);
+    list[count].port = e.port;
+    count++;
+  }
+
+  bool changed = count != brokerCount;
+  for (uint8_t i = 0; !changed && i < count; i++) {
+    changed = brokers[i].port != list[i].port ||
+              strcmp(brokers[i].host, list[i].host) != 0;
+  }
+  if (!changed)
+    return false;
+
+  // 列表变化：统计清零，从主服务器开始
+  memcpy(brokers, list, sizeof(brokers));
+  brokerCount = count;
+  currentBroker = 0;
+#if MQTT_TLS_ENABLED
+  // 会话与服务器绑定，服务器变化后不能复用
+  for (uint8_t i = 0; i < MQTT_MAX_BROKERS; i++) {
+    tlsSessions[i] = BearSSL::Session();
+  }
+#endif
+  return true;
+}
+
+void MQTTClient::backoff() {
+  // 还有可用的服务器时按固定间隔尝试下一个
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < brokerCount; i++) {
+    if (!isBrokerDown(brokers[i], now))
+      return;
+  }
+
+  // 所有服务器都暂停使用：指数退避（±25% 抖动），避免大量设备同时重连、
+  // 反复完整握手
+  uint32_t next = min(reconnectDelay * 2, (uint32_t)MQTT_RECONNECT_MAX);
+  reconnectDelay = next - next / 4 + random(next / 2 + 1);
+  DEBUG_PRINTF("[MQTT] 所有服务器不可用，%u ms 后重试\n", reconnectDelay);
+}
+
+bool MQTTClient::isBrokerDown(const BrokerSlot &slot, unsigned long now) {
+  return slot.downUntil != 0 && (long)(now - slot.downUntil) < 0;
+}
+
+uint8_t MQTTClient::selectBroker() {
+  unsigned long now = millis();
+
+  // 当前服务器可用时保持不变（掉线后先重连原服务器）
+  if (!isBrokerDown(brokers[currentBroker], now))
+    return currentBroker;
+
+  // 已测量过的可用服务器中选平均耗时最短的
+  int best = -1;
+  for (uint8_t i = 0; i < brokerCount; i++) {
+    const BrokerSlot &b = brokers[i];
+    if (isBrokerDown(b, now) || b.avgMs == 0)
+      continue;
+    if (best < 0 || b.avgMs < brokers[best].avgMs)
+      best = i;
+  }
+
+  // 都未测量过：按列表顺序取下一个可用的
+  for (uint8_t n = 1; best < 0 && n <= brokerCount; n++) {
+    uint8_t i = (currentBroker + n) % brokerCount;
+    if (!isBrokerDown(brokers[i], now))
+      best = i;
+  }
+
+  // 全部暂停中：选最早恢复的
+  if (best < 0) {
+    best = 0;
+    for (uint8_t i = 1; i < brokerCount; i++) {
+      if ((long)(brokers[i].downUntil - brokers[best].downUntil) < 0)
+        best = i;
+    }
+  }
+
+  if (best != currentBroker) {
+    DEBUG_PRINTF("[MQTT] 切换服务器: %s -> %s\n", brokers[currentBroker].host,
+                 brokers[best].host);
+  }
+  return best;
+}
+
+void MQTTClient::recordAttempt(BrokerSlot &slot, bool ok, unsigned long ms) {
+  slot.attempts++;
+
+  if (!ok) {
+    slot.failures++;
+    slot.downUntil = millis() + MQTT_BROKER_HOLDOFF;
+    if (slot.downUntil == 0)
+      slot.downUntil = 1;
     return;
   }
 
-  DEBUG_PRINTLN("[MQTT] 🔄 重新订阅topic（设备绑定后更新）");
+  uint16_t t = ms > 0xFFFF ? 0xFFFF : (ms == 0 ? 1 : ms);
+  slot.downUntil = 0;
+  slot.lastMs = t;
+  slot.avgMs = slot.avgMs == 0 ? t : (slot.avgMs * 3 + t) / 4;
+  if (slot.minMs == 0 || t < slot.minMs)
+    slot.minMs = t;
+  if (t > slot.maxMs)
+    slot.maxMs = t;
+}
+
+void MQTTClient::applyConfig() {
+  if (loadBrokers()) {
+    DEBUG_PRINTF("[MQTT] 服务器列表已更新: %d 个\n", brokerCount);
+    // 正在处理消息回调，断开推迟到下一次 loop()
+    switchPending = true;
+    return;
+  }
+
+  // 服务器不变：只同步订阅（分组可能有变化）
+  if (MQTTTransport::isConnected()) {
+    SubscriptionManager::sync();
+  }
+}
+
+const BrokerSlot &MQTTClient::getCurrentBroker() {
+  return brokers[currentBroker];
+}
 
-  // 订阅新的topic（基于更新后的userId）
-  String cmdTopic = getTopic("cmd");
-  String learnTopic = getTopic("learn/start");
-  String configTopic = getTopic("config");
-  String configUpdateTopic = getTopic("config/update");
-  String autoDetectTopic = getTopic("auto_detect"); // ✅ 新增
-  String brandsGetTopic = getTopic("brands/get");   // ✅ 新增
-  String sceneSaveTopic = getTopic("scene/save");   // ✅ 新增
+void MQTTClient::publishBrokerStats() {
+  if (!MQTTTransport::isConnected())
+    return;
+
+  unsigned long now = millis();
+  DynamicJsonDocument doc(768);
+  doc["current"] = currentBroker;
+
+  JsonArray list = doc.createNestedArray("brokers");
+  for (uint8_t i = 0; i < brokerCount; i++) {
+    const BrokerSlot &b = brokers[i];
+    JsonObject o = list.createNestedObject();
+    o["host"] = b.host;
+    o["port"] = b.port;
+    o["attempts"] = b.attempts;
+    o["failures"] = b.failures;
+    o["lastMs"] = b.lastMs;
+    o["avgMs"] = b.avgMs;
+    o["minMs"] = b.minMs;
+    o["maxMs"] = b.maxMs;
+    o["down"] = isBrokerDown(b, now);
+#if MQTT_TLS_ENABLED
+    o["handshakes"] = b.handshakes;
+    o["tlsFullMs"] = b.tlsFullMs;
+    o["tlsLastMs"] = b.tlsLastMs;
+    o["mfln"] = b.mfln == 1;
+#endif
+  }
+
+  String topic = getTopic("diag/brokers");
+  publishJson(topic.c_str(), doc);
+}
+
+
+#if MQTT_TLS_ENABLED
+void MQTTClient::prepareTls(uint8_t index, IPAddress addr) {
+  BrokerSlot &slot = brokers[index];
+  BearSSL::WiFiClientSecure &tls = MQTTTransport::tlsClient();
+
+  // 探测服务器是否支持最大分片长度协商（每个服务器只探测一次）
+  if (slot.mfln == 0) {
+    bool ok = BearSSL::WiFiClientSecure::probeMaxFragmentLength(
+        addr, slot.port, MQTT_TLS_FRAGMENT);
+    slot.mfln = ok ? 1 : 2;
+    DEBUG_PRINTF("[MQTT] TLS分片协商 %d 字节: %s\n", MQTT_TLS_FRAGMENT,
+                 ok ? "支持" : "不支持");
+  }
 
-  subscribe(cmdTopic.c_str());
-  subscribe(learnTopic.c_str());
-  subscribe(configTopic.c_str());
-  subscribe(configUpdateTopic.c_str());
-  subscribe(autoDetectTopic.c_str()); // ✅
-  subscribe(brandsGetTopic.c_str());  // ✅
-  subscribe(sceneSaveTopic.c_str());  // ✅
+  // 支持时收发缓冲区都缩小到分片长度（约节省15KB），否则接收需完整16KB
+  tls.setBufferSizes(slot.mfln == 1 ? MQTT_TLS_FRAGMENT : MQTT_TLS_RX_FULL,
+                     MQTT_TLS_FRAGMENT);
 
-  DEBUG_PRINTLN("[MQTT] ✅ 重新订阅完成");
+  // 复用上次握手的会话：服务器接受时跳过证书交换和密钥协商
+  tls.setSession(&tlsSessions[index]);
 }
+#endif
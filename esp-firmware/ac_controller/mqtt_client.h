@@ -2,8 +2,11 @@
  * MQTT客户端模块
  *
  * 功能：
- * - 连接MQTT Broker
- * - 订阅控制命令topic
+ * - 连接MQTT Broker（主服务器 + 备用服务器列表，失败时按延迟切换）
+ * - 非阻塞连接：DNS解析、TCP连接、CONNACK 都在后台完成，loop() 不等待
+ * - 可选TLS：会话复用（断线重连只做简化握手）、协商最大分片长度缩小缓冲区
+ * - 订阅控制命令topic（见 subscription_manager.h）
+ * - 持久会话 + QoS1：重连期间下发的命令由服务器暂存，重连后立即送达
  * - 发布状态和事件
  */
 
@@ -12,56 +15,152 @@
 
 #include "config.h"
 #include "led_indicator.h"
+#include "mqtt_transport.h"
+#include <ArduinoJson.h>
 #include <ESP8266WiFi.h>
-#include <PubSubClient.h>
+
+// 服务器列表中的一项及其连接统计（仅保存在内存中）
+struct BrokerSlot {
+  char host[64];
+  uint16_t port;
+  uint16_t attempts;       // 连接尝试次数
+  uint16_t failures;       // 连接失败次数
+  uint16_t lastMs;         // 最近一次成功连接耗时（TCP + CONNACK）
+  uint16_t avgMs;          // 平均耗时（指数移动平均，0=未测量）
+  uint16_t minMs;
+  uint16_t maxMs;
+  unsigned long downUntil; // 失败后暂停使用直到此时刻（0=可用）
+
+  // TLS握手统计（MQTT_TLS_ENABLED）
+  uint16_t handshakes; // 成功握手次数
+  uint16_t tlsFullMs;  // 首次（完整）握手耗时
+  uint16_t tlsLastMs;  // 最近一次握手耗时（复用会话时应明显更短）
+  uint8_t mfln;        // 分片长度协商：0=未探测 1=支持 2=不支持
+};
 
 class MQTTClient {
 public:
-  // 初始化并连接MQTT
+  // 初始化MQTT（连接由 loop() 在WiFi就绪后发起）
   static void connect();
 
+  // 网络事件唤醒的任务（mqtt 维护任务）
+  static void setTask(TaskId task);
+
   // 维护MQTT连接（在loop中调用）
   static void loop();
 
   // 检查是否已连接
   static bool isConnected();
 
+  // 启动到首次发布 availability=online 的时间（毫秒，0=尚未上线）
+  static unsigned long getOnlineTime();
+
   // 发布消息
   static bool publish(const char *topic, const char *payload);
   static bool publish(const char *topic, const char *payload, bool retained);
 
-  // 订阅topic
-  static bool subscribe(const char *topic);
+  // 应答当前正在处理的请求（MQTT 5 Response Topic + Correlation Data），
+  // 只能在消息回调中调用；请求未携带应答topic（或 3.1.1）时返回 false
+  static bool reply(const char *payload);
+
+  // 当前正在处理的消息的接收时间（micros），回调外返回当前时间
+  static uint32_t getReceivedTime();
 
-  // 设置消息回调函数
+  // 流式发布：先声明负载长度，再写入 getWriter()（如 serializeJson）
+  static bool beginPublish(const char *topic, size_t length, bool retained);
+  static Print &getWriter();
+  static bool endPublish();
+
+  // 发布JSON文档：直接序列化到发送缓冲区，不生成中间字符串
+  static bool publishJson(const char *topic, const JsonDocument &doc,
+                          bool retained = false);
+
+  // 订阅/退订topic（由 SubscriptionManager 统一管理）
+  static bool subscribe(const char *topic, uint8_t qos = 0);
+  static bool unsubscribe(const char *topic);
+
+  // 设置消息回调函数（payload 原地以 '\0' 结尾，回调返回后失效）
   static void setCallback(void (*callback)(char *, uint8_t *, unsigned int));
 
   // 生成topic（辅助函数）
   static String getTopic(const char *suffix);
 
+  // 分组命令topic: ac/user_{userId}/group/{group}/cmd
+  static String getGroupTopic(const char *group);
+
   // ✅ 新增：重新订阅topic（用于绑定后更新）
   static void resubscribe();
 
+  // 配置更新后调用：服务器列表变化时断开，由 loop() 连接新的服务器
+  static void applyConfig();
+
+  // 发布各服务器的连接统计（diag/brokers）
+  static void publishBrokerStats();
+
+  // 当前使用的服务器
+  static const BrokerSlot &getCurrentBroker();
+
 private:
-  static WiFiClient wifiClient;
-  static PubSubClient mqttClient;
+#if MQTT_TLS_ENABLED
+  static BearSSL::Session tlsSessions[MQTT_MAX_BROKERS]; // 每个服务器一个会话
+#endif
   static bool connected;
+  static bool attempting;       // 连接尝试进行中（解析或传输层连接）
+  static bool resolving;        // 等待DNS结果
+  static bool usedCachedIp;
+  static unsigned long attemptStart;
   static unsigned long lastReconnectAttempt;
+  static uint32_t reconnectDelay; // 当前重连间隔（全部服务器失败时指数增长）
+  static unsigned long onlineAt;
+
+  // 服务器列表
+  static BrokerSlot brokers[MQTT_MAX_BROKERS];
+  static uint8_t brokerCount;
+  static uint8_t currentBroker;
+  static bool switchPending; // 列表已变化，等待断开当前连接
 
   // 故障回退机制
   static uint8_t eepromFailCount;           // EEPROM 配置连接失败次数
   static bool useDefaultCredentials;        // 是否使用默认凭证
   static const uint8_t MAX_EEPROM_FAIL = 5; // 最多尝试 5 次后回退
 
+  // CONNECT 参数的存储（连接期间保持有效）
+  static String clientId;
+  static String willTopic;
+  static bool usingConfigCredentials;
+
   // MQTT消息回调（内部）
-  static void messageCallback(char *topic, uint8_t *payload,
-                              unsigned int length);
+  static void messageCallback(const MQTTMessage &msg);
 
   // 外部回调函数指针
   static void (*externalCallback)(char *, uint8_t *, unsigned int);
 
-  // 重连
-  static bool reconnect();
+  // 回调期间正在处理的消息（reply 使用）
+  static const MQTTMessage *currentRequest;
+
+  // 连接流程：选择服务器 → 解析地址 → 传输层连接 → 上线
+  static void startAttempt();
+  static void startTransport(IPAddress addr);
+  static void onConnected();
+  static void onAttemptFailed(int8_t error);
+
+  // 从配置加载服务器列表，返回列表是否有变化
+  static bool loadBrokers();
+
+  // 选择下一次连接的服务器
+  static uint8_t selectBroker();
+  static bool isBrokerDown(const BrokerSlot &slot, unsigned long now);
+
+  // 连接失败后计算下一次重连间隔
+  static void backoff();
+
+  // 记录一次连接结果
+  static void recordAttempt(BrokerSlot &slot, bool ok, unsigned long ms);
+
+#if MQTT_TLS_ENABLED
+  // 设置TLS会话和缓冲区（握手在 MQTTTransport::open 中进行）
+  static void prepareTls(uint8_t index, IPAddress addr);
+#endif
 };
 
 #endif // MQTT_CLIENT_H
@@ -0,0 +1,1159 @@
+/*
+ * MQTT传输层 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_MQTT
+
+#include "mqtt_transport.h"
+#if !MQTT_TLS_ENABLED
+#include <lwip/tcp.h>
+#endif
+
+// 报文类型（固定头高4位）
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82 // 含保留标志位 0010
+#define MQTT_SUBACK 0x90
+#define MQTT_UNSUBSCRIBE 0xA2
+#define MQTT_UNSUBACK 0xB0
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+// 流式发布的 Print 适配
+class MQTTPublishWriter : public Print {
+public:
+  size_t write(uint8_t c) override { return MQTTTransport::write(&c, 1); }
+  size_t write(const uint8_t *data, size_t length) override {
+    return MQTTTransport::write(data, length);
+  }
+};
+
+static MQTTPublishWriter publishWriter;
+
+// 变长整数编码（剩余长度、MQTT 5 属性长度），返回字节数
+static size_t encodeVarInt(size_t value, uint8_t *out) {
+  size_t len = 0;
+  do {
+    uint8_t b = value & 0x7F;
+    value >>= 7;
+    out[len++] = value > 0 ? (b | 0x80) : b;
+  } while (value > 0 && len < 4);
+  return len;
+}
+
+#if MQTT_PROTOCOL_VERSION == 5
+// MQTT 5 属性标识
+#define PROP_PAYLOAD_FORMAT 0x01
+#define PROP_CONTENT_TYPE 0x03
+#define PROP_RESPONSE_TOPIC 0x08
+#define PROP_CORRELATION 0x09
+#define PROP_SESSION_EXPIRY 0x11
+#define PROP_REASON_STRING 0x1F
+#define PROP_TOPIC_ALIAS_MAX 0x22
+#define PROP_TOPIC_ALIAS 0x23
+
+static size_t varIntSize(size_t value) {
+  uint8_t buf[4];
+  return encodeVarInt(value, buf);
+}
+
+static bool readVarInt(const uint8_t *&p, const uint8_t *end, size_t &value) {
+  value = 0;
+  for (uint8_t shift = 0; shift < 28; shift += 7) {
+    if (p >= end) {
+      return false;
+    }
+    uint8_t b = *p++;
+    value |= (size_t)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 读取属性块的长度，end 收缩到属性块末尾，p 指向第一个属性
+static bool readPropertyBlock(const uint8_t *&p, const uint8_t *&end) {
+  size_t length;
+  if (!readVarInt(p, end, length) || length > (size_t)(end - p)) {
+    return false;
+  }
+  end = p + length;
+  return true;
+}
+
+// 读取一个属性：value 指向属性值，length 为值的字节数
+// （字符串/二进制属性为内容长度，不含2字节长度前缀）
+static bool readProperty(const uint8_t *&p, const uint8_t *end, uint8_t &id,
+                         const uint8_t *&value, size_t &length) {
+  if (p >= end) {
+    return false;
+  }
+  id = *p++;
+  switch (id) {
+  case 0x01: case 0x17: case 0x19: case 0x24:
+  case 0x25: case 0x28: case 0x29: case 0x2A:
+    length = 1;
+    break;
+  case 0x13: case 0x21: case 0x22: case 0x23:
+    length = 2;
+    break;
+  case 0x02: case 0x11: case 0x18: case 0x27:
+    length = 4;
+    break;
+  case 0x0B: { // 订阅标识符（变长整数）
+    value = p;
+    size_t ignored;
+    if (!readVarInt(p, end, ignored)) {
+      return false;
+    }
+    length = p - value;
+    return true;
+  }
+  case 0x03: case 0x08: case 0x09: case 0x12: case 0x15:
+  case 0x16: case 0x1A: case 0x1C: case 0x1F:
+    if (end - p < 2) {
+      return false;
+    }
+    length = (p[0] << 8) | p[1];
+    p += 2;
+    break;
+  case 0x26: // 用户属性：两个字符串，直接跳过
+    value = p;
+    for (uint8_t i = 0; i < 2; i++) {
+      if (end - p < 2 || (size_t)(end - p) < 2 + (size_t)((p[0] << 8) | p[1])) {
+        return false;
+      }
+      p += 2 + ((p[0] << 8) | p[1]);
+    }
+    length = p - value;
+    return true;
+  default:
+    return false;
+  }
+  if ((size_t)(end - p) < length) {
+    return false;
+  }
+  value = p;
+  p += length;
+  return true;
+}
+
+// CONNACK 原因码转换为 3.1.1 返回码
+static int8_t connackCode(uint8_t reason) {
+  switch (reason) {
+  case 0x84:
+    return MQTT_CONNACK_PROTOCOL;
+  case 0x85:
+    return MQTT_CONNACK_CLIENT_ID;
+  case 0x86:
+  case 0x8C:
+    return MQTT_CONNACK_CREDENTIALS;
+  case 0x87:
+    return MQTT_CONNACK_UNAUTHORIZED;
+  default:
+    return MQTT_CONNACK_UNAVAILABLE;
+  }
+}
+#endif
+
+// 静态成员初始化
+MQTTTransportState MQTTTransport::state = MQTT_TRANSPORT_IDLE;
+int8_t MQTTTransport::lastError = MQTT_ERR_NONE;
+bool MQTTTransport::sessionFlag = false;
+unsigned long MQTTTransport::stateSince = 0;
+MQTTConnectOptions MQTTTransport::options = {};
+MQTTMessageHandler MQTTTransport::handler = nullptr;
+TaskId MQTTTransport::wakeTask = SCHED_INVALID_TASK;
+MQTTTransportStats MQTTTransport::stats = {};
+unsigned long MQTTTransport::lastIn = 0;
+unsigned long MQTTTransport::lastOut = 0;
+bool MQTTTransport::pingOutstanding = false;
+uint16_t MQTTTransport::nextPacketId = 0;
+uint8_t *MQTTTransport::rxBuf = nullptr;
+size_t MQTTTransport::rxLen = 0;
+size_t MQTTTransport::rxCap = 0;
+size_t MQTTTransport::rxSkip = 0;
+bool MQTTTransport::dispatching = false;
+size_t MQTTTransport::publishRemaining = 0;
+volatile bool MQTTTransport::tcpConnected = false;
+volatile bool MQTTTransport::tcpClosed = false;
+volatile int8_t MQTTTransport::tcpError = MQTT_ERR_NONE;
+#if MQTT_PROTOCOL_VERSION == 5
+char MQTTTransport::aliases[MQTT5_TOPIC_ALIAS_MAX][MQTT5_ALIAS_TOPIC_SIZE];
+uint8_t MQTTTransport::aliasCount = 0;
+uint16_t MQTTTransport::aliasLimit = 0;
+#endif
+#if MQTT_TLS_ENABLED
+BearSSL::WiFiClientSecure MQTTTransport::tls;
+#else
+tcp_pcb *MQTTTransport::pcb = nullptr;
+pbuf *MQTTTransport::rxChain = nullptr;
+size_t MQTTTransport::rxChainOffset = 0;
+#endif
+
+void MQTTTransport::setMessageHandler(MQTTMessageHandler h) { handler = h; }
+
+void MQTTTransport::setWakeTask(TaskId task) { wakeTask = task; }
+
+bool MQTTTransport::open(IPAddress addr, uint16_t port,
+                         const MQTTConnectOptions &opts) {
+  teardown();
+
+  options = opts;
+  lastError = MQTT_ERR_NONE;
+  sessionFlag = false;
+  pingOutstanding = false;
+  tcpConnected = false;
+  tcpClosed = false;
+  tcpError = MQTT_ERR_NONE;
+  rxLen = 0;
+  rxSkip = 0;
+  publishRemaining = 0;
+
+  if (!reserve(MQTT_RX_BUFFER_MIN)) {
+    fail(MQTT_ERR_TCP);
+    return false;
+  }
+
+  state = MQTT_TRANSPORT_CONNECTING;
+  stateSince = millis();
+
+#if MQTT_TLS_ENABLED
+  // TLS握手在这里同步完成
+  if (!tls.connect(addr, port)) {
+    fail(MQTT_ERR_TCP);
+    return false;
+  }
+  tcpConnected = true;
+#else
+  pcb = tcp_new();
+  if (pcb == nullptr) {
+    fail(MQTT_ERR_TCP);
+    return false;
+  }
+
+  tcp_nagle_disable(pcb);
+  tcp_arg(pcb, nullptr);
+  tcp_recv(pcb, onTcpRecv);
+  tcp_err(pcb, onTcpError);
+
+  ip_addr_t ip;
+  IP_ADDR4(&ip, addr[0], addr[1], addr[2], addr[3]);
+  if (tcp_connect(pcb, &ip, port, onTcpConnected) != ERR_OK) {
+    fail(MQTT_ERR_TCP);
+    return false;
+  }
+#endif
+
+  wake();
+  return true;
+}
+
+void MQTTTransport::close() {
+  if (state == MQTT_TRANSPORT_CONNECTED) {
+    sendHeader(MQTT_DISCONNECT, 0);
+    flush();
+  }
+  teardown();
+  state = MQTT_TRANSPORT_IDLE;
+}
+
+void MQTTTransport::loop() {
+  if (state == MQTT_TRANSPORT_IDLE || state == MQTT_TRANSPORT_FAILED) {
+    return;
+  }
+
+  unsigned long now = millis();
+
+  // 网络回调记录的事件
+  if (tcpError != MQTT_ERR_NONE) {
+    fail(tcpError);
+    return;
+  }
+
+  if (state == MQTT_TRANSPORT_CONNECTING) {
+    if (tcpConnected) {
+      if (!sendConnect()) {
+        fail(MQTT_ERR_WRITE);
+        return;
+      }
+      state = MQTT_TRANSPORT_CONNACK;
+      stateSince = now;
+    } else if (now - stateSince > MQTT_CONNECT_TIMEOUT) {
+      fail(MQTT_ERR_TIMEOUT);
+      return;
+    }
+  }
+
+  pull();
+  parse();
+  if (state == MQTT_TRANSPORT_IDLE || state == MQTT_TRANSPORT_FAILED) {
+    return;
+  }
+
+#if MQTT_TLS_ENABLED
+  if (tcpClosed && rxLen == 0) {
+#else
+  if (tcpClosed && rxLen == 0 && rxChain == nullptr) {
+#endif
+    fail(MQTT_ERR_CLOSED);
+    return;
+  }
+
+  if (state == MQTT_TRANSPORT_CONNACK) {
+    if (now - stateSince > MQTT_CONNECT_TIMEOUT) {
+      fail(MQTT_ERR_TIMEOUT);
+    }
+    return;
+  }
+
+  // 心跳：收发任一方向空闲超过 keepAlive 时发送 PINGREQ，上一个未响应则断开
+  unsigned long keepAliveMs = (unsigned long)options.keepAlive * 1000UL;
+  if (keepAliveMs > 0 &&
+      (now - lastIn > keepAliveMs || now - lastOut > keepAliveMs)) {
+    if (pingOutstanding) {
+      LOG_PRINTLN(ERROR, "[MQTT] ❌ 心跳无响应");
+      fail(MQTT_ERR_KEEPALIVE);
+      return;
+    }
+    if (sendHeader(MQTT_PINGREQ, 0)) {
+      flush();
+      pingOutstanding = true;
+      lastIn = now; // 从现在开始等待 PINGRESP
+    }
+  }
+}
+
+MQTTTransportState MQTTTransport::getState() { return state; }
+
+bool MQTTTransport::isConnected() {
+  return state == MQTT_TRANSPORT_CONNECTED;
+}
+
+int8_t MQTTTransport::getLastError() { return lastError; }
+
+bool MQTTTransport::sessionPresent() { return sessionFlag; }
+
+bool MQTTTransport::publish(const char *topic, const uint8_t *payload,
+                            size_t length, bool retained,
+                            const MQTTPublishProperties *props) {
+  return beginPublish(topic, length, retained, props) &&
+         write(payload, length) == length && endPublish();
+}
+
+bool MQTTTransport::beginPublish(const char *topic, size_t length,
+                                 bool retained,
+                                 const MQTTPublishProperties *props) {
+  if (state != MQTT_TRANSPORT_CONNECTED || publishRemaining != 0) {
+    return false;
+  }
+
+  uint8_t type = MQTT_PUBLISH | (retained ? 0x01 : 0x00);
+  size_t topicLen = strlen(topic);
+
+#if MQTT_PROTOCOL_VERSION == 5
+  // 已分配别名的topic只发送别名，topic字段为空
+  uint16_t alias = 0;
+  bool assigned = false;
+  if (props != nullptr && props->topicAlias) {
+    alias = topicAlias(topic, assigned);
+  }
+  bool sendTopic = alias == 0 || assigned;
+
+  size_t propLen = 0;
+  if (alias != 0) {
+    propLen += 3;
+  }
+  if (props != nullptr && props->utf8) {
+    propLen += 2;
+  }
+  if (props != nullptr && props->contentType != nullptr) {
+    propLen += 3 + strlen(props->contentType);
+  }
+  if (props != nullptr && props->correlation != nullptr) {
+    propLen += 3 + props->correlationLength;
+  }
+
+  size_t remaining = 2 + (sendTopic ? topicLen : 0) + varIntSize(propLen) +
+                     propLen + length;
+  bool ok = sendHeader(type, remaining) && sendShort(sendTopic ? topicLen : 0) &&
+            (!sendTopic || sendRaw((const uint8_t *)topic, topicLen)) &&
+            sendVarInt(propLen);
+  if (ok && alias != 0) {
+    uint8_t prop[3] = {PROP_TOPIC_ALIAS, (uint8_t)(alias >> 8),
+                       (uint8_t)(alias & 0xFF)};
+    ok = sendRaw(prop, sizeof(prop));
+  }
+  if (ok && props != nullptr && props->utf8) {
+    uint8_t prop[2] = {PROP_PAYLOAD_FORMAT, 0x01};
+    ok = sendRaw(prop, sizeof(prop));
+  }
+  if (ok && props != nullptr && props->contentType != nullptr) {
+    uint8_t id = PROP_CONTENT_TYPE;
+    ok = sendRaw(&id, 1) && sendString(props->contentType);
+  }
+  if (ok && props != nullptr && props->correlation != nullptr) {
+    uint8_t id = PROP_CORRELATION;
+    ok = sendRaw(&id, 1) && sendShort(props->correlationLength) &&
+         sendRaw(props->correlation, props->correlationLength);
+  }
+  if (!ok) {
+    if (assigned) {
+      aliasCount--; // 服务器未收到映射
+    }
+    return false;
+  }
+  if (alias != 0 && !assigned) {
+    stats.aliasHits++;
+    stats.aliasSaved += topicLen > 3 ? topicLen - 3 : 0;
+  }
+#else
+  size_t remaining = 2 + topicLen + length;
+  if (!sendHeader(type, remaining) || !sendString(topic)) {
+    return false;
+  }
+#endif
+  publishRemaining = length;
+  return true;
+}
+
+size_t MQTTTransport::write(const uint8_t *data, size_t length) {
+  if (length > publishRemaining) {
+    length = publishRemaining; // 超出声明长度的部分不能写入
+  }
+  if (length == 0 || !sendRaw(data, length)) {
+    return 0;
+  }
+  publishRemaining -= length;
+  return length;
+}
+
+bool MQTTTransport::endPublish() {
+  if (publishRemaining != 0) {
+    // 实际写入少于声明长度：报文已不完整，只能断开
+    LOG_PRINTF(ERROR, "[MQTT] ❌ 发布长度不符，缺少 %u 字节\n", publishRemaining);
+    publishRemaining = 0;
+    fail(MQTT_ERR_PROTOCOL);
+    return false;
+  }
+  flush();
+  stats.packetsOut++;
+  return true;
+}
+
+Print &MQTTTransport::writer() { return publishWriter; }
+
+bool MQTTTransport::subscribe(const char *topic, uint8_t qos) {
+  if (state != MQTT_TRANSPORT_CONNECTED) {
+    return false;
+  }
+
+  size_t remaining = 2 + 2 + strlen(topic) + 1;
+#if MQTT_PROTOCOL_VERSION == 5
+  remaining += 1; // 属性长度（无属性）
+#endif
+  uint8_t q = qos;
+  if (!sendHeader(MQTT_SUBSCRIBE, remaining) || !sendShort(newPacketId())) {
+    return false;
+  }
+#if MQTT_PROTOCOL_VERSION == 5
+  if (!sendVarInt(0)) {
+    return false;
+  }
+#endif
+  if (!sendString(topic) || !sendRaw(&q, 1)) {
+    return false;
+  }
+  flush();
+  stats.packetsOut++;
+  return true;
+}
+
+bool MQTTTransport::unsubscribe(const char *topic) {
+  if (state != MQTT_TRANSPORT_CONNECTED) {
+    return false;
+  }
+
+  size_t remaining = 2 + 2 + strlen(topic);
+#if MQTT_PROTOCOL_VERSION == 5
+  remaining += 1; // 属性长度（无属性）
+#endif
+  if (!sendHeader(MQTT_UNSUBSCRIBE, remaining) || !sendShort(newPacketId())) {
+    return false;
+  }
+#if MQTT_PROTOCOL_VERSION == 5
+  if (!sendVarInt(0)) {
+    return false;
+  }
+#endif
+  if (!sendString(topic)) {
+    return false;
+  }
+  flush();
+  stats.packetsOut++;
+  return true;
+}
+
+const MQTTTransportStats &MQTTTransport::getStats() { return stats; }
+
+#if MQTT_TLS_ENABLED
+BearSSL::WiFiClientSecure &MQTTTransport::tlsClient() { return tls; }
+#endif
+
+// ===== 网络回调（lwIP 上下文：只记录事件，不做协议处理）=====
+
+#if !MQTT_TLS_ENABLED
+int8_t MQTTTransport::onTcpConnected(void *, tcp_pcb *, int8_t err) {
+  if (err == ERR_OK) {
+    tcpConnected = true;
+  } else {
+    tcpError = MQTT_ERR_TCP;
+  }
+  wake();
+  return ERR_OK;
+}
+
+int8_t MQTTTransport::onTcpRecv(void *, tcp_pcb *, pbuf *p, int8_t err) {
+  if (p == nullptr) {
+    // 对方关闭连接
+    tcpClosed = true;
+  } else if (rxChain == nullptr) {
+    rxChain = p;
+  } else {
+    pbuf_cat(rxChain, p);
+  }
+  // 数据读入缓冲区后才 tcp_recved，处理不过来时由TCP窗口限速
+  wake();
+  return ERR_OK;
+}
+
+void MQTTTransport::onTcpError(void *, int8_t err) {
+  // lwIP 已释放 pcb
+  pcb = nullptr;
+  tcpError = tcpConnected ? MQTT_ERR_CLOSED : MQTT_ERR_TCP;
+  wake();
+}
+
+void MQTTTransport::detach() {
+  if (pcb != nullptr) {
+    tcp_arg(pcb, nullptr);
+    tcp_recv(pcb, nullptr);
+    tcp_err(pcb, nullptr);
+    if (tcp_close(pcb) != ERR_OK) {
+      tcp_abort(pcb);
+    }
+    pcb = nullptr;
+  }
+  if (rxChain != nullptr) {
+    pbuf_free(rxChain);
+    rxChain = nullptr;
+  }
+  rxChainOffset = 0;
+}
+#endif
+
+void MQTTTransport::wake() {
+  if (wakeTask != SCHED_INVALID_TASK) {
+    Scheduler::triggerFromISR(wakeTask);
+  }
+}
+
+void MQTTTransport::fail(int8_t error) {
+  if (state == MQTT_TRANSPORT_FAILED) {
+    return;
+  }
+  DEBUG_PRINTF("[MQTT] 连接结束 (错误 %d)\n", error);
+  teardown();
+  lastError = error;
+  state = MQTT_TRANSPORT_FAILED;
+}
+
+void MQTTTransport::teardown() {
+#if MQTT_TLS_ENABLED
+  tls.stop();
+#else
+  detach();
+#endif
+  tcpConnected = false;
+  publishRemaining = 0;
+  // 正在分发消息时缓冲区仍被引用，由 parse() 结束后释放
+  if (!dispatching) {
+    releaseBuffer();
+  }
+}
+
+void MQTTTransport::releaseBuffer() {
+  free(rxBuf);
+  rxBuf = nullptr;
+  rxLen = 0;
+  rxCap = 0;
+}
+
+bool MQTTTransport::reserve(size_t size) {
+  if (size <= rxCap) {
+    return true;
+  }
+  uint8_t *grown = (uint8_t *)realloc(rxBuf, size);
+  if (grown == nullptr) {
+    LOG_PRINTF(ERROR, "[MQTT] ❌ 接收缓冲区分配失败: %u 字节\n", size);
+    return false;
+  }
+  rxBuf = grown;
+  rxCap = size;
+  if (size > stats.rxPeak) {
+    stats.rxPeak = size;
+  }
+  return true;
+}
+
+// ===== 收包 =====
+
+void MQTTTransport::pull() {
+#if MQTT_TLS_ENABLED
+  while (rxBuf != nullptr) {
+    int available = tls.available();
+    if (available <= 0) {
+      if (!tls.connected()) {
+        tcpClosed = true;
+      }
+      break;
+    }
+
+    // 丢弃超长报文
+    if (rxSkip > 0) {
+      uint8_t scratch[64];
+      size_t n = min((size_t)available, min(rxSkip, sizeof(scratch)));
+      n = tls.read(scratch, n);
+      rxSkip -= n;
+      stats.bytesIn += n;
+      continue;
+    }
+
+    size_t room = rxCap - rxLen;
+    if (room == 0) {
+      break;
+    }
+    size_t n = tls.read(rxBuf + rxLen, min((size_t)available, room));
+    if (n == 0) {
+      break;
+    }
+    rxLen += n;
+    stats.bytesIn += n;
+  }
+#else
+  while (rxChain != nullptr && rxBuf != nullptr) {
+    size_t available = rxChain->len - rxChainOffset;
+    size_t n;
+
+    if (rxSkip > 0) {
+      // 丢弃超长报文
+      n = min(available, rxSkip);
+      rxSkip -= n;
+    } else {
+      size_t room = rxCap - rxLen;
+      if (room == 0) {
+        break;
+      }
+      n = min(available, room);
+      memcpy(rxBuf + rxLen, (uint8_t *)rxChain->payload + rxChainOffset, n);
+      rxLen += n;
+    }
+
+    stats.bytesIn += n;
+    rxChainOffset += n;
+    if (pcb != nullptr) {
+      tcp_recved(pcb, n);
+    }
+
+    // 当前 pbuf 读完，释放并转到下一个
+    if (rxChainOffset == rxChain->len) {
+      pbuf *head = rxChain;
+      rxChain = head->next;
+      rxChainOffset = 0;
+      if (rxChain != nullptr) {
+        pbuf_ref(rxChain);
+      }
+      pbuf_free(head);
+    }
+  }
+#endif
+}
+
+void MQTTTransport::parse() {
+  size_t offset = 0;
+  dispatching = true;
+
+  while (rxLen - offset >= 2) {
+    uint8_t *packet = rxBuf + offset;
+    size_t avail = rxLen - offset;
+
+    // 剩余长度（1-4字节变长编码）
+    size_t remaining = 0;
+    size_t headerLen = 1;
+    uint32_t multiplier = 1;
+    bool complete = false;
+    while (headerLen < avail && headerLen <= 4) {
+      uint8_t b = packet[headerLen++];
+      remaining += (b & 0x7F) * multiplier;
+      multiplier <<= 7;
+      if ((b & 0x80) == 0) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      if (headerLen > 4) {
+        fail(MQTT_ERR_PROTOCOL);
+        break;
+      }
+      break; // 固定头未收全
+    }
+
+    size_t total = headerLen + remaining;
+
+    // 超长报文：丢弃（已在缓冲区中的部分跳过，其余在 pull() 中丢弃）
+    if (total + 1 > MQTT_BUFFER_SIZE) {
+      LOG_PRINTF(WARN, "[MQTT] ⚠️ 报文过长 (%u 字节)，丢弃\n", total);
+      stats.oversize++;
+      size_t have = min(avail, total);
+      rxSkip = total - have;
+      offset += have;
+      continue;
+    }
+
+    // 原地解析需要在报文后多留1字节写入结束符
+    if (offset + total + 1 > rxCap) {
+      if (offset > 0) {
+        // 先把前面已处理的报文移出，再判断是否需要扩容
+        rxLen -= offset;
+        memmove(rxBuf, rxBuf + offset, rxLen);
+        offset = 0;
+        continue;
+      }
+      if (!reserve(total + 1)) {
+        fail(MQTT_ERR_PROTOCOL);
+        break;
+      }
+    }
+    if (avail < total) {
+      break; // 报文未收全
+    }
+
+    lastIn = millis();
+    stats.packetsIn++;
+    handlePacket(packet, headerLen, total);
+    offset += total;
+
+    if (state == MQTT_TRANSPORT_IDLE || state == MQTT_TRANSPORT_FAILED) {
+      break;
+    }
+  }
+
+  dispatching = false;
+
+  // 回调中连接已关闭：释放缓冲区
+  if (state == MQTT_TRANSPORT_IDLE || state == MQTT_TRANSPORT_FAILED) {
+    releaseBuffer();
+    return;
+  }
+
+  // 未处理的数据移到缓冲区开头
+  if (offset > 0) {
+    rxLen -= offset;
+    memmove(rxBuf, rxBuf + offset, rxLen);
+  }
+
+  // 处理完较大的报文后缩回最小尺寸
+  if (rxCap > MQTT_RX_BUFFER_MIN && rxLen == 0) {
+    uint8_t *shrunk = (uint8_t *)realloc(rxBuf, MQTT_RX_BUFFER_MIN);
+    if (shrunk != nullptr) {
+      rxBuf = shrunk;
+      rxCap = MQTT_RX_BUFFER_MIN;
+    }
+  }
+
+  // 缓冲区腾出空间后继续读入
+#if !MQTT_TLS_ENABLED
+  if (rxChain != nullptr) {
+    wake();
+  }
+#endif
+}
+
+void MQTTTransport::handlePacket(uint8_t *packet, size_t headerLen,
+                                 size_t total) {
+  uint8_t header = packet[0];
+  uint8_t *body = packet + headerLen;
+  size_t length = total - headerLen;
+
+  switch (header & 0xF0) {
+  case MQTT_CONNACK:
+    if (state != MQTT_TRANSPORT_CONNACK || length < 2) {
+      fail(MQTT_ERR_PROTOCOL);
+      return;
+    }
+#if MQTT_PROTOCOL_VERSION == 5
+    if (body[1] >= 0x80) {
+      LOG_PRINTF(ERROR, "[MQTT] ❌ 服务器拒绝连接，原因码: 0x%02X\n", body[1]);
+      fail(connackCode(body[1]));
+      return;
+    } else {
+      // 服务器允许的主题别名数（未声明时为0，不使用别名）
+      const uint8_t *p = body + 2;
+      const uint8_t *end = body + length;
+      if (!readPropertyBlock(p, end)) {
+        fail(MQTT_ERR_PROTOCOL);
+        return;
+      }
+      while (p < end) {
+        uint8_t id;
+        const uint8_t *value;
+        size_t n;
+        if (!readProperty(p, end, id, value, n)) {
+          fail(MQTT_ERR_PROTOCOL);
+          return;
+        }
+        if (id == PROP_TOPIC_ALIAS_MAX) {
+          aliasLimit = min((uint16_t)((value[0] << 8) | value[1]),
+                           (uint16_t)MQTT5_TOPIC_ALIAS_MAX);
+        }
+      }
+      DEBUG_PRINTF("[MQTT] MQTT 5 主题别名: %u 个\n", aliasLimit);
+    }
+#else
+    if (body[1] != 0) {
+      LOG_PRINTF(ERROR, "[MQTT] ❌ 服务器拒绝连接，返回码: %d\n", body[1]);
+      fail(body[1]);
+      return;
+    }
+#endif
+    sessionFlag = body[0] & 0x01;
+    state = MQTT_TRANSPORT_CONNECTED;
+    stateSince = millis();
+    lastOut = lastIn = stateSince;
+    break;
+
+  case MQTT_PUBLISH:
+    handlePublish(header, body, length);
+    break;
+
+  case MQTT_SUBACK: {
+    const uint8_t *p = body + 2;
+    const uint8_t *end = body + length;
+#if MQTT_PROTOCOL_VERSION == 5
+    if (length < 2 || !readPropertyBlock(p, end)) {
+      fail(MQTT_ERR_PROTOCOL);
+      return;
+    }
+    p = end;
+    end = body + length;
+#endif
+    // 返回码 0x80 及以上表示该topic订阅失败
+    if (p < end && *p >= 0x80) {
+      LOG_PRINTLN(WARN, "[MQTT] ⚠️ 服务器拒绝订阅");
+    }
+    break;
+  }
+
+  case MQTT_DISCONNECT:
+    // MQTT 5 服务器主动断开（3.1.1 服务器不会发送）
+    LOG_PRINTF(WARN, "[MQTT] ⚠️ 服务器断开连接，原因码: 0x%02X\n",
+               length > 0 ? body[0] : 0);
+    fail(MQTT_ERR_CLOSED);
+    return;
+
+  case MQTT_PINGRESP:
+    pingOutstanding = false;
+    break;
+
+  default:
+    // PUBACK/UNSUBACK 等：本设备只发布QoS0，无需处理
+    break;
+  }
+}
+
+void MQTTTransport::handlePublish(uint8_t header, uint8_t *body,
+                                  size_t length) {
+  MQTTMessage msg;
+  msg.receivedUs = micros();
+  msg.qos = (header >> 1) & 0x03;
+  msg.retained = header & 0x01;
+  msg.dup = header & 0x08;
+  msg.msgId = 0;
+
+  if (length < 2) {
+    fail(MQTT_ERR_PROTOCOL);
+    return;
+  }
+  size_t topicLen = (body[0] << 8) | body[1];
+  size_t idLen = msg.qos > 0 ? 2 : 0;
+  if (2 + topicLen + idLen > length) {
+    fail(MQTT_ERR_PROTOCOL);
+    return;
+  }
+
+  uint8_t *payload = body + 2 + topicLen + idLen;
+  if (idLen > 0) {
+    msg.msgId = (body[2 + topicLen] << 8) | body[3 + topicLen];
+  }
+  msg.responseTopic = nullptr;
+  msg.responseTopicLength = 0;
+  msg.correlation = nullptr;
+  msg.correlationLength = 0;
+
+#if MQTT_PROTOCOL_VERSION == 5
+  // 属性：只取请求/应答所需的 Response Topic 和 Correlation Data
+  const uint8_t *p = payload;
+  const uint8_t *end = body + length;
+  if (!readPropertyBlock(p, end)) {
+    fail(MQTT_ERR_PROTOCOL);
+    return;
+  }
+  while (p < end) {
+    uint8_t id;
+    const uint8_t *value;
+    size_t n;
+    if (!readProperty(p, end, id, value, n)) {
+      fail(MQTT_ERR_PROTOCOL);
+      return;
+    }
+    if (id == PROP_RESPONSE_TOPIC) {
+      msg.responseTopic = (const char *)value;
+      msg.responseTopicLength = n;
+    } else if (id == PROP_CORRELATION) {
+      msg.correlation = value;
+      msg.correlationLength = n;
+    }
+  }
+  payload = (uint8_t *)end;
+
+  // topic 后面总有消息ID或属性长度（都已读出），结束符写在那里
+  msg.topic = (char *)body + 2;
+#else
+  if (idLen > 0) {
+    // 消息ID已读出，结束符直接写在它的位置
+    msg.topic = (char *)body + 2;
+  } else {
+    // topic 前移一字节（覆盖长度字段），腾出结束符的位置
+    memmove(body + 1, body + 2, topicLen);
+    msg.topic = (char *)body + 1;
+  }
+#endif
+  msg.topic[topicLen] = '\0';
+
+  // 负载后的1字节属于下一个报文（或空闲区），临时写入结束符
+  msg.length = length - (payload - body);
+  msg.payload = payload;
+  uint8_t saved = payload[msg.length];
+  payload[msg.length] = '\0';
+
+  if (handler != nullptr) {
+    handler(msg);
+  }
+
+  if (rxBuf != nullptr) {
+    payload[msg.length] = saved;
+  }
+
+  // 回调处理完再确认：处理前掉线时服务器会重发
+  if (msg.qos == 1 && state == MQTT_TRANSPORT_CONNECTED) {
+    sendAck(MQTT_PUBACK, msg.msgId);
+  } else if (msg.qos == 2) {
+    LOG_PRINTLN(WARN, "[MQTT] ⚠️ 不支持QoS2消息");
+  }
+}
+
+// ===== 发包 =====
+
+bool MQTTTransport::sendRaw(const uint8_t *data, size_t length) {
+  if (state != MQTT_TRANSPORT_CONNECTED && state != MQTT_TRANSPORT_CONNACK &&
+      state != MQTT_TRANSPORT_CONNECTING) {
+    return false;
+  }
+
+#if MQTT_TLS_ENABLED
+  if (tls.write(data, length) != length) {
+    fail(MQTT_ERR_WRITE);
+    return false;
+  }
+#else
+  unsigned long start = millis();
+  bool stalled = false;
+  while (length > 0) {
+    if (pcb == nullptr) {
+      return false;
+    }
+
+    size_t room = tcp_sndbuf(pcb);
+    size_t n = min(length, room);
+    if (n > 0 && tcp_write(pcb, data, n, TCP_WRITE_FLAG_COPY) == ERR_OK) {
+      data += n;
+      length -= n;
+      stats.bytesOut += n;
+      continue;
+    }
+
+    // 发送缓冲区已满：推出已排队的数据，短暂让出CPU等待ACK
+    if (!stalled) {
+      stalled = true;
+      stats.writeStalls++;
+    }
+    tcp_output(pcb);
+    if (millis() - start > MQTT_WRITE_TIMEOUT) {
+      fail(MQTT_ERR_WRITE);
+      return false;
+    }
+    delay(1);
+  }
+#endif
+
+  lastOut = millis();
+  return true;
+}
+
+bool MQTTTransport::sendHeader(uint8_t type, size_t remaining) {
+  uint8_t header[5];
+  header[0] = type;
+  return sendRaw(header, 1 + encodeVarInt(remaining, header + 1));
+}
+
+bool MQTTTransport::sendVarInt(size_t value) {
+  uint8_t buf[4];
+  return sendRaw(buf, encodeVarInt(value, buf));
+}
+
+bool MQTTTransport::sendString(const char *str) {
+  size_t len = strlen(str);
+  return sendShort(len) && sendRaw((const uint8_t *)str, len);
+}
+
+bool MQTTTransport::sendShort(uint16_t value) {
+  uint8_t buf[2] = {(uint8_t)(value >> 8), (uint8_t)(value & 0xFF)};
+  return sendRaw(buf, 2);
+}
+
+void MQTTTransport::flush() {
+#if MQTT_TLS_ENABLED
+  tls.flush();
+#else
+  if (pcb != nullptr) {
+    tcp_output(pcb);
+  }
+#endif
+}
+
+bool MQTTTransport::sendConnect() {
+  static const uint8_t protocol[] = {0x00, 0x04, 'M', 'Q', 'T', 'T',
+                                     MQTT_PROTOCOL_VERSION};
+
+#if MQTT_PROTOCOL_VERSION == 5
+  // 别名只在一次连接内有效，上限等 CONNACK 重新告知
+  aliasCount = 0;
+  aliasLimit = 0;
+#endif
+
+  bool hasWill = options.willTopic != nullptr;
+  bool hasUser = options.user != nullptr && options.user[0] != '\0';
+  bool hasPass = hasUser && options.password != nullptr;
+
+  uint8_t flags = options.cleanSession ? 0x02 : 0x00;
+  size_t remaining = sizeof(protocol) + 1 + 2 + 2 + strlen(options.clientId);
+  if (hasWill) {
+    flags |= 0x04 | (options.willQos << 3) | (options.willRetain ? 0x20 : 0);
+    remaining += 2 + strlen(options.willTopic) + 2 + strlen(options.willMessage);
+  }
+  if (hasUser) {
+    flags |= 0x80;
+    remaining += 2 + strlen(options.user);
+  }
+  if (hasPass) {
+    flags |= 0x40;
+    remaining += 2 + strlen(options.password);
+  }
+
+#if MQTT_PROTOCOL_VERSION == 5
+  // MQTT 5 默认断开即清除会话，持久会话需要声明保留时间
+  uint8_t props[5];
+  size_t propLen = 0;
+  if (!options.cleanSession) {
+    uint32_t expiry = MQTT5_SESSION_EXPIRY;
+    props[0] = PROP_SESSION_EXPIRY;
+    props[1] = expiry >> 24;
+    props[2] = (expiry >> 16) & 0xFF;
+    props[3] = (expiry >> 8) & 0xFF;
+    props[4] = expiry & 0xFF;
+    propLen = 5;
+  }
+  remaining += 1 + propLen;
+  if (hasWill) {
+    remaining += 1; // 遗嘱属性长度（无属性）
+  }
+#endif
+
+  bool ok = sendHeader(MQTT_CONNECT, remaining) &&
+            sendRaw(protocol, sizeof(protocol)) && sendRaw(&flags, 1) &&
+            sendShort(options.keepAlive);
+#if MQTT_PROTOCOL_VERSION == 5
+  ok = ok && sendVarInt(propLen) && sendRaw(props, propLen);
+#endif
+  ok = ok && sendString(options.clientId);
+#if MQTT_PROTOCOL_VERSION == 5
+  ok = ok && (!hasWill || sendVarInt(0));
+#endif
+  if (ok && hasWill) {
+    ok = sendString(options.willTopic) && sendString(options.willMessage);
+  }
+  if (ok && hasUser) {
+    ok = sendString(options.user);
+  }
+  if (ok && hasPass) {
+    ok = sendString(options.password);
+  }
+  if (ok) {
+    flush();
+    stats.packetsOut++;
+  }
+  return ok;
+}
+
+bool MQTTTransport::sendAck(uint8_t type, uint16_t packetId) {
+  uint8_t ack[4] = {type, 0x02, (uint8_t)(packetId >> 8),
+                    (uint8_t)(packetId & 0xFF)};
+  if (!sendRaw(ack, sizeof(ack))) {
+    return false;
+  }
+  flush();
+  stats.packetsOut++;
+  return true;
+}
+
+#if MQTT_PROTOCOL_VERSION == 5
+uint16_t MQTTTransport::topicAlias(const char *topic, bool &assigned) {
+  assigned = false;
+  for (uint8_t i = 0; i < aliasCount; i++) {
+    if (strcmp(aliases[i], topic) == 0) {
+      return i + 1;
+    }
+  }
+
+  // 新分配：本次发布同时携带topic和别名，之后只发送别名
+  if (aliasCount >= min(aliasLimit, (uint16_t)MQTT5_TOPIC_ALIAS_MAX) ||
+      strlen(topic) >= MQTT5_ALIAS_TOPIC_SIZE) {
+    return 0;
+  }
+  strcpy(aliases[aliasCount], topic);
+  assigned = true;
+  return ++aliasCount;
+}
+#endif
+
+uint16_t MQTTTransport::newPacketId() {
+  if (++nextPacketId == 0) {
+    nextPacketId = 1;
+  }
+  return nextPacketId;
+}
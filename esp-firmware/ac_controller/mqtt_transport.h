@@ -0,0 +1,244 @@
+/*
+ * MQTT传输层（MQTT 3.1.1）
+ *
+ * 功能：
+ * - 基于 lwIP raw TCP 的非阻塞连接：连接、收包、断开都通过回调通知，
+ *   回调只记录事件并唤醒 mqtt 任务，协议处理在 loop() 中进行
+ * - 接收缓冲区按需分配和扩容（上限 MQTT_BUFFER_SIZE），断开后释放
+ * - 收到的 PUBLISH 在缓冲区内原地解析：topic 和负载都以 '\0' 结尾，不复制
+ * - 发布通过流式写入直接进入TCP发送缓冲区，不拼接整包
+ * - MQTT_PROTOCOL_VERSION 5 时使用 MQTT 5：反复发布的topic分配主题别名，
+ *   之后只发送2字节别名；发布可携带负载格式/内容类型；收到的请求
+ *   带 Response Topic / Correlation Data 时可直接应答
+ * - MQTT_TLS_ENABLED 时改用 BearSSL::WiFiClientSecure（TLS握手本身是同步计算，
+ *   连接阶段会阻塞；收发仍在 loop() 中轮询）
+ *
+ * 只由 MQTTClient 使用，其他模块通过 MQTTClient 的接口发布/订阅。
+ */
+
+#ifndef MQTT_TRANSPORT_H
+#define MQTT_TRANSPORT_H
+
+#include "config.h"
+#include "scheduler.h"
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#if MQTT_TLS_ENABLED
+#include <WiFiClientSecure.h>
+#endif
+
+struct tcp_pcb;
+struct pbuf;
+
+// 传输层状态
+enum MQTTTransportState : uint8_t {
+  MQTT_TRANSPORT_IDLE,       // 未连接
+  MQTT_TRANSPORT_CONNECTING, // TCP连接中
+  MQTT_TRANSPORT_CONNACK,    // 已发送CONNECT，等待CONNACK
+  MQTT_TRANSPORT_CONNECTED,  // 已连接
+  MQTT_TRANSPORT_FAILED      // 连接失败或断开（见 getLastError）
+};
+
+// 失败原因（正数为 CONNACK 返回码）
+enum MQTTTransportError : int8_t {
+  MQTT_ERR_NONE = 0,
+  MQTT_ERR_TCP = -1,       // TCP连接失败
+  MQTT_ERR_TIMEOUT = -2,   // 连接或CONNACK超时
+  MQTT_ERR_CLOSED = -3,    // 连接被关闭
+  MQTT_ERR_PROTOCOL = -4,  // 报文格式错误
+  MQTT_ERR_KEEPALIVE = -5, // 心跳无响应
+  MQTT_ERR_WRITE = -6,     // 发送缓冲区长时间已满
+};
+
+// MQTT 5 CONNACK 原因码映射到 3.1.1 返回码（MQTTClient 只处理后者）
+enum MQTTConnackCode : uint8_t {
+  MQTT_CONNACK_PROTOCOL = 1,    // 不支持的协议版本
+  MQTT_CONNACK_CLIENT_ID = 2,   // 客户端ID无效
+  MQTT_CONNACK_UNAVAILABLE = 3, // 服务器不可用
+  MQTT_CONNACK_CREDENTIALS = 4, // 用户名或密码错误
+  MQTT_CONNACK_UNAUTHORIZED = 5 // 未授权
+};
+
+// CONNECT 参数（指针在连接完成前必须保持有效）
+struct MQTTConnectOptions {
+  const char *clientId;
+  const char *user;
+  const char *password;
+  const char *willTopic;
+  const char *willMessage;
+  uint8_t willQos;
+  bool willRetain;
+  bool cleanSession;
+  uint16_t keepAlive; // 秒
+};
+
+// 收到的消息（指向接收缓冲区，回调返回后失效）
+struct MQTTMessage {
+  char *topic;
+  uint8_t *payload; // 以 '\0' 结尾
+  unsigned int length;
+  uint8_t qos;
+  bool retained;
+  bool dup;
+  uint16_t msgId; // QoS0 为 0
+  uint32_t receivedUs; // 报文收全、开始处理的时间（micros）
+
+  // MQTT 5 请求/应答（未携带或 3.1.1 时为 nullptr，字符串不以 '\0' 结尾）
+  const char *responseTopic;
+  uint16_t responseTopicLength;
+  const uint8_t *correlation;
+  uint16_t correlationLength;
+};
+
+// 发布属性（仅 MQTT 5 生效，3.1.1 时忽略）
+struct MQTTPublishProperties {
+  bool topicAlias;          // 允许为该topic分配主题别名（反复发布的设备topic）
+  bool utf8;                // Payload Format Indicator=1（JSON等文本负载）
+  const char *contentType;  // 内容类型（如二进制负载），nullptr=不发送
+  const uint8_t *correlation; // 应答时回传请求的 Correlation Data
+  uint16_t correlationLength;
+};
+
+typedef void (*MQTTMessageHandler)(const MQTTMessage &message);
+
+// 传输统计
+struct MQTTTransportStats {
+  uint32_t packetsIn;
+  uint32_t packetsOut;
+  uint32_t bytesIn;
+  uint32_t bytesOut;
+  uint32_t oversize;    // 超过 MQTT_BUFFER_SIZE 被丢弃的报文
+  uint32_t writeStalls; // 发送缓冲区已满需要等待的次数
+  uint16_t rxPeak;      // 接收缓冲区峰值
+  uint32_t aliasHits;   // 使用已分配别名的发布（MQTT 5）
+  uint32_t aliasSaved;  // 别名节省的字节数（topic长度减去别名属性）
+};
+
+class MQTTTransport {
+public:
+  static void setMessageHandler(MQTTMessageHandler handler);
+
+  // 网络事件发生时唤醒的任务（通常是 mqtt 任务）
+  static void setWakeTask(TaskId task);
+
+  // 开始连接（立即返回，结果通过 getState 查询）
+  static bool open(IPAddress addr, uint16_t port,
+                   const MQTTConnectOptions &options);
+
+  // 关闭连接（已连接时先发送 DISCONNECT）
+  static void close();
+
+  // 处理连接事件、收包、心跳（在 mqtt 任务中调用）
+  static void loop();
+
+  static MQTTTransportState getState();
+  static bool isConnected();
+  static int8_t getLastError();
+
+  // 服务器是否保留了上次的会话（CONNACK Session Present）
+  static bool sessionPresent();
+
+  // 发布（QoS0）
+  static bool publish(const char *topic, const uint8_t *payload,
+                      size_t length, bool retained,
+                      const MQTTPublishProperties *props = nullptr);
+
+  // 流式发布：begin 声明负载长度，随后分段 write，最后 end 校验长度
+  static bool beginPublish(const char *topic, size_t length, bool retained,
+                           const MQTTPublishProperties *props = nullptr);
+  static size_t write(const uint8_t *data, size_t length);
+  static bool endPublish();
+
+  // 流式发布的 Print 适配（可直接 serializeJson 到这里）
+  static Print &writer();
+
+  static bool subscribe(const char *topic, uint8_t qos);
+  static bool unsubscribe(const char *topic);
+
+  static const MQTTTransportStats &getStats();
+
+#if MQTT_TLS_ENABLED
+  // TLS连接对象（连接前由 MQTTClient 设置会话和缓冲区大小）
+  static BearSSL::WiFiClientSecure &tlsClient();
+#endif
+
+private:
+  static MQTTTransportState state;
+  static int8_t lastError;
+  static bool sessionFlag;
+  static unsigned long stateSince;
+  static MQTTConnectOptions options;
+  static MQTTMessageHandler handler;
+  static TaskId wakeTask;
+  static MQTTTransportStats stats;
+
+  // 心跳
+  static unsigned long lastIn;
+  static unsigned long lastOut;
+  static bool pingOutstanding;
+  static uint16_t nextPacketId;
+
+  // 接收缓冲区（按需分配）
+  static uint8_t *rxBuf;
+  static size_t rxLen;
+  static size_t rxCap;
+  static size_t rxSkip;  // 正在丢弃的超长报文剩余字节
+  static bool dispatching;
+
+  // 流式发布剩余字节
+  static size_t publishRemaining;
+
+#if MQTT_PROTOCOL_VERSION == 5
+  // 主题别名表（第 i 项对应别名 i+1，每次连接重新分配）
+  static char aliases[MQTT5_TOPIC_ALIAS_MAX][MQTT5_ALIAS_TOPIC_SIZE];
+  static uint8_t aliasCount;
+  static uint16_t aliasLimit; // 服务器 CONNACK 允许的别名数
+
+  // 查找或分配别名（0=不使用别名），assigned 表示本次新分配
+  static uint16_t topicAlias(const char *topic, bool &assigned);
+#endif
+
+  // 由网络回调设置，在 loop() 中处理
+  static volatile bool tcpConnected;
+  static volatile bool tcpClosed;
+  static volatile int8_t tcpError;
+
+#if MQTT_TLS_ENABLED
+  static BearSSL::WiFiClientSecure tls;
+#else
+  static tcp_pcb *pcb;
+  static pbuf *rxChain; // 已收到但未读入缓冲区的数据
+  static size_t rxChainOffset;
+
+  static int8_t onTcpConnected(void *arg, tcp_pcb *tpcb, int8_t err);
+  static int8_t onTcpRecv(void *arg, tcp_pcb *tpcb, pbuf *p, int8_t err);
+  static void onTcpError(void *arg, int8_t err);
+  static void detach();
+#endif
+
+  static void wake();
+  static void fail(int8_t error);
+  static void teardown();
+  static void releaseBuffer();
+  static bool reserve(size_t size);
+
+  // 收包
+  static void pull();
+  static void parse();
+  static void handlePacket(uint8_t *packet, size_t headerLen, size_t total);
+  static void handlePublish(uint8_t header, uint8_t *body, size_t length);
+
+  // 发包
+  static bool sendRaw(const uint8_t *data, size_t length);
+  static bool sendHeader(uint8_t type, size_t remaining);
+  static bool sendString(const char *str);
+  static bool sendShort(uint16_t value);
+  static bool sendVarInt(size_t value);
+  static void flush();
+  static bool sendConnect();
+  static bool sendAck(uint8_t type, uint16_t packetId);
+
+  static uint16_t newPacketId();
+};
+
+#endif // MQTT_TRANSPORT_H
@@ -0,0 +1,96 @@
+/*
+ * 网络连接缓存 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_WIFI
+
+#include "net_cache.h"
+#include "checksum.h"
+#include "kv_store.h"
+#include <ESP8266WiFi.h>
+
+static const uint32_t RTC_NET_MAGIC = 0x4E455443; // "NETC"
+
+// 静态成员初始化
+NetCacheData NetCache::data;
+
+void NetCache::init() {
+  static_assert(sizeof(RtcBlock) % 4 == 0, "RTC内存按4字节块访问");
+
+  memset(&data, 0, sizeof(data));
+
+  RtcBlock block;
+  if (ESP.rtcUserMemoryRead(RTC_NET_OFFSET, (uint32_t *)&block,
+                            sizeof(block)) &&
+      block.magic == RTC_NET_MAGIC &&
+      block.crc == Checksum::crc32(&block, offsetof(RtcBlock, crc))) {
+    data = block.data;
+    DEBUG_PRINTLN("[网络缓存] 从RTC内存加载");
+  } else if (KVStore::get(KV_KEY_NET_CACHE, &data, sizeof(data)) ==
+             (int)sizeof(data)) {
+    DEBUG_PRINTLN("[网络缓存] 从Flash加载");
+  } else {
+    memset(&data, 0, sizeof(data));
+    DEBUG_PRINTLN("[网络缓存] 无缓存");
+    return;
+  }
+
+  if (data.valid) {
+    DEBUG_PRINTF("[网络缓存] BSSID: %02X:%02X:%02X:%02X:%02X:%02X, 信道: %d\n",
+                 data.bssid[0], data.bssid[1], data.bssid[2], data.bssid[3],
+                 data.bssid[4], data.bssid[5], data.channel);
+  }
+}
+
+bool NetCache::hasWiFi(const char *ssid) {
+  return data.valid && data.channel != 0 &&
+         data.ssidCrc == Checksum::crc32(ssid, strlen(ssid));
+}
+
+const NetCacheData &NetCache::get() { return data; }
+
+void NetCache::saveWiFi(const char *ssid) {
+  data.ssidCrc = Checksum::crc32(ssid, strlen(ssid));
+  memcpy(data.bssid, WiFi.BSSID(), sizeof(data.bssid));
+  data.channel = WiFi.channel();
+  data.valid = 1;
+  store();
+}
+
+void NetCache::invalidateWiFi() {
+  if (!data.valid)
+    return;
+  data.valid = 0;
+  store();
+}
+
+uint32_t NetCache::getBrokerIp(const char *host) {
+  if (data.brokerIp == 0 ||
+      data.brokerHostCrc != Checksum::crc32(host, strlen(host)))
+    return 0;
+  return data.brokerIp;
+}
+
+void NetCache::saveBrokerIp(const char *host, uint32_t ip) {
+  data.brokerHostCrc = Checksum::crc32(host, strlen(host));
+  data.brokerIp = ip;
+  store();
+}
+
+void NetCache::invalidateBroker() {
+  if (data.brokerIp == 0)
+    return;
+  data.brokerIp = 0;
+  store();
+}
+
+void NetCache::store() {
+  RtcBlock block;
+  block.magic = RTC_NET_MAGIC;
+  block.data = data;
+  block.crc = Checksum::crc32(&block, offsetof(RtcBlock, crc));
+  ESP.rtcUserMemoryWrite(RTC_NET_OFFSET, (uint32_t *)&block, sizeof(block));
+
+  // 重连通常得到相同的参数，KVStore 会跳过未变化的写入
+  KVStore::put(KV_KEY_NET_CACHE, &data, sizeof(data));
+}
@@ -0,0 +1,59 @@
+/*
+ * 网络连接缓存
+ *
+ * 功能：
+ * - 记录上次成功连接的 BSSID 和信道（地址仍由DHCP分配）
+ * - 记录解析后的 MQTT 服务器地址（跳过DNS）
+ * - RTC内存保存（热重启），键值存储保存（断电重启）
+ */
+
+#ifndef NET_CACHE_H
+#define NET_CACHE_H
+
+#include "config.h"
+#include <Arduino.h>
+
+// 缓存内容（KV_KEY_NET_CACHE 和 RTC 内存共用）
+struct NetCacheData {
+  uint32_t ssidCrc; // 对应的SSID（凭证变化后缓存失效）
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t valid;   // WiFi部分有效
+  uint32_t brokerHostCrc; // 对应的MQTT服务器主机名
+  uint32_t brokerIp;      // 0=未缓存
+};
+
+class NetCache {
+public:
+  // 加载缓存（RTC内存优先，其次Flash）
+  static void init();
+
+  // 缓存的WiFi参数是否适用于该SSID
+  static bool hasWiFi(const char *ssid);
+  static const NetCacheData &get();
+
+  // 连接成功后记录当前WiFi参数
+  static void saveWiFi(const char *ssid);
+
+  // 快速连接失败后清除WiFi部分
+  static void invalidateWiFi();
+
+  // MQTT服务器地址缓存
+  static uint32_t getBrokerIp(const char *host);
+  static void saveBrokerIp(const char *host, uint32_t ip);
+  static void invalidateBroker();
+
+private:
+  static NetCacheData data;
+
+  struct RtcBlock {
+    uint32_t magic;
+    NetCacheData data;
+    uint32_t crc;
+  };
+
+  // 写入RTC内存和Flash（值未变化时Flash不写入）
+  static void store();
+};
+
+#endif // NET_CACHE_H
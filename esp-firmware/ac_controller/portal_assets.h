@@ -0,0 +1,71 @@
+/*
+ * 配网门户资源（gzip压缩，存放在Flash）
+ *
+ * 由 tools/gen_portal_assets.py 生成，请勿手动修改
+ */
+
+#ifndef PORTAL_ASSETS_H
+#define PORTAL_ASSETS_H
+
+#include <Arduino.h>
+
+// index.html: 1590 -> 859 字节
+static const uint8_t PORTAL_INDEX_HTML_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x55, 0xef, 0x6f, 0xdb, 0x36,
+    0x10, 0xfd, 0xee, 0xbf, 0x82, 0x65, 0xb0, 0x48, 0x42, 0x6c, 0x5a, 0x71, 0x83, 0x6d, 0xd0, 0x8f,
+    0x0c, 0x6b, 0x9a, 0xad, 0x05, 0xba, 0x26, 0x40, 0x02, 0x0c, 0xfb, 0x48, 0x8b, 0x27, 0x8b, 0xab,
+    0x44, 0xaa, 0x24, 0x95, 0xc4, 0x35, 0xfc, 0xbf, 0xf7, 0x28, 0xca, 0x49, 0x96, 0x74, 0x5f, 0x4c,
+    0xf2, 0x78, 0x7a, 0x77, 0xef, 0xdd, 0x93, 0x5c, 0xbc, 0x79, 0x7f, 0x75, 0x71, 0xfb, 0xcf, 0xf5,
+    0x25, 0x69, 0x5c, 0xd7, 0x9e, 0xcf, 0x8a, 0xc3, 0x02, 0x5c, 0xe0, 0xd2, 0x81, 0xe3, 0xa4, 0x6a,
+    0xb8, 0xb1, 0xe0, 0x4a, 0x3a, 0xb8, 0x7a, 0xf1, 0x2b, 0x3d, 0x84, 0x15, 0xef, 0xa0, 0xa4, 0x77,
+    0x12, 0xee, 0x7b, 0x6d, 0x1c, 0x25, 0x95, 0x56, 0x0e, 0x14, 0xa6, 0xdd, 0x4b, 0xe1, 0x9a, 0x52,
+    0xc0, 0x9d, 0xac, 0x60, 0x31, 0x1e, 0xe6, 0x44, 0x2a, 0xe9, 0x24, 0x6f, 0x17, 0xb6, 0xe2, 0x2d,
+    0x94, 0xa7, 0x73, 0x32, 0x58, 0x30, 0xe3, 0x89, 0xaf, 0x31, 0xa0, 0xb4, 0x87, 0x75, 0xd2, 0xb5,
+    0x70, 0xfe, 0xb7, 0xfc, 0x43, 0x92, 0x0b, 0xad, 0x6a, 0xb9, 0x19, 0x0c, 0x77, 0x52, 0xab, 0x62,
+    0x19, 0x6e, 0x66, 0x85, 0x75, 0x5b, 0xbf, 0xae, 0xb5, 0xd8, 0xee, 0x6a, 0xac, 0xb7, 0xa8, 0x79,
+    0x27, 0xdb, 0x6d, 0xf6, 0xbb, 0x41, 0xf0, 0xbc, 0xe7, 0x42, 0x48, 0xb5, 0xc9, 0x56, 0x69, 0xff,
+    0x90, 0x77, 0xfc, 0x21, 0x14, 0xcf, 0xce, 0xd2, 0x70, 0x36, 0x1b, 0xa9, 0xb2, 0x94, 0xf0, 0xc1,
+    0xe9, 0xfd, 0x4c, 0xaa, 0x7e, 0x70, 0x73, 0x0b, 0x2d, 0x54, 0x6e, 0x17, 0xf2, 0x4e, 0xd3, 0xf4,
+    0xa7, 0x47, 0x8c, 0xd3, 0x67, 0xcf, 0xf8, 0x3d, 0x49, 0xf3, 0xb5, 0x7e, 0x58, 0x58, 0xf9, 0xcd,
+    0xdf, 0xae, 0xb5, 0x11, 0xd8, 0x3f, 0x46, 0xf6, 0xb3, 0xf5, 0xe0, 0x9c, 0x56, 0xff, 0x8b, 0xb1,
+    0xe6, 0xd5, 0x97, 0x8d, 0xd1, 0x83, 0x12, 0xd9, 0x51, 0x9a, 0xfe, 0xb2, 0xae, 0xeb, 0xbc, 0xd2,
+    0xad, 0x36, 0xd9, 0x51, 0x8d, 0xdb, 0x00, 0x94, 0x29, 0xad, 0x20, 0xaf, 0x06, 0x63, 0x31, 0xde,
+    0x6b, 0x89, 0x42, 0x9a, 0xfd, 0x8c, 0x29, 0xed, 0x60, 0x17, 0x92, 0xb5, 0xe1, 0x6a, 0x03, 0xf9,
+    0xc8, 0x19, 0x7b, 0x80, 0xec, 0xf4, 0xac, 0xc7, 0xda, 0x47, 0x0a, 0x9c, 0xdd, 0xbd, 0x8c, 0x16,
+    0xcb, 0x49, 0xa7, 0x62, 0x39, 0xcd, 0xd1, 0x0b, 0xe6, 0xa7, 0xba, 0xfa, 0xa1, 0xba, 0x18, 0x9e,
+    0x15, 0x3d, 0xa9, 0x5a, 0x6e, 0x6d, 0x49, 0x7d, 0x55, 0x7a, 0xfe, 0x19, 0x7f, 0x33, 0x72, 0xa5,
+    0xda, 0x2d, 0x59, 0xb1, 0xb3, 0x3f, 0x3f, 0x7c, 0x23, 0xe3, 0x93, 0xd2, 0x12, 0x3b, 0xf4, 0x7e,
+    0xe0, 0x20, 0x58, 0xb1, 0xec, 0xf1, 0xc1, 0x5a, 0x9b, 0x8e, 0xf0, 0xca, 0x43, 0x95, 0x74, 0x69,
+    0xf9, 0x1d, 0x50, 0x82, 0x06, 0x69, 0xb4, 0x28, 0xe9, 0xf5, 0xd5, 0xcd, 0xad, 0x9f, 0x6c, 0xd0,
+    0x99, 0x48, 0x0c, 0xf9, 0x8e, 0x29, 0xd1, 0x0a, 0x5d, 0x85, 0x8c, 0x4a, 0x2a, 0xeb, 0xd8, 0x35,
+    0xd2, 0xb2, 0x3b, 0xde, 0x0e, 0x90, 0x58, 0x2b, 0x45, 0xd8, 0x96, 0x4f, 0x51, 0x8f, 0xa0, 0x7b,
+    0x5f, 0x80, 0x84, 0x2b, 0x4a, 0xcf, 0x6f, 0x2a, 0xae, 0x14, 0x8a, 0xcc, 0x18, 0xb6, 0x11, 0x2e,
+    0x3d, 0xdf, 0x50, 0x08, 0x77, 0xe3, 0x7c, 0x89, 0xdb, 0xf6, 0x98, 0xed, 0xe0, 0x01, 0xfd, 0xe9,
+    0x8b, 0x7b, 0x78, 0x3a, 0x39, 0x37, 0xec, 0xfb, 0x96, 0x57, 0xd0, 0xe8, 0x16, 0xa7, 0x50, 0xd2,
+    0x91, 0xe2, 0x67, 0xbc, 0x25, 0xf1, 0xcd, 0xcd, 0xc7, 0xf7, 0x09, 0x25, 0x06, 0xbe, 0x0e, 0xd2,
+    0x80, 0x20, 0x68, 0xa7, 0x16, 0xd4, 0x06, 0x8d, 0x4d, 0xdf, 0xae, 0xe8, 0x8b, 0x02, 0x3d, 0x0a,
+    0x77, 0x8f, 0x93, 0x3c, 0x40, 0x3f, 0x9d, 0xff, 0x03, 0x7f, 0xfd, 0x18, 0x7e, 0x86, 0xf6, 0xf3,
+    0x99, 0x47, 0x0b, 0x26, 0x9a, 0xe0, 0xec, 0xb0, 0xee, 0xa4, 0x43, 0x8e, 0xa8, 0x25, 0x39, 0xe6,
+    0x5d, 0x9f, 0xfb, 0x89, 0x29, 0x24, 0x56, 0x2c, 0x43, 0xa2, 0xa7, 0xea, 0x75, 0xf7, 0xd2, 0x56,
+    0x46, 0xf6, 0xc8, 0xb8, 0x1e, 0xd4, 0x38, 0x03, 0xd2, 0x6a, 0x2e, 0xe2, 0x64, 0x37, 0x23, 0xa4,
+    0x06, 0x57, 0x35, 0x71, 0xb4, 0xc4, 0xd7, 0x4c, 0xb1, 0x7f, 0xad, 0x56, 0x51, 0xc2, 0x5c, 0x03,
+    0x2a, 0x3e, 0xe4, 0xc6, 0x26, 0xd9, 0x19, 0x70, 0x83, 0x51, 0xc4, 0x8c, 0x09, 0x71, 0xb2, 0x7f,
+    0x99, 0x22, 0x46, 0x28, 0x82, 0xca, 0x1b, 0x62, 0x4b, 0xa1, 0xab, 0xa1, 0xc3, 0xb7, 0x9c, 0x6d,
+    0xc0, 0x5d, 0xb6, 0xe0, 0xb7, 0xef, 0xb6, 0x1f, 0x45, 0x1c, 0xf9, 0xb1, 0x46, 0x49, 0x3e, 0xa6,
+    0xe2, 0x48, 0x05, 0xb3, 0xd3, 0x80, 0x8e, 0x8f, 0xdf, 0x08, 0x86, 0xb7, 0x48, 0xfc, 0x8b, 0x65,
+    0x81, 0x75, 0xb2, 0xc3, 0xef, 0xc9, 0xad, 0xec, 0x40, 0x0f, 0x2e, 0xf6, 0xfd, 0xce, 0x57, 0x69,
+    0x9a, 0x26, 0x79, 0xe8, 0x65, 0x3f, 0x82, 0x58, 0x26, 0x91, 0xb2, 0xf9, 0x70, 0xfb, 0xd7, 0xa7,
+    0x32, 0x7a, 0x3d, 0xfe, 0x60, 0xa8, 0x09, 0x97, 0xc4, 0xd1, 0xc9, 0xab, 0x22, 0x27, 0x51, 0xf2,
+    0xe8, 0x8c, 0x28, 0x34, 0xf6, 0x2c, 0x07, 0xd5, 0xbb, 0xe4, 0xa8, 0xce, 0x23, 0x4f, 0x35, 0xf1,
+    0x0c, 0x4c, 0xf5, 0x13, 0xd3, 0xca, 0x00, 0x77, 0x30, 0x91, 0x8d, 0xa3, 0x80, 0x78, 0xa0, 0x4a,
+    0x88, 0x9e, 0xec, 0xaa, 0x98, 0x37, 0xd4, 0x53, 0xd4, 0x9b, 0xee, 0x62, 0xfa, 0x24, 0x86, 0xbb,
+    0x93, 0xc8, 0xf7, 0xa9, 0x98, 0xc1, 0x03, 0xee, 0xc5, 0xbb, 0x2e, 0x3a, 0x89, 0x15, 0xd3, 0x3d,
+    0xa8, 0xdf, 0xa2, 0x39, 0xf1, 0x6b, 0x94, 0x45, 0x51, 0x82, 0x8d, 0x47, 0x07, 0x1c, 0xcb, 0x78,
+    0x8f, 0x71, 0x71, 0xd1, 0xc8, 0x56, 0xc4, 0x7a, 0xaa, 0xba, 0xff, 0x91, 0xd0, 0xc9, 0x4b, 0x4d,
+    0xdf, 0x8e, 0x9a, 0xce, 0x7c, 0x3a, 0xab, 0xb8, 0x7b, 0x4e, 0xf6, 0xf5, 0x00, 0xc6, 0x64, 0x8f,
+    0xbb, 0x9f, 0x05, 0x03, 0xe5, 0xfe, 0x6d, 0x9a, 0xbc, 0x85, 0xb6, 0x0b, 0x1f, 0x90, 0x65, 0xf8,
+    0x7b, 0xf8, 0x0e, 0xaa, 0xb8, 0x8a, 0xb8, 0x36, 0x06, 0x00, 0x00,
+};
+static const size_t PORTAL_INDEX_HTML_GZ_LEN = 859;
+
+#endif // PORTAL_ASSETS_H
@@ -0,0 +1,24 @@
+/*
+ * 构建配置：完整（默认）
+ *
+ * 功能：
+ * - 链接 IRremoteESP8266 的全部协议（不覆盖 DECODE_* / SEND_*）
+ * - 启用全部可选子系统
+ * - Arduino IDE 直接编译时使用本配置；其他配置用
+ *   tools/build_profile.py <名称> 编译（红外库需要相同的 -D 选项）
+ *
+ * 新建配置：复制 profile_gree.h 为 profile_<名称>.h；脚本把带值的
+ * #define 行转换为 -D 编译选项
+ */
+
+#ifndef PROFILE_FULL_H
+#define PROFILE_FULL_H
+
+#define BUILD_PROFILE "full"
+
+// 可选子系统（0=不编译）
+#define GHOST_DETECTOR_ENABLED 1 // 麦克风Ghost检测
+#define CAPTIVE_PORTAL_ENABLED 1 // AP配网门户
+#define AUTO_DETECT_ENABLED 1    // 遥控器协议自动检测
+
+#endif // PROFILE_FULL_H
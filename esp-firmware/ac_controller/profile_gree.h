@@ -0,0 +1,28 @@
+/*
+ * 构建配置：格力（精简）
+ *
+ * 功能：
+ * - 只编译格力协议的收发，irrecv.decode 不再逐个尝试其他协议
+ * - 关闭协议自动检测（品牌已确定）
+ * - 保留配网门户和Ghost检测
+ *
+ * 编译：python3 tools/build_profile.py gree
+ * 脚本把带值的 #define 行转换为 -D 编译选项，其余行忽略
+ */
+
+#ifndef PROFILE_GREE_H
+#define PROFILE_GREE_H
+
+#define BUILD_PROFILE "gree"
+
+// 红外协议：默认全部关闭，只开启需要的
+#define _IR_ENABLE_DEFAULT_ false
+#define DECODE_GREE true
+#define SEND_GREE true
+
+// 可选子系统（0=不编译）
+#define GHOST_DETECTOR_ENABLED 1
+#define CAPTIVE_PORTAL_ENABLED 1
+#define AUTO_DETECT_ENABLED 0
+
+#endif // PROFILE_GREE_H
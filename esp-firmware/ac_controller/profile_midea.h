@@ -0,0 +1,30 @@
+/*
+ * 构建配置：美的（精简）
+ *
+ * 功能：
+ * - 只编译美的协议（含美的24位扩展）的收发
+ * - 关闭协议自动检测和Ghost检测（设备未装麦克风）
+ * - 保留配网门户
+ *
+ * 编译：python3 tools/build_profile.py midea
+ * 脚本把带值的 #define 行转换为 -D 编译选项，其余行忽略
+ */
+
+#ifndef PROFILE_MIDEA_H
+#define PROFILE_MIDEA_H
+
+#define BUILD_PROFILE "midea"
+
+// 红外协议：默认全部关闭，只开启需要的
+#define _IR_ENABLE_DEFAULT_ false
+#define DECODE_MIDEA true
+#define SEND_MIDEA true
+#define DECODE_MIDEA24 true
+#define SEND_MIDEA24 true
+
+// 可选子系统（0=不编译）
+#define GHOST_DETECTOR_ENABLED 0
+#define CAPTIVE_PORTAL_ENABLED 1
+#define AUTO_DETECT_ENABLED 0
+
+#endif // PROFILE_MIDEA_H
@@ -0,0 +1,203 @@
+/*
+ * 协作式任务调度器 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_SYS
+
+#include "scheduler.h"
+#include <cont.h>
+#include <core_version.h>
+#include <coredecls.h>
+
+// 静态成员初始化
+SchedulerTask Scheduler::tasks[SCHED_MAX_TASKS];
+uint8_t Scheduler::taskCount = 0;
+volatile uint32_t Scheduler::isrPending = 0;
+volatile bool Scheduler::wakeRequested = false;
+
+static_assert(SCHED_MAX_TASKS <= 32, "isrPending 位图最多支持32个任务");
+
+TaskId Scheduler::addPeriodic(const char *name, uint32_t intervalMs,
+                              TaskCallback callback, bool start) {
+  TaskId id = addTask(name, intervalMs, callback);
+  if (id != SCHED_INVALID_TASK && start) {
+    schedule(id, intervalMs);
+  }
+  return id;
+}
+
+TaskId Scheduler::addOneShot(const char *name, TaskCallback callback) {
+  return addTask(name, 0, callback);
+}
+
+TaskId Scheduler::addTask(const char *name, uint32_t intervalMs,
+                          TaskCallback callback) {
+  if (taskCount >= SCHED_MAX_TASKS) {
+    LOG_PRINTF(ERROR, "[调度] ❌ 任务表已满，无法注册: %s\n", name);
+    return SCHED_INVALID_TASK;
+  }
+
+  SchedulerTask &task = tasks[taskCount];
+  memset(&task, 0, sizeof(SchedulerTask));
+  task.name = name;
+  task.callback = callback;
+  task.interval = intervalMs;
+
+  DEBUG_PRINTF("[调度] 注册任务 #%d: %s (%s %u ms)\n", taskCount, name,
+               intervalMs > 0 ? "周期" : "单次", intervalMs);
+  return taskCount++;
+}
+
+bool Scheduler::isValid(TaskId id) { return id >= 0 && id < taskCount; }
+
+void Scheduler::schedule(TaskId id, uint32_t delayMs) {
+  if (!isValid(id))
+    return;
+  tasks[id].deadline = millis() + delayMs;
+  tasks[id].active = true;
+}
+
+void Scheduler::trigger(TaskId id) { schedule(id, 0); }
+
+void IRAM_ATTR Scheduler::triggerFromISR(TaskId id) {
+  if (id < 0 || id >= SCHED_MAX_TASKS)
+    return;
+  isrPending |= (1UL << id);
+  wake();
+}
+
+void Scheduler::cancel(TaskId id) {
+  if (!isValid(id))
+    return;
+  tasks[id].active = false;
+}
+
+void Scheduler::setInterval(TaskId id, uint32_t intervalMs) {
+  if (!isValid(id) || intervalMs == 0)
+    return;
+  tasks[id].interval = intervalMs;
+  if (tasks[id].active) {
+    schedule(id, intervalMs);
+  }
+}
+
+bool Scheduler::isPending(TaskId id) { return isValid(id) && tasks[id].active; }
+
+uint32_t Scheduler::run() {
+  // 1. 把中断触发的任务转为立即到期
+  if (isrPending) {
+    noInterrupts();
+    uint32_t pending = isrPending;
+    isrPending = 0;
+    interrupts();
+
+    for (uint8_t i = 0; i < taskCount; i++) {
+      if (pending & (1UL << i)) {
+        trigger(i);
+      }
+    }
+  }
+
+  // 2. 执行到期任务
+  for (uint8_t i = 0; i < taskCount; i++) {
+    SchedulerTask &task = tasks[i];
+    if (!task.active)
+      continue;
+
+    uint32_t now = millis();
+    if ((int32_t)(now - task.deadline) < 0)
+      continue;
+
+    uint32_t late = now - task.deadline;
+
+    // 先重新排期，回调内可以再次 schedule()/cancel()
+    if (task.interval > 0) {
+      task.deadline += task.interval;
+      // 落后超过一个周期时不补跑，从当前时刻重新计时
+      if ((int32_t)(now - task.deadline) >= 0) {
+        task.deadline = now + task.interval;
+      }
+    } else {
+      task.active = false;
+    }
+
+    // 每 SCHED_STACK_SAMPLE_EVERY 次执行测一次栈（重绘约4KB栈空间，不计入耗时）
+    bool probeStack = task.runs % SCHED_STACK_SAMPLE_EVERY == 0;
+    if (probeStack) {
+      ESP.resetFreeContStack();
+    }
+
+    uint32_t startUs = micros();
+    task.callback();
+    uint32_t durationUs = micros() - startUs;
+
+    if (probeStack) {
+      uint16_t stackUsed = CONT_STACKSIZE - ESP.getFreeContStack();
+      if (stackUsed > task.stackPeak)
+        task.stackPeak = stackUsed;
+    }
+
+    task.runs++;
+    task.lateTotalMs += late;
+    if (late > task.lateMaxMs)
+      task.lateMaxMs = late;
+    if (durationUs > task.durationMaxUs)
+      task.durationMaxUs = durationUs;
+  }
+
+  // 3. 计算距下一个截止时间的间隔
+  uint32_t now = millis();
+  uint32_t wait = SCHED_MAX_IDLE_MS;
+  for (uint8_t i = 0; i < taskCount; i++) {
+    if (!tasks[i].active)
+      continue;
+    int32_t remaining = (int32_t)(tasks[i].deadline - now);
+    if (remaining <= 0)
+      return 0;
+    if ((uint32_t)remaining < wait)
+      wait = remaining;
+  }
+  return wait;
+}
+
+void Scheduler::idle(uint32_t maxMs) {
+  if (maxMs == 0 || wakeRequested || isrPending) {
+    wakeRequested = false;
+    yield(); // 仍需让出CPU给WiFi协议栈
+    return;
+  }
+
+#if defined(ARDUINO_ESP8266_MAJOR) && ARDUINO_ESP8266_MAJOR >= 3
+  // 睡眠直到超时，或被 wake() 通过 esp_schedule() 提前唤醒
+  esp_delay(maxMs, []() { return !wakeRequested; });
+#else
+  delay(maxMs);
+#endif
+  wakeRequested = false;
+}
+
+void IRAM_ATTR Scheduler::wake() {
+  wakeRequested = true;
+#if defined(ARDUINO_ESP8266_MAJOR) && ARDUINO_ESP8266_MAJOR >= 3
+  esp_schedule();
+#endif
+}
+
+uint8_t Scheduler::getTaskCount() { return taskCount; }
+
+const SchedulerTask *Scheduler::getTask(TaskId id) {
+  return isValid(id) ? &tasks[id] : nullptr;
+}
+
+void Scheduler::printStats() {
+  DEBUG_PRINTLN("\n========== 调度器统计 ==========");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    const SchedulerTask &task = tasks[i];
+    DEBUG_PRINTF("#%d %-12s 执行:%u 平均延迟:%u ms 最大延迟:%u ms 最长耗时:%u "
+                 "us 栈峰值:%u\n",
+                 i, task.name, task.runs,
+                 task.runs > 0 ? task.lateTotalMs / task.runs : 0,
+                 task.lateMaxMs, task.durationMaxUs, task.stackPeak);
+  }
+  DEBUG_PRINTLN("================================\n");
+}
@@ -0,0 +1,92 @@
+/*
+ * 协作式任务调度器
+ *
+ * 功能：
+ * - 各模块注册周期任务或单次任务（截止时间）
+ * - 主循环只执行到期任务，然后睡眠到下一个截止时间
+ * - 中断可唤醒睡眠并触发指定任务
+ * - 统计每个任务的延迟抖动和执行耗时
+ * - 抽样测量每个任务的栈使用峰值（执行前重绘栈，执行后读水位）
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "config.h"
+#include <Arduino.h>
+
+// 任务句柄（任务表下标），注册失败返回 SCHED_INVALID_TASK
+typedef int8_t TaskId;
+#define SCHED_INVALID_TASK -1
+
+typedef void (*TaskCallback)();
+
+// 任务描述及统计
+struct SchedulerTask {
+  const char *name;
+  TaskCallback callback;
+  uint32_t interval; // 周期（毫秒），0 表示单次任务
+  uint32_t deadline; // 下一次截止时间（millis）
+  bool active;       // 是否已排期
+
+  // 抖动统计（实际执行时间 - 截止时间）
+  uint32_t runs;
+  uint32_t lateMaxMs;
+  uint32_t lateTotalMs;
+  uint32_t durationMaxUs; // 单次执行最长耗时
+  uint16_t stackPeak;     // 抽样测得的栈使用峰值（字节，含 loop() 等上层调用）
+};
+
+class Scheduler {
+public:
+  // 注册周期任务（start=false 时只注册，稍后用 schedule() 启动）
+  static TaskId addPeriodic(const char *name, uint32_t intervalMs,
+                            TaskCallback callback, bool start = true);
+
+  // 注册单次任务（注册后未排期，用 schedule() 设定截止时间）
+  static TaskId addOneShot(const char *name, TaskCallback callback);
+
+  // 在 delayMs 毫秒后执行（周期任务从此刻重新开始计时）
+  static void schedule(TaskId id, uint32_t delayMs);
+
+  // 尽快执行（下一个调度周期）
+  static void trigger(TaskId id);
+
+  // 中断中触发任务（仅设置标志并唤醒主循环）
+  static void IRAM_ATTR triggerFromISR(TaskId id);
+
+  // 取消排期
+  static void cancel(TaskId id);
+
+  // 修改周期任务的间隔（已排期的任务按新间隔重新计时）
+  static void setInterval(TaskId id, uint32_t intervalMs);
+
+  // 是否已排期
+  static bool isPending(TaskId id);
+
+  // 执行所有到期任务，返回距下一个截止时间的毫秒数
+  static uint32_t run();
+
+  // 睡眠至多 maxMs 毫秒，中断触发时提前返回
+  static void idle(uint32_t maxMs);
+
+  // 唤醒睡眠中的主循环（中断安全）
+  static void IRAM_ATTR wake();
+
+  // 统计信息
+  static uint8_t getTaskCount();
+  static const SchedulerTask *getTask(TaskId id);
+  static void printStats();
+
+private:
+  static SchedulerTask tasks[SCHED_MAX_TASKS];
+  static uint8_t taskCount;
+  static volatile uint32_t isrPending; // 中断触发的任务位图
+  static volatile bool wakeRequested;
+
+  static TaskId addTask(const char *name, uint32_t intervalMs,
+                        TaskCallback callback);
+  static bool isValid(TaskId id);
+};
+
+#endif // SCHEDULER_H
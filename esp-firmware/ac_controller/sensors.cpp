@@ -2,8 +2,11 @@
  * 传感器模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_STATE
+
 #include "sensors.h"
 #include "config_manager.h"
+#include "message_arena.h"
 #include "mqtt_client.h"
 #include "state_manager.h" // ✅ 新增：需要访问 StateManager
 #include <ArduinoJson.h>
@@ -13,7 +16,7 @@ Adafruit_AHTX0 Sensors::aht;
 float Sensors::temperature = 0.0;
 float Sensors::humidity = 0.0;
 float Sensors::current = 0.0;
-unsigned long Sensors::lastReadTime = 0;
+TaskId Sensors::sampleTask = SCHED_INVALID_TASK;
 bool Sensors::initialized = false;
 
 bool Sensors::init() {
@@ -24,7 +27,7 @@ bool Sensors::init() {
 
   // 初始化AHT20
   if (!aht.begin()) {
-    DEBUG_PRINTLN("[传感器] ❌ AHT20初始化失败");
+    LOG_PRINTLN(ERROR, "[传感器] ❌ AHT20初始化失败");
     return false;
   }
 
@@ -33,6 +36,15 @@ bool Sensors::init() {
   // 首次读取
   if (read()) {
     initialized = true;
+
+    // 按配置间隔定时采样上报
+    DeviceConfig &cfg = ConfigManager::getConfig();
+    EventBus::subscribe(EVT_SENSOR_SAMPLE, onSample);
+
+    uint32_t interval =
+        cfg.sensorInterval > 0 ? cfg.sensorInterval : DEFAULT_SENSOR_INTERVAL;
+    sampleTask = Scheduler::addPeriodic("sensors", interval, update);
+
     DEBUG_PRINTLN("[传感器] ✅ 传感器模块就绪");
     return true;
   }
@@ -44,18 +56,23 @@ void Sensors::update() {
   if (!initialized)
     return;
 
-  unsigned long now = millis();
-  DeviceConfig &cfg = ConfigManager::getConfig();
-
-  // 检查是否到达上报间隔
-  if (now - lastReadTime >= cfg.sensorInterval) {
-    if (read()) {
-      publishStatus();
-      lastReadTime = now;
-    }
+  if (read()) {
+    Event event;
+    memset(&event, 0, sizeof(Event));
+    event.type = EVT_SENSOR_SAMPLE;
+    event.data.sensor.temperature = temperature;
+    event.data.sensor.humidity = humidity;
+    event.data.sensor.current = current;
+    EventBus::post(event);
   }
 }
 
+void Sensors::onSample(const Event &event) { publishStatus(); }
+
+void Sensors::setInterval(uint32_t intervalMs) {
+  Scheduler::setInterval(sampleTask, intervalMs);
+}
+
 float Sensors::getTemperature() { return temperature; }
 
 float Sensors::getHumidity() { return humidity; }
@@ -73,32 +90,32 @@ bool Sensors::read() {
   // 读取电流
   current = readCurrent();
 
-  DEBUG_PRINTF("[传感器] 温度: %.1f°C, 湿度: %.1f%%, 电流: %.2fA\n",
-               temperature, humidity, current);
+  LOG_PRINTF(DEBUG, "[传感器] 温度: %.1f°C, 湿度: %.1f%%, 电流: %.2fA\n",
+             temperature, humidity, current);
 
   return true;
 }
 
 void Sensors::publishStatus() {
   if (!MQTTClient::isConnected()) {
-    DEBUG_PRINTLN("[传感器] MQTT未连接，跳过上报");
+    LOG_PRINTLN(DEBUG, "[传感器] MQTT未连接，跳过上报");
     return;
   }
 
   // ✅ 修复：获取完整的空调状态，合并传感器数据
   // 防止只发送温湿度导致后端丢失空调控制状态
-  AirConditionerState &acState = StateManager::getState();
+  const ACState &acState = StateManager::getState();
 
-  StaticJsonDocument<512> doc;
+  ArenaJsonDocument doc(384);
 
   // 1. 填入空调控制状态
-  doc["power"] = acState.power;
-  doc["mode"] = acState.mode;
+  doc["power"] = (bool)acState.power;
+  doc["mode"] = acModeName(acState.mode);
   // doc["targetTemp"] = acState.temp; // ❌ 移除重复
   doc["setTemp"] = acState.temp; // ✅ 保留标准字段
-  doc["fan"] = acState.fan;
-  doc["swingVertical"] = acState.swingV;
-  doc["swingHorizontal"] = acState.swingH;
+  doc["fan"] = (uint8_t)acState.fan;
+  doc["swingVertical"] = (bool)acState.swingV;
+  doc["swingHorizontal"] = (bool)acState.swingH;
   doc["source"] = "sensor_report";
 
   // 2. 填入传感器数据
@@ -108,16 +125,13 @@ void Sensors::publishStatus() {
 
   doc["timestamp"] = millis() / 1000;
 
-  char payload[512];
-  serializeJson(doc, payload);
-
   // 发布到MQTT
   String topic = MQTTClient::getTopic("status");
   // ✅ 使用 retained=true，确保后端/前端重启后能立刻收到最新状态
-  if (MQTTClient::publish(topic.c_str(), payload, true)) {
-    DEBUG_PRINTLN("[传感器] ✅ 完整状态已上报 (Retained)");
+  if (MQTTClient::publishJson(topic.c_str(), doc, true)) {
+    LOG_PRINTLN(DEBUG, "[传感器] ✅ 完整状态已上报 (Retained)");
   } else {
-    DEBUG_PRINTLN("[传感器] ❌ 状态上报失败");
+    LOG_PRINTLN(ERROR, "[传感器] ❌ 状态上报失败");
   }
 }
 
@@ -132,7 +146,7 @@ float Sensors::readCurrent() {
   float adcValue = adcSum / (float)ADC_SAMPLES;
 
   // ✅ 打印ADC原始值（用于调试和参数调整）
-  DEBUG_PRINTF("[传感器] ADC原始值: %.2f (范围0-1023)\n", adcValue);
+  LOG_PRINTF(DEBUG, "[传感器] ADC原始值: %.2f (范围0-1023)\n", adcValue);
 
   // 转换为电流值
   // 公式：I = (ADC * 3.3 / 1024 - offset) * ratio
@@ -145,8 +159,8 @@ float Sensors::readCurrent() {
     currentValue = 0;
 
   // ✅ 打印计算后的电流值和中间电压
-  DEBUG_PRINTF("[传感器] 计算电流: %.3fA (电压: %.3fV, 偏移: %.3fV)\n",
-               currentValue, voltage, offsetVoltage);
+  LOG_PRINTF(DEBUG, "[传感器] 计算电流: %.3fA (电压: %.3fV, 偏移: %.3fV)\n",
+             currentValue, voltage, offsetVoltage);
 
   return currentValue;
 }
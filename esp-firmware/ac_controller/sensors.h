@@ -11,6 +11,8 @@
 #define SENSORS_H
 
 #include "config.h"
+#include "event_bus.h"
+#include "scheduler.h"
 #include <Adafruit_AHTX0.h>
 #include <Arduino.h>
 #include <Wire.h>
@@ -21,9 +23,12 @@ public:
   // 初始化传感器
   static bool init();
 
-  // 更新传感器读数（在loop中定期调用）
+  // 采样并投递 EVT_SENSOR_SAMPLE（调度器周期任务）
   static void update();
 
+  // 修改上报间隔（配置更新后调用）
+  static void setInterval(uint32_t intervalMs);
+
   // 获取当前读数
   static float getTemperature();
   static float getHumidity();
@@ -40,11 +45,14 @@ private:
   static float temperature;
   static float humidity;
   static float current;
-  static unsigned long lastReadTime;
+  static TaskId sampleTask;
   static bool initialized;
 
   // ADC电流采样
   static float readCurrent();
+
+  // EVT_SENSOR_SAMPLE 消费者：上报状态
+  static void onSample(const Event &event);
 };
 
 #endif // SENSORS_H
@@ -2,109 +2,101 @@
  * 空调状态管理器 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_STATE
+
 #include "state_manager.h"
+#include "checksum.h"
+#include "command_trace.h"
+#include "kv_store.h"
+#include "message_arena.h"
 #include "mqtt_client.h"
 #include "sensors.h"
 #include <ArduinoJson.h>
 
+// ACState 之前的RTC副本（模式为字符串）使用 "ACST"，换格式后不再识别
+static const uint32_t RTC_STATE_MAGIC = 0x41435332; // "ACS2"
+
+// 旧版Flash记录（模式为字符串），升级后首次启动时转换
+struct LegacyState {
+  uint8_t power;
+  char mode[8];
+  uint8_t temp;
+  uint8_t fan;
+  uint8_t swingV;
+  uint8_t swingH;
+} __attribute__((packed));
+
 // 静态成员初始化
-AirConditionerState StateManager::currentState = {
-    false,  // power
-    "cool", // mode
-    26,     // temp
-    0,      // fan (auto)
-    false,  // swingV
-    false,  // swingH
-    "init", // source
-    0       // lastUpdate
+ACState StateManager::currentState = {
+    AC_MODE_COOL,   // mode
+    AC_FAN_AUTO,    // fan
+    26,             // temp
+    AC_SOURCE_INIT, // source
+    false,          // power
+    false,          // swingV
+    false           // swingH
 };
 bool StateManager::stateChanged = false;
+TaskId StateManager::saveTask = SCHED_INVALID_TASK;
+uint32_t StateManager::dirtySince = 0;
 
 void StateManager::init() {
   DEBUG_PRINTLN("[状态] 初始化状态管理器");
 
-  // 尝试从EEPROM加载状态
+  EventBus::subscribe(EVT_STATE_CHANGED, onStateChanged);
+  saveTask = Scheduler::addOneShot("state_save", save);
+
+  // 恢复上次状态（在首次发布 status 之前完成）
+  unsigned long start = micros();
   if (load()) {
-    DEBUG_PRINTLN("[状态] ✅ 从EEPROM加载状态");
+    DEBUG_PRINTF("[状态] ✅ 已恢复状态 (%lu us)\n", micros() - start);
   } else {
     DEBUG_PRINTLN("[状态] 使用默认状态");
   }
 }
 
-void StateManager::setState(bool power, const char *mode, uint8_t temp,
-                            uint8_t fan, bool swingV, bool swingH,
-                            const char *source) {
-  currentState.power = power;
-  currentState.mode = String(mode);
-  currentState.temp = constrain(temp, 10, 31);
-  currentState.fan = constrain(fan, 0, 5);
-  currentState.swingV = swingV;
-  currentState.swingH = swingH;
-  currentState.source = String(source);
-  currentState.lastUpdate = millis();
+void StateManager::setState(const ACState &state, ACSource source) {
+  currentState = state;
+  currentState.temp = acClampTemp(state.temp);
+  currentState.fan = acFanFromLevel(state.fan);
+  currentState.source = source;
 
   stateChanged = true;
 
   DEBUG_PRINTLN("[状态] 状态已更新");
-  DEBUG_PRINTF("[状态] 电源: %s, 模式: %s, 温度: %d°C\n", power ? "开" : "关",
-               mode, temp);
-
-  // 自动发布状态
-  publishState();
+  DEBUG_PRINTF("[状态] 电源: %s, 模式: %s, 温度: %d°C\n",
+               currentState.power ? "开" : "关", acModeName(currentState.mode),
+               currentState.temp);
 
-  // 可选：保存到EEPROM
-  // save();
+  // 发布交给事件消费者，调用方（如红外解码路径）立即返回
+  EventBus::post(EVT_STATE_CHANGED);
+  scheduleSave();
 }
 
-bool StateManager::updateFromJSON(const char *json) {
-  StaticJsonDocument<512> doc;
-  DeserializationError error = deserializeJson(doc, json);
+const ACState &StateManager::getState() { return currentState; }
 
-  if (error) {
-    DEBUG_PRINTLN("[状态] ❌ JSON解析失败");
-    return false;
+void StateManager::onStateChanged(const Event &event) {
+  // 多次变更排队时只需发布一次最新状态
+  if (stateChanged) {
+    publishState();
   }
-
-  // 更新状态（仅更新存在的字段）
-  if (doc.containsKey("power"))
-    currentState.power = doc["power"];
-  if (doc.containsKey("mode"))
-    currentState.mode = doc["mode"].as<String>();
-  if (doc.containsKey("temp"))
-    currentState.temp = constrain((int)doc["temp"], 10, 31);
-  if (doc.containsKey("fan"))
-    currentState.fan = constrain((int)doc["fan"], 0, 5);
-  if (doc.containsKey("swingVertical"))
-    currentState.swingV = doc["swingVertical"];
-  if (doc.containsKey("swingHorizontal"))
-    currentState.swingH = doc["swingHorizontal"];
-  if (doc.containsKey("source"))
-    currentState.source = doc["source"].as<String>();
-
-  currentState.lastUpdate = millis();
-  stateChanged = true;
-
-  DEBUG_PRINTLN("[状态] ✅ 从JSON更新状态");
-  return true;
 }
 
-AirConditionerState &StateManager::getState() { return currentState; }
-
 void StateManager::publishState() {
   if (!MQTTClient::isConnected())
     return;
 
   // 构建状态JSON（包含传感器数据）
-  StaticJsonDocument<512> doc;
+  ArenaJsonDocument doc(384);
 
   // 空调状态
-  doc["power"] = currentState.power;
-  doc["mode"] = currentState.mode;
+  doc["power"] = (bool)currentState.power;
+  doc["mode"] = acModeName(currentState.mode);
   doc["setTemp"] = currentState.temp;
-  doc["fan"] = currentState.fan;
-  doc["swingVertical"] = currentState.swingV;
-  doc["swingHorizontal"] = currentState.swingH;
-  doc["source"] = currentState.source;
+  doc["fan"] = (uint8_t)currentState.fan;
+  doc["swingVertical"] = (bool)currentState.swingV;
+  doc["swingHorizontal"] = (bool)currentState.swingH;
+  doc["source"] = acSourceName(currentState.source);
 
   // 传感器数据
   doc["temp"] = Sensors::getTemperature();
@@ -113,23 +105,129 @@ void StateManager::publishState() {
 
   doc["timestamp"] = millis() / 1000;
 
-  char payload[512];
-  serializeJson(doc, payload);
-
   // 发布到MQTT
   String topic = MQTTClient::getTopic("status");
-  if (MQTTClient::publish(topic.c_str(), payload)) {
-    DEBUG_PRINTLN("[状态] ✅ 状态已发布");
+  if (MQTTClient::publishJson(topic.c_str(), doc)) {
+    LOG_PRINTLN(DEBUG, "[状态] ✅ 状态已发布");
     stateChanged = false;
+    CommandTrace::onPublished();
   }
 }
 
 void StateManager::save() {
-  // TODO: 实现EEPROM保存
-  DEBUG_PRINTLN("[状态] EEPROM保存功能待实现");
+  ACState state = persisted();
+
+  dirtySince = 0;
+  Scheduler::cancel(saveTask);
+
+  // 与Flash中的值相同时KVStore不会写入
+  if (KVStore::put(KV_KEY_AC_STATE, &state, sizeof(state))) {
+    DEBUG_PRINTLN("[状态] ✅ 状态已保存");
+  } else {
+    LOG_PRINTLN(ERROR, "[状态] ❌ 状态保存失败");
+  }
 }
 
 bool StateManager::load() {
-  // TODO: 实现EEPROM加载
-  return false;
+  ACState state;
+
+  // 软件重启/看门狗复位后RTC内存仍然有效，且比Flash更新
+  uint32_t reason = ESP.getResetInfoPtr()->reason;
+  bool warmReset = reason == REASON_SOFT_RESTART ||
+                   reason == REASON_WDT_RST ||
+                   reason == REASON_SOFT_WDT_RST ||
+                   reason == REASON_EXCEPTION_RST ||
+                   reason == REASON_DEEP_SLEEP_AWAKE;
+
+  if (warmReset && loadRtc(state)) {
+    apply(state);
+    currentState.source = AC_SOURCE_RTC;
+    // 重启可能发生在静默期内，Flash 还是旧值
+    save();
+    return true;
+  }
+
+  LegacyState legacy;
+  int length = KVStore::get(KV_KEY_AC_STATE, &legacy, sizeof(legacy));
+  if (length == (int)sizeof(state)) {
+    memcpy(&state, &legacy, sizeof(state));
+  } else if (length == (int)sizeof(legacy)) {
+    char mode[sizeof(legacy.mode) + 1];
+    memcpy(mode, legacy.mode, sizeof(legacy.mode));
+    mode[sizeof(legacy.mode)] = '\0';
+
+    state.mode = acModeFromName(mode, AC_MODE_COOL);
+    state.fan = acFanFromLevel(legacy.fan);
+    state.temp = legacy.temp;
+    state.source = AC_SOURCE_INIT;
+    state.power = legacy.power != 0;
+    state.swingV = legacy.swingV != 0;
+    state.swingH = legacy.swingH != 0;
+    DEBUG_PRINTLN("[状态] 转换旧版状态记录");
+  } else {
+    return false;
+  }
+
+  apply(state);
+  currentState.source = AC_SOURCE_FLASH;
+  if (length != (int)sizeof(state)) {
+    save(); // 按新格式重写（长度不同，KVStore 会写入）
+  }
+  saveRtc(persisted());
+  return true;
+}
+
+void StateManager::scheduleSave() {
+  saveRtc(persisted());
+
+  // 每次变更推迟写入，持续变化（如按住遥控器按键）时最多推迟 MAX_DELAY
+  uint32_t now = millis();
+  if (dirtySince == 0) {
+    dirtySince = now;
+  }
+  if (now - dirtySince < STATE_SAVE_MAX_DELAY) {
+    Scheduler::schedule(saveTask, STATE_SAVE_DELAY);
+  }
+}
+
+ACState StateManager::persisted() {
+  ACState state = currentState;
+  state.source = AC_SOURCE_INIT;
+  return state;
+}
+
+void StateManager::apply(const ACState &in) {
+  currentState = in;
+  currentState.mode = in.mode < AC_MODE_COUNT ? in.mode : AC_MODE_COOL;
+  currentState.temp = acClampTemp(in.temp);
+  currentState.fan = acFanFromLevel(in.fan);
+
+  DEBUG_PRINTF("[状态] 电源: %s, 模式: %s, 温度: %d°C\n",
+               currentState.power ? "开" : "关", acModeName(currentState.mode),
+               currentState.temp);
+}
+
+bool StateManager::loadRtc(ACState &out) {
+  RtcBlock block;
+  if (!ESP.rtcUserMemoryRead(RTC_STATE_OFFSET, (uint32_t *)&block,
+                             sizeof(block)))
+    return false;
+
+  if (block.magic != RTC_STATE_MAGIC ||
+      block.crc != Checksum::crc32(&block, offsetof(RtcBlock, crc)))
+    return false;
+
+  out = block.state;
+  return true;
+}
+
+void StateManager::saveRtc(const ACState &in) {
+  static_assert(sizeof(RtcBlock) % 4 == 0, "RTC内存按4字节块访问");
+
+  RtcBlock block;
+  memset(&block, 0, sizeof(block));
+  block.magic = RTC_STATE_MAGIC;
+  block.state = in;
+  block.crc = Checksum::crc32(&block, offsetof(RtcBlock, crc));
+  ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, (uint32_t *)&block, sizeof(block));
 }
@@ -4,56 +4,64 @@
  * 功能：
  * - 维护空调当前状态
  * - 状态变更历史
- * - EEPROM持久化（可选）
+ * - 状态持久化（延迟写Flash + RTC内存快速恢复）
  * - 状态发布
  */
 
 #ifndef STATE_MANAGER_H
 #define STATE_MANAGER_H
 
+#include "ac_state.h"
 #include "config.h"
+#include "event_bus.h"
+#include "scheduler.h"
 #include <Arduino.h>
 
-
-// 空调状态结构
-struct AirConditionerState {
-  bool power;
-  String mode;   // "cool", "heat", "fan", "dry", "auto"
-  uint8_t temp;  // 16-30
-  uint8_t fan;   // 0-3 (auto, low, mid, high)
-  bool swingV;   // 垂直扫风
-  bool swingH;   // 水平扫风
-  String source; // "api", "ir_recv", "manual"
-  unsigned long lastUpdate;
-};
-
 class StateManager {
 public:
   // 初始化状态管理器
   static void init();
 
-  // 设置状态
-  static void setState(bool power, const char *mode, uint8_t temp, uint8_t fan,
-                       bool swingV, bool swingH, const char *source);
-
-  // 从JSON更新状态
-  static bool updateFromJSON(const char *json);
+  // 设置状态（温度、风速超出范围时截断）
+  static void setState(const ACState &state, ACSource source);
 
   // 获取当前状态
-  static AirConditionerState &getState();
+  static const ACState &getState();
 
   // 发布状态到MQTT
   static void publishState();
 
-  // 保存到EEPROM（可选）
+  // 立即保存到Flash（值未变化时不写入）
   static void save();
 
-  // 从EEPROM加载（可选）
+  // 加载状态：热重启优先RTC内存，否则Flash
   static bool load();
 
 private:
-  static AirConditionerState currentState;
+  static ACState currentState;
   static bool stateChanged;
+  static TaskId saveTask;
+  static uint32_t dirtySince; // 首次未保存变更的时间（0=已保存）
+
+  // RTC内存中的状态副本
+  struct RtcBlock {
+    uint32_t magic;
+    ACState state;
+    uint32_t crc;
+  };
+
+  // 状态变更后：立即更新RTC副本，静默期后写Flash
+  static void scheduleSave();
+
+  // 持久化副本：来源不保存（只改变来源时不写Flash）
+  static ACState persisted();
+
+  static void apply(const ACState &in);
+  static bool loadRtc(ACState &out);
+  static void saveRtc(const ACState &in);
+
+  // EVT_STATE_CHANGED 消费者：发布状态
+  static void onStateChanged(const Event &event);
 };
 
 #endif // STATE_MANAGER_H
@@ -0,0 +1,149 @@
+/*
+ * MQTT订阅管理 - 实现
+ */
+
+#define LOG_MODULE LOG_MOD_MQTT
+
+#include "subscription_manager.h"
+#include "checksum.h"
+#include "config_manager.h"
+#include "mqtt_client.h"
+
+// 设备topic下由服务器下发的子topic，其余都是设备自己发布的消息
+static const char *const COMMAND_SUFFIXES[] = {
+    "cmd", "learn/start", "config", "config/update", "brands/get", "ir/chunk",
+    "shadow/desired",
+#if AUTO_DETECT_ENABLED
+    "auto_detect",
+#endif
+};
+
+// 静态成员初始化
+char SubscriptionManager::active[SUB_MAX_TOPICS][SUB_TOPIC_SIZE];
+uint8_t SubscriptionManager::activeCount = 0;
+SubscriptionStats SubscriptionManager::stats = {};
+SubscriptionManager::SeenMessage SubscriptionManager::seen[MQTT_DEDUP_SIZE];
+uint8_t SubscriptionManager::seenNext = 0;
+
+void SubscriptionManager::reset() { activeCount = 0; }
+
+void SubscriptionManager::sync() {
+  char desired[SUB_MAX_TOPICS][SUB_TOPIC_SIZE];
+  uint8_t desiredCount = buildDesired(desired);
+
+  // 先退订不再需要的topic（如绑定前的 user_0）
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < activeCount; i++) {
+    if (contains(desired, desiredCount, active[i])) {
+      if (kept != i)
+        memcpy(active[kept], active[i], SUB_TOPIC_SIZE);
+      kept++;
+      continue;
+    }
+    DEBUG_PRINTF("[订阅] 退订: %s\n", active[i]);
+    if (MQTTClient::unsubscribe(active[i]))
+      stats.unsubscribes++;
+  }
+  activeCount = kept;
+
+  // 再订阅新增的topic
+  for (uint8_t i = 0; i < desiredCount; i++) {
+    if (contains(active, activeCount, desired[i]))
+      continue;
+    if (!MQTTClient::subscribe(desired[i], MQTT_SUB_QOS))
+      continue;
+    stats.subscribes++;
+    memcpy(active[activeCount++], desired[i], SUB_TOPIC_SIZE);
+  }
+
+  DEBUG_PRINTF("[订阅] 当前 %d 个 (累计订阅 %u / 退订 %u)\n", activeCount,
+               stats.subscribes, stats.unsubscribes);
+}
+
+bool SubscriptionManager::accept(const char *topic, const char **type) {
+  // 设备topic：只处理命令子topic，过滤自身发布的回显
+  String prefix = MQTTClient::getTopic("");
+  if (strncmp(topic, prefix.c_str(), prefix.length()) == 0) {
+    const char *suffix = topic + prefix.length();
+    for (const char *cmd : COMMAND_SUFFIXES) {
+      if (strcmp(suffix, cmd) == 0) {
+        if (type != nullptr)
+          *type = cmd;
+        stats.accepted++;
+        return true;
+      }
+    }
+    stats.dropped++;
+    return false;
+  }
+
+  // 其他topic：只接受按当前配置应订阅的精确topic（退订前已在途的旧消息丢弃）。
+  // 不查 active：恢复会话时暂存的消息可能在 sync() 之前送达
+  char desired[SUB_MAX_TOPICS][SUB_TOPIC_SIZE];
+  uint8_t count = buildDesired(desired);
+  for (uint8_t i = 0; i < count; i++) {
+    if (strcmp(desired[i], topic) == 0) {
+      // buildDesired 的顺序：设备通配符、配置topic、分组topic
+      if (type != nullptr)
+        *type = i == 1 ? "config" : "group";
+      stats.accepted++;
+      return true;
+    }
+  }
+  stats.dropped++;
+  return false;
+}
+
+bool SubscriptionManager::isDuplicate(uint16_t msgId, const uint8_t *payload,
+                                      unsigned int length) {
+  uint32_t crc = Checksum::crc32(payload, length);
+  for (uint8_t i = 0; i < MQTT_DEDUP_SIZE; i++) {
+    if (seen[i].msgId == msgId && seen[i].crc == crc) {
+      stats.duplicates++;
+      return true;
+    }
+  }
+
+  seen[seenNext].msgId = msgId;
+  seen[seenNext].crc = crc;
+  seenNext = (seenNext + 1) % MQTT_DEDUP_SIZE;
+  return false;
+}
+
+const SubscriptionStats &SubscriptionManager::getStats() { return stats; }
+
+uint8_t SubscriptionManager::buildDesired(char desired[][SUB_TOPIC_SIZE]) {
+  uint8_t count = 0;
+
+  // 设备的所有命令topic：ac/user_X/dev_Y/#
+  String deviceTopic = MQTTClient::getTopic("#");
+  strncpy(desired[count], deviceTopic.c_str(), SUB_TOPIC_SIZE - 1);
+  desired[count++][SUB_TOPIC_SIZE - 1] = '\0';
+
+  // 按MAC的配置topic（绑定前后不变）：ac/config/<MAC>
+  String configTopic = "ac/config/" + WiFi.macAddress();
+  configTopic.replace(":", "");
+  strncpy(desired[count], configTopic.c_str(), SUB_TOPIC_SIZE - 1);
+  desired[count++][SUB_TOPIC_SIZE - 1] = '\0';
+
+  // 设备所属分组的命令topic：ac/user_X/group/<name>/cmd
+  const GroupList &groups = ConfigManager::getGroups();
+  for (uint8_t i = 0; i < GROUP_MAX; i++) {
+    if (groups.names[i][0] == '\0')
+      continue;
+    String groupTopic = MQTTClient::getGroupTopic(groups.names[i]);
+    strncpy(desired[count], groupTopic.c_str(), SUB_TOPIC_SIZE - 1);
+    desired[count++][SUB_TOPIC_SIZE - 1] = '\0';
+  }
+
+  return count;
+}
+
+bool SubscriptionManager::contains(const char list[][SUB_TOPIC_SIZE],
+                                   uint8_t count, const char *topic) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (strcmp(list[i], topic) == 0)
+      return true;
+  }
+  return false;
+}
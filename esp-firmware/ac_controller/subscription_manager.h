@@ -0,0 +1,64 @@
+/*
+ * MQTT订阅管理
+ *
+ * 功能：
+ * - 设备topic只用一个通配符订阅 ac/user_X/dev_Y/#，另加按MAC的配置topic
+ *   和所属分组的命令topic ac/user_X/group/<name>/cmd
+ * - 绑定后比较新旧订阅集合：退订旧topic，只订阅新增的topic
+ * - 过滤通配符收到的自身发布回显和旧topic上的消息
+ * - 以QoS1订阅（配合持久会话），记录最近的消息ID过滤服务器重发
+ * - 统计 SUBSCRIBE/UNSUBSCRIBE 报文数
+ */
+
+#ifndef SUBSCRIPTION_MANAGER_H
+#define SUBSCRIPTION_MANAGER_H
+
+#include "config.h"
+#include <Arduino.h>
+
+// 订阅统计
+struct SubscriptionStats {
+  uint32_t subscribes;   // 发出的 SUBSCRIBE 报文
+  uint32_t unsubscribes; // 发出的 UNSUBSCRIBE 报文
+  uint32_t accepted;     // 交给命令处理的消息
+  uint32_t dropped;      // 丢弃的回显/旧topic消息
+  uint32_t duplicates;   // 丢弃的重发消息（同一消息ID和内容）
+};
+
+class SubscriptionManager {
+public:
+  // 新连接（服务器端没有任何订阅）：清空已订阅集合
+  static void reset();
+
+  // 按当前配置计算期望的订阅集合，与已订阅集合比较后发出差异报文
+  static void sync();
+
+  // 收到的消息是否需要处理（否则为回显或已退订topic上的残留消息）；
+  // type 非空时返回消息类型：命令名、"config" 或 "group"（字符串常量）
+  static bool accept(const char *topic, const char **type = nullptr);
+
+  // QoS1消息是否已处理过（服务器在未收到PUBACK时会重发同一消息）
+  static bool isDuplicate(uint16_t msgId, const uint8_t *payload,
+                          unsigned int length);
+
+  static const SubscriptionStats &getStats();
+
+private:
+  static char active[SUB_MAX_TOPICS][SUB_TOPIC_SIZE];
+  static uint8_t activeCount;
+  static SubscriptionStats stats;
+
+  // 最近处理过的QoS1消息（环形覆盖）
+  struct SeenMessage {
+    uint16_t msgId;
+    uint32_t crc; // 负载CRC，服务器复用消息ID时区分不同消息
+  };
+  static SeenMessage seen[MQTT_DEDUP_SIZE];
+  static uint8_t seenNext;
+
+  static uint8_t buildDesired(char desired[][SUB_TOPIC_SIZE]);
+  static bool contains(const char list[][SUB_TOPIC_SIZE], uint8_t count,
+                       const char *topic);
+};
+
+#endif // SUBSCRIPTION_MANAGER_H
@@ -2,271 +2,282 @@
  * WiFi管理模块 - 实现
  */
 
+#define LOG_MODULE LOG_MOD_WIFI
+
 #include "wifi_manager.h"
+#include "boot_profiler.h"
+
+#if !CAPTIVE_PORTAL_ENABLED && !defined(WIFI_SSID)
+#warning "配网门户已关闭且未定义 WIFI_SSID：新设备只能使用已保存的WiFi凭证"
+#endif
 
 // 静态成员初始化
-bool WiFiManager::configured = false;
-unsigned long WiFiManager::lastReconnectAttempt = 0;
-ESP8266WebServer WiFiManager::server(80); // ✅ Web服务器监听80端口
-DNSServer WiFiManager::dnsServer;         // ✅ DNS服务器实例
+WiFiState WiFiManager::state = WIFI_STATE_IDLE;
+unsigned long WiFiManager::stateSince = 0;
+uint32_t WiFiManager::backoffMs = WIFI_BACKOFF_MIN;
+uint32_t WiFiManager::retryDelay = 0;
+uint8_t WiFiManager::consecutiveFailures = 0;
+bool WiFiManager::everConnected = false;
+bool WiFiManager::fastConnected = false;
+WiFiStats WiFiManager::stats = {};
+TaskId WiFiManager::task = SCHED_INVALID_TASK;
+String WiFiManager::ssid;
+String WiFiManager::password;
+WiFiEventHandler WiFiManager::gotIpHandler;
+WiFiEventHandler WiFiManager::disconnectedHandler;
+
+void WiFiManager::begin() {
+  DEBUG_PRINTLN("\n[WiFi] 初始化WiFi模块 (非阻塞状态机)");
+
+  // 重连由状态机负责（退避 + 抖动），关闭SDK自动重连
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
 
-void WiFiManager::connect() {
-  DEBUG_PRINTLN("\n[WiFi] 初始化WiFi模块 (3层连接策略)");
+  // 获取IP或掉线时立即唤醒状态机，不必等下一次轮询
+  gotIpHandler = WiFi.onStationModeGotIP(
+      [](const WiFiEventStationModeGotIP &) { Scheduler::triggerFromISR(task); });
+  disconnectedHandler = WiFi.onStationModeDisconnected(
+      [](const WiFiEventStationModeDisconnected &) {
+        Scheduler::triggerFromISR(task);
+      });
 
-  WiFi.mode(WIFI_STA);
-  WiFi.setAutoConnect(true);
-  WiFi.setAutoReconnect(true);
+  task = Scheduler::addPeriodic("wifi", WIFI_POLL_INTERVAL, update);
 
-  // ===== Layer 1: 硬编码凭证 (优先级最高) =====
+  // 凭证优先级：硬编码 > 已保存（硬编码连接成功后会写入存储）
+  bool haveCredentials = loadCredentials(ssid, password);
 #ifdef WIFI_SSID
-  DEBUG_PRINTLN("[WiFi] [L1] 尝试硬编码凭证...");
-  DEBUG_PRINTF("[WiFi] SSID: %s\n", WIFI_SSID);
-
-  // 尝试2次，超时45s -> 每次约22500ms
-  for (int i = 0; i < 2; i++) {
-    if (attemptConnection(WIFI_SSID, WIFI_PASSWORD, 22500)) {
-      DEBUG_PRINTLN("[WiFi] [L1] ✅ 连接成功");
-      configured = true;
-      // 保存到EEPROM作为Layer 2备份
-      saveCredentials(WIFI_SSID, WIFI_PASSWORD);
-      return;
-    }
-    if (i == 0)
-      DEBUG_PRINTLN("[WiFi] [L1] 重试...");
-  }
-  DEBUG_PRINTLN("[WiFi] [L1] ❌ 连接失败");
-#else
-  DEBUG_PRINTLN("[WiFi] [L1] 未定义硬编码凭证，跳过");
+  ssid = WIFI_SSID;
+  password = WIFI_PASSWORD;
+  haveCredentials = true;
 #endif
 
-  // ===== Layer 2: EEPROM凭证 (无Checksum) =====
-  String ssid, password;
-  DEBUG_PRINTLN("[WiFi] [L2] 尝试读取EEPROM凭证...");
-
-  if (loadCredentials(ssid, password)) {
-    DEBUG_PRINTF("[WiFi] 读取到SSID: %s\n", ssid.c_str());
-
-    // 尝试2次，超时30s -> 每次约15000ms
-    for (int i = 0; i < 2; i++) {
-      if (attemptConnection(ssid, password, 15000)) {
-        DEBUG_PRINTLN("[WiFi] [L2] ✅ 连接成功");
-        configured = true;
-        return;
-      }
-      if (i == 0)
-        DEBUG_PRINTLN("[WiFi] [L2] 重试...");
-    }
-    DEBUG_PRINTLN("[WiFi] [L2] ❌ 连接失败");
+  if (!haveCredentials) {
+    DEBUG_PRINTLN("[WiFi] 无可用凭证");
+    startPortal();
+  } else if (NetCache::hasWiFi(ssid.c_str())) {
+    startFastConnect();
   } else {
-    DEBUG_PRINTLN("[WiFi] [L2] EEPROM中无有效凭证");
+    startConnect();
   }
-
-  // ===== Layer 3: AP模式 + Web配置 =====
-  DEBUG_PRINTLN("[WiFi] [L3] 启动AP配网模式...");
-  startAPMode();
 }
 
-void WiFiManager::maintain() {
-  // 如果WiFi断开，尝试重连
-  if (WiFi.status() != WL_CONNECTED) {
-    // 如果处于AP模式，处理Web请求
-    // 注意：startAPMode是阻塞的直到重启，所以这里 maintain 主要用于 STA
-    // 模式下的掉线重连 如果 connect() 在 L3 阶段不阻塞（本实现中 L3
-    // 是阻塞的），这里才需要处理
+void WiFiManager::update() {
+  unsigned long elapsed = millis() - stateSince;
 
-    unsigned long now = millis();
+  switch (state) {
+  case WIFI_STATE_FAST_CONNECT:
+  case WIFI_STATE_CONNECTING: {
+    if (WiFi.status() == WL_CONNECTED) {
+      onConnected();
+      break;
+    }
 
-    // 避免频繁重连
-    if (now - lastReconnectAttempt > WIFI_RECONNECT_DELAY) {
-      lastReconnectAttempt = now;
+    uint32_t timeout = state == WIFI_STATE_FAST_CONNECT
+                           ? WIFI_FAST_CONNECT_TIMEOUT
+                           : WIFI_CONNECT_TIMEOUT;
+    if (elapsed > timeout) {
+      onAttemptFailed();
+    }
+    break;
+  }
 
-      DEBUG_PRINTLN("[WiFi] 连接丢失，尝试重连...");
+  case WIFI_STATE_CONNECTED:
+    if (WiFi.status() != WL_CONNECTED) {
+      DEBUG_PRINTLN("[WiFi] 连接丢失");
+      stats.disconnects++;
+      consecutiveFailures = 0;
+      backoffMs = WIFI_BACKOFF_MIN;
+      retryDelay = WIFI_BACKOFF_MIN;
       LEDIndicator::setStatus(STATUS_WIFI_CONNECTING);
+      enter(WIFI_STATE_BACKOFF);
+    }
+    break;
 
-      String ssid, password;
-      if (loadCredentials(ssid, password)) {
-        WiFi.begin(ssid.c_str(), password.c_str());
-      }
+  case WIFI_STATE_BACKOFF:
+    if (elapsed >= retryDelay) {
+      startConnect();
     }
-  } else if (!configured) {
-    // 第一次连接成功
-    configured = true;
-    DEBUG_PRINT("[WiFi] ✅ 连接成功！IP: ");
-    DEBUG_PRINTLN(WiFi.localIP().toString());
+    break;
+
+  case WIFI_STATE_PORTAL:
+    // 路由器可能只是比设备晚启动：无人连接热点时定期重试已保存的凭证
+    if (ssid.length() > 0 && elapsed > WIFI_PORTAL_RETRY_INTERVAL &&
+        CaptivePortal::getClientCount() == 0) {
+      startConnect();
+    }
+    break;
+
+  default:
+    break;
   }
 }
 
 bool WiFiManager::isConnected() { return WiFi.status() == WL_CONNECTED; }
 
-void WiFiManager::startAPMode() {
-  // 切换到 AP+STA 模式 (或者仅 AP)
-  WiFi.mode(WIFI_AP);
-
-  String apName = "ESP_Setup_" + String(ESP.getChipId(), HEX);
-  DEBUG_PRINTF("[WiFi] AP名称: %s\n", apName.c_str());
-  DEBUG_PRINTLN("[WiFi] 请连接热点并访问 192.168.4.1 配置WiFi");
-
-  WiFi.softAP(apName.c_str());
-
-  // ✅ 启动DNS服务器，将所有请求重定向到本机IP
-  // 53是DNS端口，"*"代表匹配所有域名
-  dnsServer.start(53, "*", WiFi.softAPIP());
-  DEBUG_PRINTLN("[WiFi] DNS服务器已启动 (Captive Portal)");
-
-  // 启动Web服务器
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/save", HTTP_POST, handleSave);
-  // ✅ 捕获所有其他请求并重定向到根目录 (Android/iOS Captive Portal检测)
-  server.onNotFound(handleRoot);
-  server.begin();
-
-  DEBUG_PRINTLN("[WiFi] Web服务器已启动");
-  LEDIndicator::setStatus(STATUS_UNCONFIGURED); // 慢闪提示
-
-  // 阻塞循环，处理Web请求
-  while (true) {
-    dnsServer.processNextRequest(); // ✅ 处理DNS请求
-    server.handleClient();
-    LEDIndicator::update();
-    delay(10);
+bool WiFiManager::isFastConnected() { return fastConnected; }
+
+WiFiState WiFiManager::getState() { return state; }
+
+const char *WiFiManager::stateName(WiFiState s) {
+  switch (s) {
+  case WIFI_STATE_IDLE:
+    return "idle";
+  case WIFI_STATE_FAST_CONNECT:
+    return "fast_connect";
+  case WIFI_STATE_CONNECTING:
+    return "connecting";
+  case WIFI_STATE_CONNECTED:
+    return "connected";
+  case WIFI_STATE_BACKOFF:
+    return "backoff";
+  case WIFI_STATE_PORTAL:
+    return "portal";
+  default:
+    return "unknown";
   }
 }
 
-void WiFiManager::handleRoot() {
-  String html =
-      "<html><head><meta name='viewport' content='width=device-width, "
-      "initial-scale=1, user-scalable=no'>";
-  html += "<title>WiFi Configuration</title>";
-  html += "<style>body{font-family:Arial;padding:20px;max-width:400px;margin:0 "
-          "auto;}";
-  html += "input{width:100%;padding:10px;margin:10px 0;box-sizing:border-box;}";
-  html += "button{width:100%;padding:10px;background:#007bff;color:white;"
-          "border:none;cursor:pointer;}";
-  html += ".note{color:orange;font-size:14px;}</style></head><body>";
-  html += "<h2>WiFi Configuration</h2>";
-  html += "<p class='note'>Note: Only 2.4GHz WiFi is supported.</p>";
-  html += "<form action='/save' method='POST'>";
-  html +=
-      "<input type='text' name='ssid' placeholder='WiFi Name (SSID)' required>";
-  html +=
-      "<input type='password' name='password' placeholder='Password' required>";
-  html += "<button type='submit'>Save & Restart</button>";
-  html += "</form></body></html>";
-
-  server.send(200, "text/html", html);
-}
+const WiFiStats &WiFiManager::getStats() { return stats; }
 
-void WiFiManager::handleSave() {
-  String ssid = server.arg("ssid");
-  String password = server.arg("password");
+void WiFiManager::enter(WiFiState next) {
+  DEBUG_PRINTF("[WiFi] 状态: %s -> %s\n", stateName(state), stateName(next));
+  state = next;
+  stateSince = millis();
+  stats.transitions[next]++;
+}
 
-  if (ssid.length() > 0) {
-    DEBUG_PRINTLN("[WiFi] 收到Web配置:");
-    DEBUG_PRINTF("SSID: %s\n", ssid.c_str());
+void WiFiManager::startFastConnect() {
+  const NetCacheData &cache = NetCache::get();
+  DEBUG_PRINTF("[WiFi] [L0] 快速连接: %s (信道: %d)\n", ssid.c_str(),
+               cache.channel);
+  LEDIndicator::setStatus(STATUS_WIFI_CONNECTING);
 
-    saveCredentials(ssid, password);
+  // 指定BSSID/信道跳过扫描；地址仍走DHCP，租约正常续期，
+  // 地址冲突由路由器处理
+  WiFi.config(0U, 0U, 0U); // 使用DHCP
+  WiFi.begin(ssid.c_str(), password.c_str(), cache.channel, cache.bssid);
 
-    String html = "<html><body><h2>Saved!</h2><p>Device is "
-                  "restarting...</p></body></html>";
-    server.send(200, "text/html", html);
+  stats.attempts++;
+  enter(WIFI_STATE_FAST_CONNECT);
+}
 
-    delay(1000);
-    ESP.restart();
-  } else {
-    server.send(400, "text/plain", "SSID cannot be empty");
+void WiFiManager::startConnect() {
+  DEBUG_PRINTF("[WiFi] 尝试连接: %s (超时: %u ms)\n", ssid.c_str(),
+               WIFI_CONNECT_TIMEOUT);
+  if (!CaptivePortal::isActive()) {
+    LEDIndicator::setStatus(STATUS_WIFI_CONNECTING);
   }
+
+  // 配网门户开启时保持AP，让手机能看到结果
+  WiFi.mode(CaptivePortal::isActive() ? WIFI_AP_STA : WIFI_STA);
+  WiFi.config(0U, 0U, 0U); // 使用DHCP
+  WiFi.begin(ssid.c_str(), password.c_str());
+
+  stats.attempts++;
+  enter(WIFI_STATE_CONNECTING);
 }
 
-String WiFiManager::getIPAddress() { return WiFi.localIP().toString(); }
+void WiFiManager::onConnected() {
+  fastConnected = state == WIFI_STATE_FAST_CONNECT;
+  enter(WIFI_STATE_CONNECTED);
 
-String WiFiManager::getMACAddress() { return WiFi.macAddress(); }
+  DEBUG_PRINT("[WiFi] ✅ 连接成功！IP: ");
+  DEBUG_PRINTLN(WiFi.localIP().toString());
 
-bool WiFiManager::loadCredentials(String &ssid, String &password) {
-  EEPROM.begin(EEPROM_SIZE);
+  everConnected = true;
+  consecutiveFailures = 0;
+  backoffMs = WIFI_BACKOFF_MIN;
 
-  // ⚠️ 移除 EEPROM_CONFIG_FLAG 检查 (Layer 2 无 Checksum)
-  // 直接尝试读取 SSID
-  // if (EEPROM.read(EEPROM_CONFIG_FLAG) != 0x55) ...
+  // 保存凭证和连接参数（未变化时不写Flash）
+  saveCredentials(ssid, password);
+  NetCache::saveWiFi(ssid.c_str());
 
-  // 读取SSID
-  char ssidBuf[33] = {0};
-  for (int i = 0; i < 32; i++) {
-    ssidBuf[i] = EEPROM.read(EEPROM_WIFI_SSID + i);
-    if (ssidBuf[i] == 0)
-      break;
-  }
-  ssid = String(ssidBuf);
+  // 已连上路由器，关闭配网热点
+  CaptivePortal::stop();
 
-  // 读取密码
-  char passBuf[65] = {0};
-  for (int i = 0; i < 64; i++) {
-    passBuf[i] = EEPROM.read(EEPROM_WIFI_PASS + i);
-    if (passBuf[i] == 0)
-      break;
+  BootProfiler::markOnce("wifi");
+}
+
+void WiFiManager::onAttemptFailed() {
+  WiFi.disconnect();
+
+  if (state == WIFI_STATE_FAST_CONNECT) {
+    // 缓存失效，立即改用普通连接
+    LOG_PRINTLN(ERROR, "[WiFi] [L0] ❌ 快速连接超时，清除缓存");
+    NetCache::invalidateWiFi();
+    startConnect();
+    return;
   }
-  password = String(passBuf);
 
-  EEPROM.end();
+  LOG_PRINTLN(ERROR, "[WiFi] ❌ 连接超时");
+  stats.failures++;
+  consecutiveFailures++;
 
-  // 简单验证：SSID不为空且字符合法
-  if (ssid.length() == 0 || ssid.length() > 32)
-    return false;
+  // 从未连上过（凭证可能有误）：进入配网；否则按退避重试
+  if (!everConnected && consecutiveFailures >= WIFI_PORTAL_AFTER_FAILURES) {
+    consecutiveFailures = 0;
+    startPortal();
+    return;
+  }
 
-  // 检查是否全由 0xFF 组成（即空EEPROM）
-  if (ssid[0] == (char)0xFF)
-    return false;
+  // 指数退避，±25% 抖动避免多台设备同时重连
+  retryDelay = backoffMs - backoffMs / 4 + random(backoffMs / 2 + 1);
+  backoffMs = min(backoffMs * 2, (uint32_t)WIFI_BACKOFF_MAX);
 
-  return true;
+  DEBUG_PRINTF("[WiFi] %u ms 后重试\n", retryDelay);
+  enter(WIFI_STATE_BACKOFF);
+  Scheduler::schedule(task, retryDelay);
 }
 
-void WiFiManager::saveCredentials(const String &ssid, const String &password) {
-  EEPROM.begin(EEPROM_SIZE);
-
-  // 写入SSID
-  for (int i = 0; i < 32; i++) {
-    if (i < ssid.length()) {
-      EEPROM.write(EEPROM_WIFI_SSID + i, ssid[i]);
-    } else {
-      EEPROM.write(EEPROM_WIFI_SSID + i, 0);
-    }
+void WiFiManager::startPortal() {
+  if (!CaptivePortal::isActive()) {
+    String apName = "ESP_Setup_" + String(ESP.getChipId(), HEX);
+    CaptivePortal::start(apName.c_str(), onPortalCredentials);
   }
 
-  // 写入密码
-  for (int i = 0; i < 64; i++) {
-    if (i < password.length()) {
-      EEPROM.write(EEPROM_WIFI_PASS + i, password[i]);
-    } else {
-      EEPROM.write(EEPROM_WIFI_PASS + i, 0);
-    }
-  }
+  LEDIndicator::setStatus(STATUS_UNCONFIGURED); // 快闪提示
+  enter(WIFI_STATE_PORTAL);
+}
 
-  // ⚠️ 移除 EEPROM_CONFIG_FLAG 写入
-  // EEPROM.write(EEPROM_CONFIG_FLAG, 0x55);
+void WiFiManager::onPortalCredentials(const String &newSsid,
+                                      const String &newPassword) {
+  // 无需重启：直接用新凭证连接，成功后保存并关闭门户
+  ssid = newSsid;
+  password = newPassword;
+  consecutiveFailures = 0;
+  startConnect();
+}
 
-  EEPROM.commit();
-  EEPROM.end();
+String WiFiManager::getIPAddress() { return WiFi.localIP().toString(); }
 
-  DEBUG_PRINTLN("[WiFi] 凭证已保存到EEPROM");
-}
+String WiFiManager::getMACAddress() { return WiFi.macAddress(); }
 
-bool WiFiManager::attemptConnection(const String &ssid, const String &password,
-                                    unsigned long timeout) {
-  DEBUG_PRINTF("[WiFi] 尝试连接: %s (超时: %lu ms)\n", ssid.c_str(), timeout);
-  LEDIndicator::setStatus(STATUS_WIFI_CONNECTING);
+bool WiFiManager::loadCredentials(String &ssid, String &password) {
+  WiFiCredentials creds;
+  if (KVStore::get(KV_KEY_WIFI_CREDENTIALS, &creds, sizeof(creds)) !=
+      (int)sizeof(creds))
+    return false;
 
-  WiFi.begin(ssid.c_str(), password.c_str());
+  creds.ssid[sizeof(creds.ssid) - 1] = '\0';
+  creds.password[sizeof(creds.password) - 1] = '\0';
+  ssid = String(creds.ssid);
+  password = String(creds.password);
 
-  unsigned long startTime = millis();
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    DEBUG_PRINT(".");
+  // 简单验证：SSID不为空
+  return ssid.length() > 0;
+}
 
-    if (millis() - startTime > timeout) {
-      DEBUG_PRINTLN("\n[WiFi] ❌ 连接超时");
-      return false;
-    }
+void WiFiManager::saveCredentials(const String &ssid, const String &password) {
+  WiFiCredentials creds;
+  memset(&creds, 0, sizeof(creds));
+  strncpy(creds.ssid, ssid.c_str(), sizeof(creds.ssid) - 1);
+  strncpy(creds.password, password.c_str(), sizeof(creds.password) - 1);
+
+  // 与已存储的凭证相同时不写Flash
+  if (KVStore::put(KV_KEY_WIFI_CREDENTIALS, &creds, sizeof(creds))) {
+    DEBUG_PRINTLN("[WiFi] 凭证已保存");
+  } else {
+    LOG_PRINTLN(ERROR, "[WiFi] ❌ 凭证保存失败");
   }
-
-  DEBUG_PRINTLN();
-  return true;
 }
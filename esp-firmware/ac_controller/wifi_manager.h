@@ -2,37 +2,60 @@
  * WiFi管理模块
  *
  * 功能：
- * - SmartConfig配网
- * - WiFi连接和重连
- * - EEPROM存储WiFi凭证
+ * - 非阻塞连接状态机（快速连接 → 普通连接 → 退避重试 → AP配网）
+ * - 指数退避 + 随机抖动，掉线后自动重连
+ * - AP配网见 captive_portal.h，不阻塞红外/传感器等本地功能
+ * - 键值存储保存WiFi凭证（内存缓存，不重复读取）
  */
 
 #ifndef WIFI_MANAGER_H
 #define WIFI_MANAGER_H
 
 #include "config.h"
+#include "captive_portal.h"
+#include "config_manager.h"
 #include "led_indicator.h"
-#include <DNSServer.h> // ✅ 新增：DNS服务器库 (用于Captive Portal)
-#include <EEPROM.h>
-#include <ESP8266WebServer.h> // ✅ 新增：Web服务器库
+#include "net_cache.h"
+#include "scheduler.h"
 #include <ESP8266WiFi.h>
 
+// 连接状态
+enum WiFiState : uint8_t {
+  WIFI_STATE_IDLE,         // 未启动
+  WIFI_STATE_FAST_CONNECT, // 使用缓存的BSSID/信道连接（DHCP）
+  WIFI_STATE_CONNECTING,   // 普通连接（扫描 + DHCP）
+  WIFI_STATE_CONNECTED,    // 已连接
+  WIFI_STATE_BACKOFF,      // 连接失败，等待重试
+  WIFI_STATE_PORTAL,       // AP配网模式
+  WIFI_STATE_COUNT
+};
+
+// 连接统计
+struct WiFiStats {
+  uint32_t transitions[WIFI_STATE_COUNT]; // 进入各状态的次数
+  uint32_t attempts;                      // 连接尝试次数
+  uint32_t failures;                      // 连接超时次数
+  uint32_t disconnects;                   // 已连接后掉线次数
+};
+
 class WiFiManager {
 public:
-  // 初始化并连接WiFi (3层策略)
-  static void connect();
+  // 加载凭证并启动连接状态机（立即返回）
+  static void begin();
 
-  // 维护WiFi连接（在loop中调用）
-  static void maintain();
+  // 状态机（调度器任务）
+  static void update();
 
   // 检查是否已连接
   static bool isConnected();
 
-  // (Removed) 启动SmartConfig配网
-  // static void startSmartConfig();
+  // 本次启动是否通过缓存快速连接
+  static bool isFastConnected();
 
-  // ✅ 新增：启动AP模式+Web配置
-  static void startAPMode();
+  // 当前状态和统计
+  static WiFiState getState();
+  static const char *stateName(WiFiState state);
+  static const WiFiStats &getStats();
 
   // 获取IP地址
   static String getIPAddress();
@@ -41,24 +64,40 @@ public:
   static String getMACAddress();
 
 private:
-  static bool configured;
-  static unsigned long lastReconnectAttempt;
-  static ESP8266WebServer server; // ✅ 新增：Web服务器实例
-  static DNSServer dnsServer;     // ✅ 新增：DNS服务器实例
+  static WiFiState state;
+  static unsigned long stateSince;
+  static uint32_t backoffMs;  // 下一次退避的基准值
+  static uint32_t retryDelay; // 本次退避（含抖动）
+  static uint8_t consecutiveFailures;
+  static bool everConnected;
+  static bool fastConnected;
+  static WiFiStats stats;
+  static TaskId task;
 
-  // 从EEPROM读取WiFi凭证
-  static bool loadCredentials(String &ssid, String &password);
+  // 当前使用的凭证（启动时加载一次）
+  static String ssid;
+  static String password;
 
-  // 保存WiFi凭证到EEPROM
-  static void saveCredentials(const String &ssid, const String &password);
+  // 系统WiFi事件 -> 立即唤醒状态机
+  static WiFiEventHandler gotIpHandler;
+  static WiFiEventHandler disconnectedHandler;
+
+  // 状态切换
+  static void enter(WiFiState next);
+  static void startFastConnect();
+  static void startConnect();
+  static void onConnected();
+  static void onAttemptFailed();
 
-  // 尝试连接WiFi (指定超时时间MS)
-  static bool attemptConnection(const String &ssid, const String &password,
-                                unsigned long timeout);
+  // AP配网门户
+  static void startPortal();
+  static void onPortalCredentials(const String &ssid, const String &password);
 
-  // ✅ 新增：Web处理函数
-  static void handleRoot();
-  static void handleSave();
+  // 读取已保存的WiFi凭证
+  static bool loadCredentials(String &ssid, String &password);
+
+  // 保存WiFi凭证
+  static void saveCredentials(const String &ssid, const String &password);
 };
 
 #endif // WIFI_MANAGER_H
@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""
+按构建配置编译固件并统计各模块的 Flash/RAM 占用
+
+构建配置是 ac_controller/profile_<名称>.h：其中带值的 #define 行转换为
+-D 编译选项，同时传给固件和库（IRremoteESP8266 的 DECODE_*/SEND_* 只有
+这样才对库本身生效）。链接时生成 map 文件，按目标文件汇总各段大小：
+
+    python3 tools/build_profile.py gree
+    python3 tools/build_profile.py --all          # 编译全部配置并对比
+    python3 tools/build_profile.py gree --map build/gree/ac_controller.map
+                                                  # 只分析已有的 map 文件
+
+需要 arduino-cli 及 esp8266 核心（见 ac_controller/README_COMPILE.md）
+"""
+
+import argparse
+import glob
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+SKETCH = os.path.normpath(os.path.join(ROOT, "..", "ac_controller"))
+BUILD_DIR = os.path.normpath(os.path.join(ROOT, "..", "build"))
+DEFAULT_FQBN = "esp8266:esp8266:generic"
+
+DEFINE_RE = re.compile(r"^\s*#define\s+(\w+)\s+(.+?)\s*(//.*)?$")
+
+# 段名前缀 -> 统计类别（ESP8266 链接脚本的输入段）
+SECTION_KINDS = [
+    (".irom0.text", "flash"),
+    (".irom.text", "flash"),
+    (".text", "iram"),
+    (".iram", "iram"),
+    (".literal", "iram"),
+    (".rodata", "data"),
+    (".data", "data"),
+    (".bss", "bss"),
+    ("COMMON", "bss"),
+]
+KINDS = ["iram", "flash", "data", "bss"]
+
+
+def list_profiles():
+    names = []
+    for path in sorted(glob.glob(os.path.join(SKETCH, "profile_*.h"))):
+        names.append(os.path.basename(path)[len("profile_"):-len(".h")])
+    return names
+
+
+def read_defines(name):
+    path = os.path.join(SKETCH, "profile_%s.h" % name)
+    if not os.path.exists(path):
+        sys.exit("未找到构建配置 %s（可用：%s）" % (path, ", ".join(list_profiles())))
+
+    defines = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            m = DEFINE_RE.match(line)
+            if m:
+                defines.append((m.group(1), m.group(2)))
+    return defines
+
+
+def compile_flags(defines):
+    flags = []
+    for key, value in defines:
+        # 字符串值需要转义引号，才能经 arduino-cli 传到编译器
+        flags.append("-D%s=%s" % (key, value.replace('"', '\\"')))
+    return " ".join(flags)
+
+
+def build(name, fqbn):
+    defines = read_defines(name)
+    build_path = os.path.join(BUILD_DIR, name)
+    map_path = os.path.join(build_path, "ac_controller.map")
+    flags = compile_flags(defines)
+
+    cmd = [
+        "arduino-cli", "compile", "--fqbn", fqbn,
+        "--build-path", build_path,
+        "--build-property", "compiler.cpp.extra_flags=" + flags,
+        "--build-property", "compiler.c.extra_flags=" + flags,
+        "--build-property", "compiler.c.elf.extra_flags=-Wl,-Map," + map_path,
+        SKETCH,
+    ]
+    print("[%s] %s" % (name, flags))
+    subprocess.run(cmd, check=True)
+    return map_path
+
+
+def module_of(obj):
+    # 目标文件路径 -> 模块名：固件源文件 / 库名 / core
+    path = obj.replace("\\", "/")
+    m = re.search(r"/libraries/([^/]+)/", path)
+    if m:
+        return "lib:" + m.group(1)
+    if "/core/" in path or path.endswith("core.a") or "core.a(" in path:
+        return "core"
+    m = re.search(r"/sketch/([^/]+?)\.(?:cpp|ino\.cpp|c)\.o$", path)
+    if m:
+        return m.group(1)
+    m = re.search(r"([^/()]+)\.a\(", path)
+    if m:
+        return "sdk:" + m.group(1)
+    return "other"
+
+
+def section_kind(section):
+    for prefix, kind in SECTION_KINDS:
+        if section.startswith(prefix):
+            return kind
+    return None
+
+
+def parse_map(path):
+    """返回 {模块: {类别: 字节}}"""
+    sizes = {}
+    with open(path, encoding="utf-8", errors="replace") as f:
+        lines = f.read().split("\n")
+
+    try:
+        start = next(i for i, l in enumerate(lines)
+                     if l.startswith("Linker script and memory map"))
+    except StopIteration:
+        sys.exit("%s 不是 GNU ld 的 map 文件" % path)
+
+    # 输入段行以一个空格开头：" .text.foo  0x40201000  0x24 obj.o"，
+    # 段名过长时地址和大小换到下一行
+    pending = None
+    for line in lines[start:]:
+        fields = line.split()
+        if line.startswith(" ") and not line.startswith("  "):
+            pending = None
+            if len(fields) == 1:
+                pending = fields[0]
+                continue
+        elif pending is not None and line.startswith("  "):
+            fields = [pending] + fields
+            pending = None
+        else:
+            pending = None
+            continue
+
+        if len(fields) < 4 or fields[0].startswith("*"):
+            continue
+        if not fields[1].startswith("0x") or not fields[2].startswith("0x"):
+            continue
+        kind = section_kind(fields[0])
+        size = int(fields[2], 16)
+        if kind is None or size == 0:
+            continue
+        mod = sizes.setdefault(module_of(" ".join(fields[3:])),
+                               dict.fromkeys(KINDS, 0))
+        mod[kind] += size
+    return sizes
+
+
+def print_report(name, sizes):
+    print("\n===== %s =====" % name)
+    print("%-28s %8s %8s %8s %8s" % ("模块", "IRAM", "Flash", "数据", "BSS"))
+    total = dict.fromkeys(KINDS, 0)
+    for mod in sorted(sizes, key=lambda m: -sum(sizes[m].values())):
+        s = sizes[mod]
+        print("%-28s %8d %8d %8d %8d" % (mod, s["iram"], s["flash"], s["data"],
+                                         s["bss"]))
+        for k in KINDS:
+            total[k] += s[k]
+    print("%-28s %8d %8d %8d %8d" % ("合计", total["iram"], total["flash"],
+                                     total["data"], total["bss"]))
+    # 数据段同时占 Flash（初值）和 RAM
+    print("Flash 合计 %d 字节，RAM 合计 %d 字节" % (
+        total["iram"] + total["flash"] + total["data"],
+        total["data"] + total["bss"]))
+    return total
+
+
+def main():
+    parser = argparse.ArgumentParser(description="按构建配置编译并统计占用")
+    parser.add_argument("profile", nargs="?", help="配置名（profile_<名称>.h）")
+    parser.add_argument("--all", action="store_true", help="编译全部配置并对比")
+    parser.add_argument("--fqbn", default=DEFAULT_FQBN, help="开发板 FQBN")
+    parser.add_argument("--map", help="不编译，只分析已有的 map 文件")
+    args = parser.parse_args()
+
+    names = list_profiles() if args.all else [args.profile]
+    if names == [None]:
+        parser.error("需要指定配置名或 --all（可用：%s）" %
+                     ", ".join(list_profiles()))
+
+    totals = {}
+    for name in names:
+        map_path = args.map if args.map else build(name, args.fqbn)
+        totals[name] = print_report(name, parse_map(map_path))
+
+    if len(totals) > 1:
+        print("\n===== 对比 =====")
+        print("%-12s %8s %8s %8s %8s" % ("配置", "IRAM", "Flash", "数据", "BSS"))
+        for name, t in totals.items():
+            print("%-12s %8d %8d %8d %8d" % (name, t["iram"], t["flash"],
+                                             t["data"], t["bss"]))
+
+
+if __name__ == "__main__":
+    main()
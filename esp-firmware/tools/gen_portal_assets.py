@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""
+生成配网门户的 PROGMEM 资源头文件
+
+把 tools/portal/ 下的页面 gzip 压缩后写成 C 数组，输出到
+ac_controller/portal_assets.h。修改页面后重新运行：
+
+    python3 tools/gen_portal_assets.py
+"""
+
+import gzip
+import os
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+SRC_DIR = os.path.join(ROOT, "portal")
+OUT = os.path.join(ROOT, "..", "ac_controller", "portal_assets.h")
+
+# (源文件, C 标识符)
+ASSETS = [
+    ("index.html", "PORTAL_INDEX_HTML_GZ"),
+]
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 16):
+        chunk = ", ".join("0x%02x" % b for b in data[i:i + 16])
+        lines.append("    " + chunk + ",")
+    body = "\n".join(lines)
+    return (
+        "static const uint8_t %s[] PROGMEM = {\n%s\n};\n"
+        "static const size_t %s_LEN = %d;\n" % (name, body, name, len(data))
+    )
+
+
+def main():
+    parts = [
+        "/*\n"
+        " * 配网门户资源（gzip压缩，存放在Flash）\n"
+        " *\n"
+        " * 由 tools/gen_portal_assets.py 生成，请勿手动修改\n"
+        " */\n\n"
+        "#ifndef PORTAL_ASSETS_H\n"
+        "#define PORTAL_ASSETS_H\n\n"
+        "#include <Arduino.h>\n\n"
+    ]
+
+    for filename, name in ASSETS:
+        with open(os.path.join(SRC_DIR, filename), "rb") as f:
+            raw = f.read()
+        # mtime=0 保证相同输入得到相同输出
+        data = gzip.compress(raw, compresslevel=9, mtime=0)
+        parts.append("// %s: %d -> %d 字节\n" % (filename, len(raw), len(data)))
+        parts.append(c_array(name, data))
+        parts.append("\n")
+
+    parts.append("#endif // PORTAL_ASSETS_H\n")
+
+    with open(OUT, "w", encoding="utf-8") as f:
+        f.write("".join(parts))
+    print("已生成 %s" % os.path.normpath(OUT))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,20 @@
+#!/bin/sh
+# 生成本地测试用的自签名服务器证书，并打印固件需要的SHA-1指纹
+# （填入 config.h 的 MQTT_TLS_FINGERPRINT）
+#
+# 使用 ECDSA P-256 密钥：ESP8266 上的握手比 RSA-2048 快得多
+
+set -e
+cd "$(dirname "$0")"
+mkdir -p certs
+
+HOST=${1:-$(hostname -I 2>/dev/null | awk '{print $1}')}
+
+openssl ecparam -name prime256v1 -genkey -noout -out certs/server.key
+openssl req -new -x509 -days 3650 -key certs/server.key -out certs/server.crt \
+  -subj "/CN=${HOST}"
+
+echo
+echo "服务器地址: ${HOST}"
+echo "证书指纹（MQTT_TLS_FINGERPRINT）:"
+openssl x509 -in certs/server.crt -noout -fingerprint -sha1 | cut -d= -f2